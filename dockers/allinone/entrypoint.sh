@@ -0,0 +1,43 @@
+#!/bin/sh
+
+# Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+# Copyright (C) 2020-2026  Maurice Snoeren
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+#
+# Translate environment variables into CLI arguments for gdd-allinone.
+#
+#   gdd-allinone <guac_listen_ip> <guac_listen_port> <guacd_ip> <guacd_port>
+#
+# Environment variables:
+#   GUAC_LISTEN_IP    TCP bind for the Guacamole web server   [default: 0.0.0.0]
+#   GUAC_LISTEN_PORT  TCP port for the Guacamole web server   [default: 4823]
+#   GUACD_IP          TCP host of the real guacd              [default: guacd]
+#   GUACD_PORT        TCP port of guacd                       [default: 4822]
+# The stages read their other settings (GUARD_APPROVE, GUACD_BACKENDS, ...)
+# themselves, as in their own images. TLS to the web server (GMLBROKER_TLS)
+# needs a cert in place; see the gmlbroker image for generating one.
+set -eu
+
+set -- \
+  "${GUAC_LISTEN_IP:-0.0.0.0}" \
+  "${GUAC_LISTEN_PORT:-4823}" \
+  "${GUACD_IP:-guacd}" \
+  "${GUACD_PORT:-4822}"
+
+echo "gdd-allinone $*"
+exec /usr/local/bin/gdd-allinone "$@"
@@ -28,6 +28,7 @@
 #   DST_IP          high-side broker's diode IP                [required]
 #   DST_PORT        UDP port on the high-side broker           [default: 5501]
 #   GUARD_APPROVE   read by the binary itself; "deny" denies every request
+#   GUARD_POLICY    read by the binary itself; policy file, reloaded on SIGHUP
 set -eu
 
 : "${DST_IP:?DST_IP is required (the high-side broker's diode IP)}"
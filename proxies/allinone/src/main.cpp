@@ -0,0 +1,106 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../shared/include/util/running.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The stages' own main()s, renamed by the build (see meson.build).
+int gmlbroker_main(int argc, char *argv[]);
+int gmguard_main(int argc, char *argv[]);
+int gcdbroker_main(int argc, char *argv[]);
+
+namespace {
+// The bridge hops between the stages. In process they only name the queues;
+// they match the ports compose-1-node.yml uses for the same hops.
+constexpr const char *HOP_GUARD = "5500";     // gmlbroker -> gmguard (D1)
+constexpr const char *HOP_GCDBROKER = "5501"; // gmguard -> gcdbroker (D2)
+constexpr const char *HOP_RETURN = "5502";    // gcdbroker -> gmlbroker (D3)
+
+/*
+ * @brief Runs one stage's main() with the given command line on a thread
+ *
+ * Whichever stage returns first, for a shutdown or a failed start, clears
+ * `running` so the other two stop with it.
+ */
+std::thread start_stage(int (*stage_main)(int, char *[]),
+                        std::vector<std::string> args, std::atomic<int> &rc) {
+    return std::thread([stage_main, args = std::move(args), &rc]() mutable {
+        std::vector<char *> argv;
+        for (std::string &arg : args)
+            argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        int r = stage_main(static_cast<int>(args.size()), argv.data());
+        int ok = 0;
+        if (r != 0)
+            rc.compare_exchange_strong(ok, r);
+        running = false;
+    });
+}
+} // namespace
+
+/*
+ * @brief Starts gmlbroker, gmguard and gcdbroker in one process
+ *
+ * The stages run their unchanged code on threads of their own and talk over
+ * in-process bounded queues (BRIDGE_TRANSPORT=mem) in place of the UDP bridge,
+ * keeping its one-way hops: gmlbroker -> gmguard -> gcdbroker, and gcdbroker
+ * -> gmlbroker for the return path. Every other setting is read from the
+ * environment as the separate programs read it.
+ */
+int main(int argc, char *argv[]) {
+    if (argc != 5) {
+        std::cerr << "Usage: " << argv[0] << "\n"
+                  << "\t<guac_listen_ip>: Guacamole broker's listening IP "
+                     "address (for the web server)\n"
+                  << "\t<guac_listen_port>: Guacamole broker's listening port\n"
+                  << "\t<guacd_ip>: guacd's IP address\n"
+                  << "\t<guacd_port>: guacd's listening port\n"
+                  << "\nExample: " << argv[0] << " 0.0.0.0 4823 127.0.0.1 4822"
+                  << std::endl;
+        return 1;
+    }
+
+    setenv("BRIDGE_TRANSPORT", "mem", 1);
+
+    std::atomic<int> rc{0};
+    std::vector<std::thread> stages;
+    // No start order is needed: a hop's queue exists from whichever of its two
+    // ends opens it first.
+    stages.push_back(start_stage(gmguard_main,
+                                 {"gmguard", HOP_GUARD, "127.0.0.1",
+                                  HOP_GCDBROKER},
+                                 rc));
+    stages.push_back(start_stage(gcdbroker_main,
+                                 {"gcdbroker", argv[3], argv[4], HOP_GCDBROKER,
+                                  "127.0.0.1", HOP_RETURN},
+                                 rc));
+    stages.push_back(start_stage(gmlbroker_main,
+                                 {"gmlbroker", argv[1], argv[2], HOP_RETURN,
+                                  "127.0.0.1", HOP_GUARD},
+                                 rc));
+    for (std::thread &t : stages)
+        t.join();
+    return rc;
+}
@@ -0,0 +1,137 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/guacd_client.h"
+#include "guacd_pool.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * @brief The guacd processes gcdbroker spreads approved channels over.
+ *
+ * guacd's RDP/VNC encoding is the high side's CPU bottleneck, so more than one
+ * guacd can be listed in GUACD_BACKENDS as `host:port[@weight]`, comma
+ * separated; without it the single backend from the command line is used.
+ * Each backend has its own GuacdClient and GuacdPool.
+ *
+ * Pick() chooses the backend with the fewest active channels per unit of
+ * weight (weighted least-connections; with equal weights, simply the least
+ * active). A channel counts as active from Pick() until Release(): the dial,
+ * and then its reader's lifetime. A backend that fails GUACD_BACKEND_MAX_FAILS
+ * dials in a row (default 3) is excluded from Pick() until a health check
+ * reaches it again; Run() probes every backend each GUACD_HEALTH_MS (default
+ * 5 s). When every backend is excluded, Pick() still picks among all of them
+ * rather than refuse the channel.
+ */
+class GuacdBackends {
+  public:
+    /*
+     * @brief Reads GUACD_BACKENDS, falling back to default_host:default_port
+     */
+    GuacdBackends(const std::string &default_host, int default_port);
+
+    /*
+     * @brief Uses the backends in `spec` (the GUACD_BACKENDS format)
+     */
+    explicit GuacdBackends(const std::string &spec);
+
+    GuacdBackends(const GuacdBackends &) = delete;
+    GuacdBackends &operator=(const GuacdBackends &) = delete;
+
+    /*
+     * @brief Whether every backend in the spec parsed; a bad spec leaves none
+     */
+    bool Valid() const { return !backends.empty(); }
+
+    size_t Size() const { return backends.size(); }
+
+    GuacdClient &Client(size_t backend) { return *backends[backend]->client; }
+    GuacdPool &Pool(size_t backend) { return *backends[backend]->pool; }
+    const std::string &Name(size_t backend) const {
+        return backends[backend]->name;
+    }
+
+    /*
+     * @brief Chooses a backend for a new channel and counts the channel on it
+     * @return The backend index; the caller must Release() it exactly once
+     */
+    size_t Pick();
+
+    /*
+     * @brief Stops counting a channel on its backend
+     */
+    void Release(size_t backend);
+
+    /*
+     * @brief Records a dial that reached the backend, ending any exclusion
+     */
+    void ReportSuccess(size_t backend);
+
+    /*
+     * @brief Records a failed dial; enough in a row exclude the backend
+     */
+    void ReportFailure(size_t backend);
+
+    /*
+     * @brief Channels currently counted on a backend
+     */
+    int Active(size_t backend);
+
+    /*
+     * @brief Whether a backend is currently excluded from Pick()
+     */
+    bool Excluded(size_t backend);
+
+    /*
+     * @brief Starts the health-check thread; it stops with `running`. Returns
+     * a non-joinable thread when there is only one backend to choose from.
+     */
+    std::thread Run();
+
+  private:
+    struct Backend {
+        std::string name; // host:port, for logs
+        int weight = 1;
+        std::unique_ptr<GuacdClient> client;
+        std::unique_ptr<GuacdPool> pool;
+        // Guarded by mtx.
+        int active = 0;
+        int failures = 0; // consecutive failed dials
+        bool excluded = false;
+    };
+
+    // Parses `spec` into backends; leaves none if any entry is malformed.
+    void Parse(const std::string &spec);
+
+    std::vector<std::unique_ptr<Backend>> backends;
+    int max_fails;
+    std::chrono::milliseconds health_interval;
+
+    std::mutex mtx;
+    size_t cursor = 0; // where the next Pick() starts, to rotate ties
+};
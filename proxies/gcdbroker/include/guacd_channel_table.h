@@ -0,0 +1,66 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/channeltable.h"
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+/*
+ * @brief gcdbroker's per-channel slot state: the guacd backend serving it
+ */
+struct GcdChannelState {
+    std::atomic<int16_t> backend{-1};
+};
+
+/*
+ * @brief gcdbroker's flat channel table: the guacd fd and the backend it was
+ * dialed on, so every write for a channel goes to the guacd that holds its
+ * session.
+ *
+ * Bind() records the backend before it publishes the fd, so anyone who sees
+ * the fd through Get() also sees its backend. Channels are only bound from
+ * GuacdSendHandler's thread.
+ */
+class GuacdChannelTable : public BasicChannelTable<GcdChannelState> {
+  public:
+    /*
+     * @brief Binds a channel to a connection on a backend
+     * @return False if the channel was already in use
+     */
+    bool Bind(uint16_t channel, int fd, size_t backend) {
+        if (Get(channel))
+            return false;
+        StateOf(channel).backend.store(static_cast<int16_t>(backend),
+                                       std::memory_order_relaxed);
+        return Insert(channel, fd);
+    }
+
+    /*
+     * @brief The backend a bound channel was dialed on
+     */
+    size_t Backend(uint16_t channel) const {
+        int16_t backend =
+            StateOf(channel).backend.load(std::memory_order_relaxed);
+        return backend < 0 ? 0 : static_cast<size_t>(backend);
+    }
+};
@@ -0,0 +1,104 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/netqueue.h"
+#include "guacd_backends.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The outcome of one dial, as the routing thread collects it
+ */
+struct DialResult {
+    uint16_t channel;
+    uint64_t ticket; // the caller's tag; tells a stale result apart
+    size_t backend;  // the guacd backend dialed
+    int fd;          // the connected socket, or -1 if the dial failed
+};
+
+/**
+ * @brief Dials guacd off the routing thread.
+ *
+ * GuacdSendHandler forwards every channel's traffic to guacd from one thread,
+ * so it must never wait on a dial. It Submit()s the dial and moves on; one of
+ * GUACD_DIAL_WORKERS worker threads (default 4) runs GuacdClient::Connect on
+ * the chosen backend, bounded by its connect deadline, reports the outcome to
+ * GuacdBackends and queues the result. Several dials are in flight at once, so
+ * a burst of approvals does not serialize behind one slow connect.
+ *
+ * The routing thread blocks on its NetQueue rather than on a poll set, so a
+ * finished dial wakes it by enqueuing an empty NONE message for the channel;
+ * the thread then collects results with TakeResults(). An empty payload has
+ * nothing to forward to guacd, so the wake-up needs no marker of its own.
+ */
+class GuacdConnector {
+  public:
+    GuacdConnector(GuacdBackends &backends, NetQueue &wake_queue);
+
+    /**
+     * @brief Stops the workers, waiting out dials in flight, and closes every
+     * connection nobody collected
+     */
+    ~GuacdConnector();
+
+    GuacdConnector(const GuacdConnector &) = delete;
+    GuacdConnector &operator=(const GuacdConnector &) = delete;
+
+    /**
+     * @brief Queues a dial for a channel; never blocks on the connect
+     * @param channel: the channel the connection is for
+     * @param ticket: returned with the result, to match it to this request
+     * @param backend: the guacd backend to dial
+     */
+    void Submit(uint16_t channel, uint64_t ticket, size_t backend);
+
+    /**
+     * @brief Appends every finished dial to `out`, in the order they finished,
+     * and forgets them. The caller owns the returned fds.
+     */
+    void TakeResults(std::vector<DialResult> &out);
+
+  private:
+    struct Request {
+        uint16_t channel;
+        uint64_t ticket;
+        size_t backend;
+    };
+
+    // Worker thread: dials queued requests until stopped.
+    void Run();
+
+    GuacdBackends &backends;
+    NetQueue &wake_queue;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Request> requests;
+    std::vector<DialResult> results;
+    bool stopping = false;
+
+    std::vector<std::thread> workers; // last: start once the above exist
+};
@@ -0,0 +1,94 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/guacd_client.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/*
+ * @brief A small pool of pre-connected, idle guacd sockets.
+ *
+ * Dialing guacd (getaddrinfo + TCP connect) used to sit between an operator's
+ * APPROVAL and the replayed handshake reaching guacd. The pool keeps a few
+ * connections open ahead of time so GuacdSendHandler can Take() a ready socket
+ * immediately; it falls back to GuacdClient::Connect() when the pool is empty.
+ *
+ * A background thread (Run) tops the pool up and health-checks idle sockets.
+ * guacd waits for `select` only so long before dropping a connection, so idle
+ * sockets are recycled after GUACD_POOL_MAX_IDLE_MS (default 10 s, under
+ * guacd's 15 s handshake timeout); each recycle shows up in guacd's log as a
+ * connection that never sent `select`. Sized by GUACD_POOL_SIZE (default 0:
+ * disabled).
+ */
+class GuacdPool {
+  public:
+    explicit GuacdPool(GuacdClient &guacd_client);
+
+    /**
+     * @brief Closes every idle socket still in the pool
+     */
+    ~GuacdPool();
+
+    GuacdPool(const GuacdPool &) = delete;
+    GuacdPool &operator=(const GuacdPool &) = delete;
+
+    /**
+     * @brief Whether the pool holds any connections at all (GUACD_POOL_SIZE > 0)
+     */
+    bool Enabled() const { return target > 0; }
+
+    /**
+     * @brief Starts the refill / health-check thread; it stops with `running`
+     */
+    std::thread Run();
+
+    /**
+     * @brief Hands out a healthy pre-connected socket, or -1 if none is ready
+     *
+     * The caller owns the returned fd (close it with GuacdClient::Close).
+     */
+    int Take();
+
+  private:
+    struct Idle {
+        int fd;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    /**
+     * @brief Whether an idle socket is still usable: guacd sends nothing before
+     * `select`, so any readable state means it closed (or reset) the connection
+     */
+    static bool Healthy(int fd);
+
+    GuacdClient &guacd_client;
+    size_t target;
+    std::chrono::milliseconds max_idle;
+
+    std::mutex mtx;
+    std::condition_variable refill; // signalled by Take() to top up early
+    std::deque<Idle> idle;          // oldest at the front
+};
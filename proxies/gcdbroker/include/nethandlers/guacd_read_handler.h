@@ -20,13 +20,14 @@
 
 #pragma once
 
-#include "../../../shared/include/network/channeltable.h"
 #include "../../../shared/include/network/netqueue.h"
-#include "../../../shared/include/network/guacd_client.h"
 #include "../../../shared/include/network/reader_group.h"
+#include "../../../shared/include/util/timer_wheel.h"
+#include "../guacd_backends.h"
+#include "../guacd_channel_table.h"
 #include <thread>
 
 class GuacdReadHandler {
     public:
-        std::thread Run(NetQueue &recv_queue, NetQueue &send_queue, GuacdClient &guacd_client, ChannelTable &table, ReaderGroup &readers, uint16_t channel, int fd);
+        std::thread Run(NetQueue &recv_queue, NetQueue &send_queue, GuacdBackends &backends, GuacdChannelTable &table, ReaderGroup &readers, TimerWheel &timers, uint16_t channel, int fd, size_t backend);
 };
@@ -21,10 +21,10 @@
 #pragma once
 
 #include "../../../shared/include/network/netqueue.h"
-#include "../../../shared/include/network/udpreceiver.h"
+#include "../../../shared/include/network/bridge_transport.h"
 #include <thread>
 
 class UDPRecvHandler {
     public:
-        std::thread Run(NetQueue &queue, UDPReceiver &udp_receiver);
+        std::thread Run(NetQueue &queue, BridgeReceiver &udp_receiver);
 };
@@ -20,7 +20,7 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
+#include "../../shared/include/parser/opcode_parser_core.h"
 #include <cstddef>
 #include <string>
 
@@ -33,12 +33,15 @@
  * produces the matching reply — the same timestamp echoed back, exactly what a
  * real client sends.
  *
- * It reuses the shared `OpcodeParser` as a neutral Guacamole framer: it allows
- * every opcode (no allowlist — that is the guard's policy) and tolerates the
- * large drawing elements in guacd's output (`ToleratesOversizedElements`), so a
- * full-screen image blob streams past instead of corrupting the parse.
+ * It reuses the shared `OpcodeParserCore` as a neutral Guacamole framer: it
+ * allows every opcode (no allowlist — that is the guard's policy) and tolerates
+ * the large drawing elements in guacd's output (`ToleratesOversizedElements`),
+ * so a full-screen image blob streams past instead of corrupting the parse. Every
+ * instruction but `sync` is skipped by its element lengths (`SkipInstruction`)
+ * and image payloads are jumped over unread, so the cost of a read follows its
+ * instruction count rather than its byte count.
  */
-class SyncFaker : public OpcodeParser {
+class SyncFaker : public OpcodeParserCore<SyncFaker> {
   public:
     /**
      * @brief Feed guacd output bytes; returns the sync replies to send back to
@@ -47,15 +50,19 @@ class SyncFaker : public OpcodeParser {
      */
     std::string Feed(const char *data, size_t len);
 
-  protected:
-    bool ToleratesOversizedElements() override { return true; }
-    bool OnInstructionBegin(const GuacElement &instr) override;
-    bool OnArgument(const GuacElement &arg) override;
-    bool OnInstructionEnd() override;
-
   private:
+    friend class OpcodeParserCore<SyncFaker>;
+
+    bool ToleratesOversizedElements() { return true; }
+    bool OnInstructionBegin(const GuacElement &instr);
+    bool OnArgument(const GuacElement &arg);
+    bool OnInstructionEnd();
+
     bool is_sync = false;    // the current instruction is a `sync`
     int arg_index = 0;       // 1-based index of the argument being parsed
     std::string timestamp;   // the sync's timestamp argument
     std::string echoes;      // replies accumulated during the current Feed()
 };
+
+// Instantiated in sync_faker.cpp, next to the hooks it inlines.
+extern template class OpcodeParserCore<SyncFaker>;
@@ -0,0 +1,195 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_backends.h"
+#include "../../shared/include/util/running.h"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+// Consecutive failed dials that take a backend out of rotation.
+int guacd_backend_max_fails() {
+    const char *env = std::getenv("GUACD_BACKEND_MAX_FAILS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 3;
+}
+
+// How often every backend is probed with a fresh connection.
+int guacd_health_ms() {
+    const char *env = std::getenv("GUACD_HEALTH_MS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 5000;
+}
+
+// Parses a positive integer that makes up the whole of `s`.
+bool parse_positive(const std::string &s, int &out) {
+    if (s.empty() || s.size() > 9)
+        return false;
+    for (char c : s)
+        if (c < '0' || c > '9')
+            return false;
+    out = std::atoi(s.c_str());
+    return out > 0;
+}
+} // namespace
+
+GuacdBackends::GuacdBackends(const std::string &default_host, int default_port)
+    : max_fails(guacd_backend_max_fails()),
+      health_interval(guacd_health_ms()) {
+    const char *env = std::getenv("GUACD_BACKENDS");
+    Parse(env && *env ? std::string(env)
+                      : default_host + ":" + std::to_string(default_port));
+}
+
+GuacdBackends::GuacdBackends(const std::string &spec)
+    : max_fails(guacd_backend_max_fails()),
+      health_interval(guacd_health_ms()) {
+    Parse(spec);
+}
+
+void GuacdBackends::Parse(const std::string &spec) {
+    std::stringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        auto backend = std::make_unique<Backend>();
+        size_t at = entry.find('@');
+        if (at != std::string::npos &&
+            !parse_positive(entry.substr(at + 1), backend->weight)) {
+            std::cerr << "GUACD_BACKENDS: bad weight in '" << entry << "'"
+                      << std::endl;
+            backends.clear();
+            return;
+        }
+        std::string address = entry.substr(0, at);
+        size_t colon = address.rfind(':');
+        int port = 0;
+        if (colon == std::string::npos || colon == 0 ||
+            !parse_positive(address.substr(colon + 1), port) || port > 65535) {
+            std::cerr << "GUACD_BACKENDS: expected host:port[@weight], got '"
+                      << entry << "'" << std::endl;
+            backends.clear();
+            return;
+        }
+        backend->name = address;
+        backend->client =
+            std::make_unique<GuacdClient>(address.substr(0, colon), port);
+        backend->pool = std::make_unique<GuacdPool>(*backend->client);
+        backends.push_back(std::move(backend));
+    }
+    if (backends.empty())
+        std::cerr << "GUACD_BACKENDS: no backends given" << std::endl;
+}
+
+size_t GuacdBackends::Pick() {
+    std::lock_guard<std::mutex> lock(mtx);
+    bool any_healthy = false;
+    for (const auto &b : backends)
+        any_healthy = any_healthy || !b->excluded;
+
+    // Weighted least-connections: minimise (active + 1) / weight, compared by
+    // cross-multiplying. Scanning from a rotating cursor spreads ties.
+    size_t best = 0;
+    bool found = false;
+    for (size_t i = 0; i < backends.size(); ++i) {
+        size_t idx = (cursor + i) % backends.size();
+        const Backend &b = *backends[idx];
+        if (any_healthy && b.excluded)
+            continue;
+        const Backend &cur = *backends[best];
+        if (!found || static_cast<int64_t>(b.active + 1) * cur.weight <
+                          static_cast<int64_t>(cur.active + 1) * b.weight) {
+            best = idx;
+            found = true;
+        }
+    }
+    cursor = (best + 1) % backends.size();
+    ++backends[best]->active;
+    return best;
+}
+
+void GuacdBackends::Release(size_t backend) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (backends[backend]->active > 0)
+        --backends[backend]->active;
+}
+
+void GuacdBackends::ReportSuccess(size_t backend) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Backend &b = *backends[backend];
+    b.failures = 0;
+    if (b.excluded) {
+        b.excluded = false;
+        std::cout << "guacd_backends: " << b.name << " is back in rotation"
+                  << std::endl;
+    }
+}
+
+void GuacdBackends::ReportFailure(size_t backend) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Backend &b = *backends[backend];
+    if (++b.failures >= max_fails && !b.excluded) {
+        b.excluded = true;
+        std::cerr << "guacd_backends: " << b.name << " excluded after "
+                  << b.failures << " failed connections" << std::endl;
+    }
+}
+
+int GuacdBackends::Active(size_t backend) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return backends[backend]->active;
+}
+
+bool GuacdBackends::Excluded(size_t backend) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return backends[backend]->excluded;
+}
+
+std::thread GuacdBackends::Run() {
+    if (backends.size() < 2)
+        return std::thread(); // nothing to choose between
+    std::cout << "guacd_backends: balancing over " << backends.size()
+              << " guacd backends, health check every "
+              << health_interval.count() << " ms" << std::endl;
+
+    return std::thread([this]() {
+        auto next = std::chrono::steady_clock::now();
+        while (running) {
+            // Sleep in short steps so shutdown is not held up by the interval.
+            if (std::chrono::steady_clock::now() < next) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
+            next = std::chrono::steady_clock::now() + health_interval;
+
+            // A probe is a plain connect, closed at once (guacd logs it as a
+            // connection that never sent `select`).
+            for (size_t i = 0; i < backends.size() && running; ++i) {
+                int fd = backends[i]->client->Connect();
+                if (fd >= 0) {
+                    backends[i]->client->Close(fd);
+                    ReportSuccess(i);
+                } else {
+                    ReportFailure(i);
+                }
+            }
+        }
+    });
+}
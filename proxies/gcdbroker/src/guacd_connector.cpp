@@ -0,0 +1,94 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_connector.h"
+#include <cstdlib>
+#include <utility>
+
+namespace {
+// Dials that may be in flight at once.
+int guacd_dial_workers() {
+    const char *env = std::getenv("GUACD_DIAL_WORKERS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 4;
+}
+} // namespace
+
+GuacdConnector::GuacdConnector(GuacdBackends &backends, NetQueue &wake_queue)
+    : backends(backends), wake_queue(wake_queue) {
+    int n = guacd_dial_workers();
+    for (int i = 0; i < n; ++i)
+        workers.emplace_back([this]() { Run(); });
+}
+
+GuacdConnector::~GuacdConnector() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    for (const DialResult &r : results)
+        backends.Client(r.backend).Close(r.fd);
+}
+
+void GuacdConnector::Submit(uint16_t channel, uint64_t ticket,
+                            size_t backend) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        requests.push_back(Request{channel, ticket, backend});
+    }
+    cv.notify_one();
+}
+
+void GuacdConnector::TakeResults(std::vector<DialResult> &out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    out.insert(out.end(), results.begin(), results.end());
+    results.clear();
+}
+
+void GuacdConnector::Run() {
+    while (true) {
+        Request req;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+                return; // requests not yet dialed are dropped
+            req = requests.front();
+            requests.pop_front();
+        }
+
+        int fd = backends.Client(req.backend).Connect();
+        if (fd >= 0)
+            backends.ReportSuccess(req.backend);
+        else
+            backends.ReportFailure(req.backend);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            results.push_back(
+                DialResult{req.channel, req.ticket, req.backend, fd});
+        }
+        BridgeMessage wake{req.channel, ChannelAction::NONE, ""};
+        wake_queue.Enqueue(std::move(wake));
+    }
+}
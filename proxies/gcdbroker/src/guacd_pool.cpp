@@ -0,0 +1,136 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_pool.h"
+#include "../../shared/include/util/running.h"
+#include <cstdlib>
+#include <iostream>
+#include <poll.h>
+#include <vector>
+
+namespace {
+// Idle connections kept ready for approved channels; 0 disables the pool.
+size_t guacd_pool_size() {
+    const char *env = std::getenv("GUACD_POOL_SIZE");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? static_cast<size_t>(v) : 0;
+}
+
+// Age at which an idle connection is recycled. guacd drops a connection that
+// has not sent `select` within its handshake timeout (15 s), so stay under it.
+int guacd_pool_max_idle_ms() {
+    const char *env = std::getenv("GUACD_POOL_MAX_IDLE_MS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 10000;
+}
+
+// How often the refill thread re-checks the pool when nothing was taken.
+constexpr int POOL_CHECK_MS = 1000;
+} // namespace
+
+GuacdPool::GuacdPool(GuacdClient &guacd_client)
+    : guacd_client(guacd_client), target(guacd_pool_size()),
+      max_idle(guacd_pool_max_idle_ms()) {}
+
+GuacdPool::~GuacdPool() {
+    for (const Idle &conn : idle)
+        guacd_client.Close(conn.fd);
+}
+
+bool GuacdPool::Healthy(int fd) {
+    struct pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    return ::poll(&pfd, 1, 0) == 0;
+}
+
+int GuacdPool::Take() {
+    if (!Enabled())
+        return -1;
+
+    std::vector<int> stale;
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        // Newest first: it has the most time left before guacd gives up on it.
+        while (!idle.empty()) {
+            Idle conn = idle.back();
+            idle.pop_back();
+            if (now - conn.since < max_idle && Healthy(conn.fd)) {
+                fd = conn.fd;
+                break;
+            }
+            stale.push_back(conn.fd);
+        }
+    }
+    refill.notify_one();
+
+    for (int dead : stale)
+        guacd_client.Close(dead);
+    return fd;
+}
+
+std::thread GuacdPool::Run() {
+    return std::thread([this]() {
+        if (!Enabled())
+            return;
+        std::cout << "guacd_pool: keeping " << target
+                  << " idle guacd connections (recycled after "
+                  << max_idle.count() << " ms)" << std::endl;
+
+        while (running) {
+            // Drop connections that aged out or that guacd closed.
+            std::vector<int> stale;
+            size_t missing = 0;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto now = std::chrono::steady_clock::now();
+                for (auto it = idle.begin(); it != idle.end();) {
+                    if (now - it->since >= max_idle || !Healthy(it->fd)) {
+                        stale.push_back(it->fd);
+                        it = idle.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                missing = target > idle.size() ? target - idle.size() : 0;
+            }
+            for (int fd : stale)
+                guacd_client.Close(fd);
+
+            // Dial outside the lock so Take() never waits on a connect. Stop
+            // at the first failure (guacd down) and retry on the next round.
+            for (size_t i = 0; i < missing && running; ++i) {
+                int fd = guacd_client.Connect();
+                if (fd < 0) {
+                    std::cerr << "guacd_pool: could not pre-connect to guacd,"
+                                 " retrying later" << std::endl;
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                idle.push_back(Idle{fd, std::chrono::steady_clock::now()});
+            }
+
+            std::unique_lock<std::mutex> lock(mtx);
+            refill.wait_for(lock, std::chrono::milliseconds(POOL_CHECK_MS));
+        }
+    });
+}
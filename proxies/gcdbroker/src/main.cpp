@@ -18,27 +18,28 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-#include "../../shared/include/network/channeltable.h"
 #include "../../shared/include/network/netqueue.h"
-#include "../../shared/include/network/guacd_client.h"
+#include "../../shared/include/network/bridge_transport.h"
 #include "../../shared/include/network/reader_group.h"
-#include "../../shared/include/network/udpreceiver.h"
-#include "../../shared/include/network/udpsender.h"
 #include "../../shared/include/util/netargs.h"
 #include "../../shared/include/util/queue_monitor.h"
+#include "../../shared/include/util/timer_wheel.h"
+#include "../include/guacd_backends.h"
+#include "../include/guacd_channel_table.h"
 #include "../include/nethandlers/guacd_send_handler.h"
 #include "../include/nethandlers/udp_recv_handler.h"
 #include "../include/nethandlers/udp_send_handler.h"
-#include "../include/running.h"
+#include "../../shared/include/util/running.h"
 #include <atomic>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <signal.h>
 #include <string>
 #include <thread>
+#include <vector>
 
-std::atomic<bool> running = true;
-
+namespace {
 /*
  * @brief Signals all threads to stop when an interrupt signal is received
  */
@@ -46,13 +47,15 @@ void interrupt_handler(int signum) {
     std::cout << "Interrupt received, stopping program..." << std::endl;
     running = false;
 }
+} // namespace
 
 /*
  * @brief Starts the guacd broker that imitates the Guacamole web server and
  * bridges Guacamole traffic.
  *
  * Reacts to channel lifecycle messages from the bridge, opening one guacd
- * connection per channel. Handlers run on separate threads and synchronize
+ * connection per channel. The command line names the guacd to use;
+ * GUACD_BACKENDS replaces it with several, load-balanced per channel. Handlers run on separate threads and synchronize
  * messages using thread-safe queues.
  */
 int main(int argc, char *argv[]) {
@@ -60,6 +63,8 @@ int main(int argc, char *argv[]) {
         std::cerr << "Usage: " << argv[0] << "\n"
                   << "\t<guacd_ip>: guacd's IP address\n"
                   << "\t<guacd_port>: guacd's listening port\n"
+                  << "\t(GUACD_BACKENDS=host:port[@weight],... lists several"
+                     " guacd instead)\n"
                   << "\t<udp_recv_port>: port where the broker receives traffic from\n"
                   << "\t<udp_send_ip>: address where the broker sends guacd traffic to (lrx_proxy)\n"
                   << "\t<udp_send_port>: port where the broker sends guacd traffic to\n"
@@ -91,23 +96,32 @@ int main(int argc, char *argv[]) {
 
     // Initialize UDP and TCP infrastructure
     int exit;
-    UDPReceiver udp_receiver(udp_recv_port);
-    if ((exit = udp_receiver.Initialize()) != 0)
+    // The bridge hops: UDP, or shared-memory rings when both neighbours run
+    // on this host (BRIDGE_TRANSPORT=shm).
+    std::unique_ptr<BridgeReceiver> udp_receiver =
+        MakeBridgeReceiver(udp_recv_port);
+    if ((exit = udp_receiver->Initialize()) != 0)
         return exit;
 
-    std::cout << "Initialized UDP receiver on port " << udp_recv_port
+    std::cout << "Initialized bridge receiver on port " << udp_recv_port
               << std::endl;
 
-    UDPSender udp_sender(udp_send_ip, udp_send_port);
-    if ((exit = udp_sender.Initialize()) != 0)
+    std::unique_ptr<BridgeSender> udp_sender =
+        MakeBridgeSender(udp_send_ip, udp_send_port);
+    if ((exit = udp_sender->Initialize()) != 0)
         return exit;
 
-    std::cout << "Initialized UDP sender for " << udp_send_ip << ":"
+    std::cout << "Initialized bridge sender for " << udp_send_ip << ":"
               << udp_send_port << std::endl;
 
-    auto guacd_client = GuacdClient(guacd_ip, guacd_port);
-    ChannelTable table;
+    // The guacd backends, each with its pool of pre-connected sockets
+    // (GUACD_POOL_SIZE)
+    GuacdBackends backends(guacd_ip, guacd_port);
+    if (!backends.Valid())
+        return 1;
+    GuacdChannelTable table;
     ReaderGroup readers; // Tracks the per-channel guacd reader threads for shutdown
+    TimerWheel timers; // guacd keepalives for all channels
     NetQueue recv_queue;
     NetQueue send_queue;
 
@@ -118,20 +132,28 @@ int main(int argc, char *argv[]) {
     UDPRecvHandler udp_recv_handler;
 
     std::thread t_guacd_send =
-        guacd_send_handler.Run(recv_queue, send_queue, guacd_client, table, readers);
-    std::thread t_udp_send = udp_send_handler.Run(send_queue, udp_sender);
-    std::thread t_udp_recv = udp_recv_handler.Run(recv_queue, udp_receiver);
+        guacd_send_handler.Run(recv_queue, send_queue, backends, table, readers,
+                               timers);
+    std::vector<std::thread> t_guacd_pools;
+    for (size_t b = 0; b < backends.Size(); ++b)
+        t_guacd_pools.push_back(backends.Pool(b).Run());
+    // Health checks, only when there is more than one backend.
+    std::thread t_guacd_health = backends.Run();
+    std::thread t_udp_send = udp_send_handler.Run(send_queue, *udp_sender);
+    std::thread t_udp_recv = udp_recv_handler.Run(recv_queue, *udp_receiver);
 
     // Optional diagnostic (set QUEUE_STATS_MS): watch for the return-path
     // send_queue growing, which means the bridge can't drain guacd's output.
     // std::thread t_qstats =
     //     StartQueueMonitor(recv_queue, send_queue, running, "gcdbroker");
 
-    // Shutdown ordering (SIGINT clears `running`): the UDP receiver's blocked
-    // recvfrom times out (SO_RCVTIMEO), so t_udp_recv falls out of its loop first
+    // Shutdown ordering (SIGINT clears `running`): the bridge receiver's wait
+    // times out (200 ms), so t_udp_recv falls out of its loop first
     // and stops feeding recv_queue. Closing recv_queue drains t_guacd_send, which
-    // both spawns the readers and is the last producer for send_queue; once it
-    // has joined, only the detached guacd readers still touch the table. We wake
+    // both spawns the readers and is the last producer for send_queue; on exit
+    // it waits out its guacd dials in flight (at most GUACD_CONNECT_TIMEOUT_MS)
+    // and closes any it can no longer use. Once it has joined, only the
+    // detached guacd readers still touch the table. We wake
     // those readers (they block in recv()) by shutting down their fds — each
     // reader still owns its own close() — and WaitAll() for them before
     // destroying the state they capture. Finally send_queue is closed to drain
@@ -141,11 +163,17 @@ int main(int argc, char *argv[]) {
     t_udp_recv.join();
     recv_queue.Close();
     t_guacd_send.join();
+    // The pools wake within a check interval; their sockets close with them.
+    for (std::thread &t : t_guacd_pools)
+        t.join();
+    if (t_guacd_health.joinable())
+        t_guacd_health.join();
 
     for (int fd : table.Fds())
-        guacd_client.Shutdown(fd);
+        backends.Client(0).Shutdown(fd); // any client: Shutdown is per fd
     readers.WaitAll();
 
     send_queue.Close();
     t_udp_send.join();
+    return 0;
 }
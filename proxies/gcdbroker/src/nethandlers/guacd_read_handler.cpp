@@ -20,18 +20,18 @@
 
 #include "../../include/nethandlers/guacd_read_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include "../../include/sync_faker.h"
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
 
 namespace {
 // How long guacd may go without a sync from us before we re-send the last one
 // as a keepalive. Must stay well under guacd's "user not responding" timeout.
-// Matches the GUACD_KEEPALIVE_MS used for the socket receive timeout.
 std::chrono::milliseconds keepalive_interval() {
     const char *env = std::getenv("GUACD_KEEPALIVE_MS");
     int v = env ? std::atoi(env) : 0;
@@ -51,25 +51,48 @@ std::chrono::milliseconds keepalive_interval() {
  * and the matching acknowledgement is routed back toward guacd via recv_queue —
  * the same path the bridge's forward traffic takes, so GuacdSendHandler stays
  * the sole writer to guacd (no extra locking on the connection).
+ *
+ * The keepalive toward guacd is a timer on the shared wheel rather than a
+ * receive timeout, so the reader itself only wakes when guacd sends something.
+ *
+ * The channel counts against its guacd backend until this reader has closed
+ * the connection.
  */
 std::thread GuacdReadHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
-                                GuacdClient &guacd_client,
-                                ChannelTable &table, ReaderGroup &readers,
-                                uint16_t channel, int fd) {
-    return std::thread([&recv_queue, &send_queue, &guacd_client, &table, &readers, channel, fd]() {
+                                GuacdBackends &backends,
+                                GuacdChannelTable &table, ReaderGroup &readers,
+                                TimerWheel &timers, uint16_t channel, int fd,
+                                size_t backend) {
+    return std::thread([&recv_queue, &send_queue, &backends, &table, &readers, &timers, channel, fd, backend]() {
         // Declared first so it is destroyed last: Leave() runs only after all
         // shared-state access below is done, letting main's WaitAll() proceed.
         ReaderGroup::Sentinel sentinel(readers);
+        GuacdClient &guacd_client = backends.Client(backend);
 
         char buffer[Multiplexer::MAX_PAYLOAD_SIZE + 1];
         SyncFaker sync_faker; // synthesises the client's sync ack toward guacd
-        std::string last_ack; // most recent sync ack, re-sent as a keepalive
         const auto keepalive = keepalive_interval();
-        auto last_sent = std::chrono::steady_clock::now(); // last sync sent to guacd
+
+        // Time-based keepalive: if guacd hasn't heard a sync from us within
+        // `keepalive`, the wheel re-sends the last one. The browser's own
+        // periodic keepalive was swallowed on the forward path, so without this
+        // an idle (or syncless-trickle) session trips guacd's read timeout.
+        // Every real ack pushes the timer out again; it is cancelled before
+        // this frame (and so `last_ack`) goes away.
+        std::mutex ack_mtx;
+        std::string last_ack; // most recent sync ack, re-sent as a keepalive
+        TimerWheel::TimerId keepalive_timer = 0;
+        auto send_keepalive = [&recv_queue, &ack_mtx, &last_ack, channel]() {
+            BridgeMessage ka{channel, ChannelAction::NONE, ""};
+            {
+                std::lock_guard<std::mutex> lock(ack_mtx);
+                ka.payload = last_ack;
+            }
+            recv_queue.Enqueue(std::move(ka));
+        };
 
         while (running) {
             int received = guacd_client.Receive(fd, buffer, sizeof(buffer));
-            auto now = std::chrono::steady_clock::now();
 
             if (received > 0) {
                 BridgeMessage msg;
@@ -82,29 +105,28 @@ std::thread GuacdReadHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
                 // sync guacd just emitted (the guard dropped the real one).
                 std::string ack = sync_faker.Feed(buffer, received);
                 if (!ack.empty()) {
-                    last_ack = ack; // remember for the keepalive below
+                    {
+                        std::lock_guard<std::mutex> lock(ack_mtx);
+                        last_ack = ack; // remember for the keepalive
+                    }
                     BridgeMessage sync{channel, ChannelAction::NONE, std::move(ack)};
                     recv_queue.Enqueue(std::move(sync));
-                    last_sent = now;
-                    continue; // a real ack just went out; no keepalive needed
+                    // A real ack just went out; the next keepalive is due one
+                    // interval from now. Data without a sync leaves the timer
+                    // running, so a busy-but-syncless trickle (panel clock,
+                    // cursor) still can't starve guacd.
+                    if (!keepalive_timer)
+                        keepalive_timer =
+                            timers.Arm(keepalive, send_keepalive, keepalive);
+                    else
+                        timers.Rearm(keepalive_timer, keepalive);
                 }
-                // Data arrived but carried no sync to echo — fall through to the
-                // time-based keepalive so a busy-but-syncless trickle (panel
-                // clock, cursor) still can't starve guacd.
-            } else if (received != GuacdClient::RECV_TIMEOUT) {
+            } else {
                 break; // 0: guacd closed, <0: error
             }
-
-            // Time-based keepalive: if guacd hasn't heard a sync from us within
-            // `keepalive`, re-send the last one. The browser's own periodic
-            // keepalive was swallowed on the forward path, so without this an idle
-            // (or syncless-trickle) session trips guacd's read timeout.
-            if (!last_ack.empty() && now - last_sent >= keepalive) {
-                BridgeMessage ka{channel, ChannelAction::NONE, last_ack};
-                recv_queue.Enqueue(std::move(ka));
-                last_sent = now;
-            }
         }
+        if (keepalive_timer)
+            timers.Cancel(keepalive_timer);
 
         // Only the side that initiates the close announces SHUTDOWN to the peer
         if (table.Remove(channel).has_value()) {
@@ -116,5 +138,6 @@ std::thread GuacdReadHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
                       << " closed by guacd, sent SHUTDOWN" << std::endl;
         }
         guacd_client.Close(fd);
+        backends.Release(backend);
     });
 }
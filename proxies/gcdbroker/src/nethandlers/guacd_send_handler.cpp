@@ -20,11 +20,36 @@
 
 #include "../../include/nethandlers/guacd_send_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
+#include "../../include/guacd_connector.h"
 #include "../../include/nethandlers/guacd_read_handler.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
+#include <cstdlib>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+// Bytes held for one channel while its guacd dial is in flight. The replayed
+// handshake is a few KB; a channel that outgrows this is torn down rather than
+// trimmed, since dropping part of its stream would corrupt it.
+size_t guacd_dial_buffer_bytes() {
+    const char *env = std::getenv("GUACD_DIAL_BUFFER_BYTES");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? static_cast<size_t>(v) : 256 * 1024;
+}
+
+/*
+ * @brief A channel approved but still waiting for its guacd connection
+ */
+struct PendingDial {
+    uint64_t ticket;                  // matches the connector's result
+    size_t backend;                   // the guacd backend being dialed
+    std::vector<std::string> backlog; // traffic for guacd, in arrival order
+    size_t bytes = 0;
+};
+} // namespace
 
 /*
  * @brief Routes bridge messages to guacd connections by channel.
@@ -35,17 +60,103 @@
  * to gmlbroker, and drops any NONE for a channel it has not dialed. So no
  * Guacamole reaches guacd before the operator approves. Once dialed, NONE
  * traffic is forwarded to guacd untouched (the guard validated it en route).
+ *
+ * Each approved channel is given a guacd backend (GuacdBackends::Pick) and
+ * stays on it: the table records the backend with the fd. The dial takes a
+ * pre-connected socket from that backend's GuacdPool when one is ready.
+ * Otherwise it is handed to a GuacdConnector and this thread moves on: a slow
+ * or unreachable guacd must not stall the traffic of every live channel. The
+ * approval is relayed at once, so the replayed handshake crosses the bridge
+ * while the dial completes; traffic that arrives in the meantime is held in
+ * order (up to GUACD_DIAL_BUFFER_BYTES) and flushed once the socket is up. A
+ * dial that fails tears the channel down with a SHUTDOWN on the return path.
  */
 std::thread GuacdSendHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
-                                GuacdClient &guacd_client, ChannelTable &table,
-                                ReaderGroup &readers) {
-    return std::thread([&recv_queue, &send_queue, &guacd_client, &table, &readers]() {
+                                GuacdBackends &backends,
+                                GuacdChannelTable &table, ReaderGroup &readers,
+                                TimerWheel &timers) {
+    return std::thread([&recv_queue, &send_queue, &backends, &table, &readers, &timers]() {
+        // Destroyed when this thread exits: waits out dials in flight and
+        // closes any connection that arrived too late to be used.
+        GuacdConnector connector(backends, recv_queue);
+        std::unordered_map<uint16_t, PendingDial> dialing;
+        std::vector<DialResult> dialed;
+        uint64_t next_ticket = 0;
+        const size_t dial_buffer = guacd_dial_buffer_bytes();
+
+        // Registers a connected channel and starts its reader, which releases
+        // the backend when it closes. False if the channel is already in use.
+        auto attach = [&](uint16_t channel, int fd, size_t backend) {
+            if (!table.Bind(channel, fd, backend))
+                return false;
+            // Count the reader in before launching it; this handler thread is
+            // joined on shutdown before WaitAll runs, so the count is final by
+            // then.
+            readers.Enter();
+            GuacdReadHandler reader;
+            reader.Run(recv_queue, send_queue, backends, table, readers,
+                       timers, channel, fd, backend)
+                .detach();
+            return true;
+        };
+
+        // Tells gmlbroker to tear the browser down.
+        auto echo_shutdown = [&](uint16_t channel) {
+            BridgeMessage echo{channel, ChannelAction::SHUTDOWN_CHANNEL, ""};
+            send_queue.Enqueue(std::move(echo));
+        };
+
+        // Forwards one payload to a dialed channel, tearing it down on failure.
+        auto forward = [&](uint16_t channel, int fd, const std::string &data) {
+            GuacdClient &guacd_client = backends.Client(table.Backend(channel));
+            if (guacd_client.Send(fd, data.data(), data.size()) < 0) {
+                std::optional<int> dead = table.Remove(channel);
+                if (dead)
+                    guacd_client.Shutdown(*dead);
+                return false;
+            }
+            return true;
+        };
+
         while (running) {
             std::optional<BridgeMessage> opt = recv_queue.Dequeue();
             if (!opt)
                 break; // queue closed and drained: shutting down
             BridgeMessage msg = std::move(*opt);
 
+            // Settle finished dials first, so a channel's backlog is flushed
+            // before any later traffic for it is forwarded.
+            dialed.clear();
+            connector.TakeResults(dialed);
+            for (const DialResult &r : dialed) {
+                auto it = dialing.find(r.channel);
+                if (it == dialing.end() || it->second.ticket != r.ticket) {
+                    // Shut down (or torn down) while dialing: nobody wants it.
+                    backends.Client(r.backend).Close(r.fd);
+                    continue;
+                }
+                PendingDial pending = std::move(it->second);
+                dialing.erase(it);
+
+                if (r.fd >= 0 && attach(r.channel, r.fd, r.backend)) {
+                    std::cout << "guacd_send_handler: channel "
+                              << (int)r.channel << " connected to guacd "
+                              << backends.Name(r.backend) << ", flushing "
+                              << pending.bytes << " held bytes" << std::endl;
+                    for (const std::string &data : pending.backlog)
+                        if (!forward(r.channel, r.fd, data))
+                            break;
+                    continue;
+                }
+                backends.Client(r.backend).Close(r.fd);
+                backends.Release(r.backend);
+                // The approval already went out: tear down instead.
+                std::cerr << "guacd_send_handler: channel " << (int)r.channel
+                          << " dial to guacd " << backends.Name(r.backend)
+                          << " failed; relaying SHUTDOWN" << std::endl;
+                echo_shutdown(r.channel);
+            }
+
             switch (msg.action) {
             case ChannelAction::CREATE_CHANNEL:
                 // The guard owns the decision; gcdbroker waits for the verdict
@@ -61,31 +172,32 @@ std::thread GuacdSendHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
                 char verdict =
                     msg.payload.empty() ? APPROVAL_DENY : msg.payload[0];
                 if (verdict == APPROVAL_APPROVE) {
-                    int fd = guacd_client.Connect();
-                    if (fd >= 0)
+                    bool busy = table.Get(msg.channel).has_value() ||
+                                dialing.count(msg.channel) > 0;
+                    size_t backend = busy ? 0 : backends.Pick();
+                    // A warm pooled socket skips the dial altogether.
+                    int fd = busy ? -1 : backends.Pool(backend).Take();
+                    if (fd >= 0 && attach(msg.channel, fd, backend)) {
+                        std::cout << "guacd_send_handler: APPROVE received,"
+                                     " connected to guacd "
+                                  << backends.Name(backend) << " (pooled)"
+                                  << std::endl;
+                    } else if (!busy) {
+                        backends.Client(backend).Close(fd);
+                        ++next_ticket;
+                        dialing[msg.channel] =
+                            PendingDial{next_ticket, backend, {}, 0};
+                        connector.Submit(msg.channel, next_ticket, backend);
                         std::cout << "guacd_send_handler: APPROVE received,"
-                                     " connected to guacd" << std::endl;
-
-                    if (fd >= 0 && table.Insert(msg.channel, fd)) {
-                        // Count the reader in before launching it; this handler
-                        // thread is joined on shutdown before WaitAll runs, so
-                        // the count is final by then.
-                        readers.Enter();
-                        GuacdReadHandler reader;
-                        reader.Run(recv_queue, send_queue, guacd_client, table, readers, msg.channel, fd)
-                            .detach();
+                                     " dialing guacd "
+                                  << backends.Name(backend) << std::endl;
                     } else {
-                        if (fd >= 0) {
-                            guacd_client.Close(fd);
-                            std::cout << "guacd_send_handler: connection to guacd closed"
-                                      << std::endl;
-                        }
-                        // Dial failed: downgrade the relayed verdict so gmlbroker
-                        // tears down instead of waiting forever.
+                        // Downgrade the relayed verdict so gmlbroker tears down
+                        // instead of waiting forever.
                         msg.payload[0] = APPROVAL_DENY;
                         std::cerr << "guacd_send_handler: channel "
                                   << (int)msg.channel
-                                  << " approved but guacd dial failed; relaying"
+                                  << " approved but already in use; relaying"
                                   << " DENY" << std::endl;
                     }
                 }
@@ -94,9 +206,18 @@ std::thread GuacdSendHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
             }
 
             case ChannelAction::SHUTDOWN_CHANNEL: {
+                // A dial still in flight is abandoned; its socket is closed
+                // when it arrives.
+                auto pending = dialing.find(msg.channel);
+                if (pending != dialing.end()) {
+                    backends.Release(pending->second.backend);
+                    dialing.erase(pending);
+                }
+                size_t backend = table.Backend(msg.channel);
                 std::optional<int> fd = table.Remove(msg.channel);
                 if (fd) {
-                    guacd_client.Shutdown(*fd); // wakes the reader, which closes it
+                    // Wakes the reader, which closes it.
+                    backends.Client(backend).Shutdown(*fd);
                     std::cout << "guacd_send_handler: channel " << (int)msg.channel
                               << " SHUTDOWN from peer, relaying message"
                               << std::endl;
@@ -107,14 +228,35 @@ std::thread GuacdSendHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
                 // bypasses the guard. gmlbroker's SHUTDOWN handler is idempotent,
                 // so a redundant echo for a browser-initiated close is a no-op,
                 // and the "Remove decides who announces" rule stops any loop.
-                BridgeMessage echo{msg.channel, ChannelAction::SHUTDOWN_CHANNEL,
-                                   ""};
-                send_queue.Enqueue(std::move(echo));
+                echo_shutdown(msg.channel);
                 break;
             }
 
             case ChannelAction::NONE:
             default: {
+                // Nothing to forward; also how the connector wakes this thread.
+                if (msg.payload.empty())
+                    break;
+
+                // Hold traffic for a channel whose dial is still in flight.
+                auto pending = dialing.find(msg.channel);
+                if (pending != dialing.end()) {
+                    PendingDial &p = pending->second;
+                    if (p.bytes + msg.payload.size() > dial_buffer) {
+                        std::cerr << "guacd_send_handler: channel "
+                                  << (int)msg.channel << " sent over "
+                                  << dial_buffer << " bytes while dialing"
+                                     " guacd; tearing it down" << std::endl;
+                        backends.Release(p.backend);
+                        dialing.erase(pending);
+                        echo_shutdown(msg.channel);
+                        break;
+                    }
+                    p.bytes += msg.payload.size();
+                    p.backlog.push_back(std::move(msg.payload));
+                    break;
+                }
+
                 // Forward only to approved (dialed) channels. Anything else is
                 // dropped uninspected — no Guacamole reaches guacd before
                 // approval.
@@ -126,12 +268,7 @@ std::thread GuacdSendHandler::Run(NetQueue &recv_queue, NetQueue &send_queue,
                               << " bytes" << std::endl;
                     break;
                 }
-                if (guacd_client.Send(*fd, msg.payload.data(),
-                                    msg.payload.size()) < 0) {
-                    std::optional<int> dead = table.Remove(msg.channel);
-                    if (dead)
-                        guacd_client.Shutdown(*dead);
-                }
+                forward(msg.channel, *fd, msg.payload);
                 break;
             }
             }
@@ -20,13 +20,13 @@
 
 #include "../../include/nethandlers/udp_recv_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include <iostream>
 
 /*
  * @brief Receives datagrams from the bridge and queues the parsed messages
  */
-std::thread UDPRecvHandler::Run(NetQueue &queue, UDPReceiver &udp_receiver) {
+std::thread UDPRecvHandler::Run(NetQueue &queue, BridgeReceiver &udp_receiver) {
     return std::thread([&queue, &udp_receiver]() {
         char buffer[Multiplexer::MAX_DATAGRAM_SIZE + 1];
 
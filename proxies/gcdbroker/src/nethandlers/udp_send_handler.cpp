@@ -20,14 +20,14 @@
 
 #include "../../include/nethandlers/udp_send_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include <iostream>
 #include <string>
 
 /*
  * @brief Serializes queued messages and sends them on the bridge
  */
-std::thread UDPSendHandler::Run(NetQueue &queue, UDPSender &udp_sender) {
+std::thread UDPSendHandler::Run(NetQueue &queue, BridgeSender &udp_sender) {
     return std::thread([&queue, &udp_sender]() {
         while (running) {
             std::optional<BridgeMessage> opt = queue.Dequeue();
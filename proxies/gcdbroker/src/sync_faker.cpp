@@ -20,14 +20,16 @@
 
 #include "../include/sync_faker.h"
 #include <cstring>
+#include <string_view>
 
 std::string SyncFaker::Feed(const char *data, size_t len) {
     echoes.clear();
-    // guacd's output is not ours to police, and it can contain bytes the base
-    // FSM rejects (non-ASCII text, or UTF-8 whose code-point length differs from
-    // its byte length). A latched STREAM_CORRUPTED would silently stop all future
-    // sync echoes and make guacd time the user out, so fail open: skip the
-    // offending byte, resync, and keep scanning for syncs.
+    // guacd's output is not ours to police. Only opcodes and sync arguments
+    // are still validated (the rest is skipped), but a malformed byte there
+    // trips the base FSM. A latched
+    // STREAM_CORRUPTED would silently stop all future sync echoes and make
+    // guacd time the user out, so fail open: skip the offending byte, resync,
+    // and keep scanning for syncs.
     size_t off = 0;
     while (off < len) {
         if (Parse(data + off, len - off) != ParserState::STREAM_CORRUPTED)
@@ -42,6 +44,14 @@ bool SyncFaker::OnInstructionBegin(const GuacElement &instr) {
     is_sync = (instr.len == 4 && memcmp(instr.ptr, "sync", 4) == 0);
     arg_index = 0;
     timestamp.clear();
+    // Only syncs matter: frame past everything else by its lengths. Image data
+    // (blob, and the legacy png/jpeg/webp) is base64, so those lengths are byte
+    // counts and the multi-megabyte payloads are jumped over unread.
+    if (!is_sync) {
+        std::string_view op = instr.View();
+        SkipInstruction(op == "blob" || op == "png" || op == "jpeg" ||
+                        op == "webp");
+    }
     return true; // never deny: this is a neutral observer of guacd's output
 }
 
@@ -60,3 +70,5 @@ bool SyncFaker::OnInstructionEnd() {
                   timestamp + ";";
     return true;
 }
+
+template class OpcodeParserCore<SyncFaker>;
@@ -0,0 +1,113 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_backends.h"
+#include <atomic>
+#include <cassert>
+
+std::atomic<bool> running = true;
+
+/**
+ * @brief GUACD_BACKENDS entries parse as host:port[@weight]; one bad entry
+ * rejects the whole list
+ */
+void test_parse() {
+    GuacdBackends two("guacd-a:4822,10.0.0.7:4823@3");
+    assert(two.Valid() && two.Size() == 2);
+    assert(two.Name(0) == "guacd-a:4822" && two.Name(1) == "10.0.0.7:4823");
+
+    assert(GuacdBackends("guacd:4822").Size() == 1);
+    assert(!GuacdBackends("guacd").Valid());
+    assert(!GuacdBackends(":4822").Valid());
+    assert(!GuacdBackends("guacd:0").Valid());
+    assert(!GuacdBackends("guacd:70000").Valid());
+    assert(!GuacdBackends("guacd:4822@x").Valid());
+    assert(!GuacdBackends("guacd:4822@0").Valid());
+    assert(!GuacdBackends("guacd:4822,,guacd:4823").Valid());
+    assert(!GuacdBackends("").Valid());
+}
+
+/**
+ * @brief With equal weights, a new channel goes to the least active backend
+ */
+void test_least_active() {
+    GuacdBackends backends("a:1,b:2,c:3");
+    size_t first = backends.Pick();
+    size_t second = backends.Pick();
+    size_t third = backends.Pick();
+    assert(first != second && second != third && first != third);
+    for (size_t b = 0; b < 3; ++b)
+        assert(backends.Active(b) == 1);
+
+    backends.Release(second);
+    assert(backends.Pick() == second);
+    assert(backends.Active(second) == 1);
+}
+
+/**
+ * @brief Weights share channels out in proportion
+ */
+void test_weighted() {
+    GuacdBackends backends("big:1@3,small:2");
+    for (int i = 0; i < 8; ++i)
+        backends.Pick();
+    assert(backends.Active(0) == 6 && backends.Active(1) == 2);
+}
+
+/**
+ * @brief Failed dials exclude a backend until one reaches it again; with
+ * every backend excluded, channels are still placed
+ */
+void test_exclusion() {
+    GuacdBackends backends("a:1,b:2");
+    backends.ReportFailure(0);
+    backends.ReportFailure(0);
+    backends.ReportSuccess(0); // a success resets the run
+    backends.ReportFailure(0);
+    backends.ReportFailure(0);
+    assert(!backends.Excluded(0));
+    backends.ReportFailure(0); // GUACD_BACKEND_MAX_FAILS defaults to 3
+    assert(backends.Excluded(0));
+    for (int i = 0; i < 4; ++i)
+        assert(backends.Pick() == 1);
+
+    for (int i = 0; i < 3; ++i)
+        backends.ReportFailure(1);
+    assert(backends.Excluded(1));
+    assert(backends.Pick() == 0); // least active among all of them
+
+    backends.ReportSuccess(0);
+    assert(!backends.Excluded(0));
+}
+
+/**
+ * @brief Unit tests for guacd backend selection
+ */
+int main() {
+    test_parse();
+
+    test_least_active();
+
+    test_weighted();
+
+    test_exclusion();
+
+    return 0;
+}
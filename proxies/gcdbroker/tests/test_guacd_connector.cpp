@@ -0,0 +1,171 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_connector.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> running = true;
+
+namespace {
+
+// A single-backend set for a loopback port.
+std::string loopback(int port) { return "127.0.0.1:" + std::to_string(port); }
+
+// A loopback listener on an ephemeral port; returns its fd and sets `port`.
+int listen_loopback(int backlog, int &port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    assert(::listen(fd, backlog) == 0);
+    socklen_t len = sizeof(addr);
+    assert(::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Waits on the wake queue, as GuacdSendHandler does, until `count` results
+// have been collected.
+std::vector<DialResult> collect(GuacdConnector &connector, NetQueue &queue,
+                                size_t count) {
+    std::vector<DialResult> results;
+    while (results.size() < count) {
+        std::optional<BridgeMessage> wake = queue.Dequeue();
+        assert(wake && wake->action == ChannelAction::NONE);
+        assert(wake->payload.empty());
+        connector.TakeResults(results);
+    }
+    return results;
+}
+
+} // namespace
+
+/**
+ * @brief Dials run in parallel and each comes back, tagged, through the wake
+ * queue
+ */
+void test_dials() {
+    int port;
+    int listener = listen_loopback(16, port);
+    GuacdBackends backends(loopback(port));
+    NetQueue queue;
+    GuacdConnector connector(backends, queue);
+
+    for (uint16_t ch = 1; ch <= 8; ++ch)
+        connector.Submit(ch, 100 + ch, 0);
+    std::vector<DialResult> results = collect(connector, queue, 8);
+    assert(results.size() == 8);
+
+    std::vector<bool> seen(9, false);
+    for (const DialResult &r : results) {
+        assert(r.channel >= 1 && r.channel <= 8 && !seen[r.channel]);
+        seen[r.channel] = true;
+        assert(r.ticket == 100u + r.channel);
+        assert(r.backend == 0 && r.fd >= 0);
+        backends.Client(0).Close(r.fd);
+    }
+    ::close(listener);
+}
+
+/**
+ * @brief A refused dial reports -1 instead of a socket, and enough of them in
+ * a row exclude the backend
+ */
+void test_refused() {
+    int port;
+    ::close(listen_loopback(1, port)); // a port nothing listens on
+    GuacdBackends backends(loopback(port));
+    NetQueue queue;
+    GuacdConnector connector(backends, queue);
+
+    connector.Submit(3, 1, 0);
+    std::vector<DialResult> results = collect(connector, queue, 1);
+    assert(results.size() == 1);
+    assert(results[0].channel == 3 && results[0].fd == -1);
+    assert(!backends.Excluded(0));
+
+    connector.Submit(3, 2, 0);
+    connector.Submit(3, 3, 0);
+    collect(connector, queue, 2);
+    assert(backends.Excluded(0)); // GUACD_BACKEND_MAX_FAILS defaults to 3
+}
+
+/**
+ * @brief A dial that cannot complete gives up at the connect deadline
+ */
+void test_deadline() {
+    setenv("GUACD_CONNECT_TIMEOUT_MS", "300", 1);
+    int port;
+    // A full accept queue that is never drained: further SYNs go unanswered.
+    int listener = listen_loopback(0, port);
+    GuacdClient client("127.0.0.1", port);
+    std::vector<int> fds;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; ++i)
+        fds.push_back(client.Connect());
+    auto took = std::chrono::steady_clock::now() - start;
+    // Each dial either connects or times out; none waits out the kernel's SYN
+    // retries.
+    assert(took < std::chrono::seconds(4));
+    for (int fd : fds)
+        client.Close(fd);
+    ::close(listener);
+    unsetenv("GUACD_CONNECT_TIMEOUT_MS");
+}
+
+/**
+ * @brief A connector with dials still queued shuts down cleanly
+ */
+void test_stop_with_pending() {
+    int port;
+    int listener = listen_loopback(128, port);
+    GuacdBackends backends(loopback(port));
+    NetQueue queue;
+    GuacdConnector connector(backends, queue);
+    for (int i = 0; i < 64; ++i)
+        connector.Submit(static_cast<uint16_t>(i), i, 0);
+    ::close(listener);
+}
+
+/**
+ * @brief Unit tests for the asynchronous guacd connector
+ */
+int main() {
+    test_dials();
+
+    test_refused();
+
+    test_deadline();
+
+    test_stop_with_pending();
+
+    return 0;
+}
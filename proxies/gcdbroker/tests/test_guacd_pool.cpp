@@ -0,0 +1,162 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guacd_pool.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+std::atomic<bool> running = true;
+
+namespace {
+
+// A loopback listener on an ephemeral port; returns its fd and sets `port`.
+int listen_loopback(int backlog, int &port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    assert(::listen(fd, backlog) == 0);
+    socklen_t len = sizeof(addr);
+    assert(::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Accepts one connection the pool dialed, waiting up to `ms`; -1 if none came.
+int accept_within(int listener, int ms) {
+    struct pollfd pfd{listener, POLLIN, 0};
+    if (::poll(&pfd, 1, ms) != 1)
+        return -1;
+    return ::accept(listener, nullptr, nullptr);
+}
+
+// The port a socket's peer (or, with local set, the socket itself) is on: a
+// pooled fd and the "guacd" side of it share this.
+int port_of(int fd, bool local) {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    int r = local ? ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len)
+                  : ::getpeername(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    assert(r == 0);
+    return ntohs(addr.sin_port);
+}
+
+} // namespace
+
+/**
+ * @brief The pool dials up to its target size, hands out connected sockets,
+ * drops an idle one guacd closed and tops itself up again
+ */
+void test_pool() {
+    setenv("GUACD_POOL_SIZE", "3", 1);
+    int port;
+    int listener = listen_loopback(16, port);
+    GuacdClient client("127.0.0.1", port);
+    GuacdPool pool(client);
+    assert(pool.Enabled());
+    std::thread refill = pool.Run();
+
+    // Refilled to the target, and no further.
+    std::map<int, int> guacd; // client-side port -> accepted ("guacd") fd
+    for (int i = 0; i < 3; ++i) {
+        int fd = accept_within(listener, 2000);
+        assert(fd >= 0);
+        guacd[port_of(fd, false)] = fd;
+    }
+    assert(accept_within(listener, 300) == -1);
+
+    // guacd gives up on one idle socket: the health check drops it and dials a
+    // replacement without anything being taken.
+    auto closed = guacd.begin();
+    int closed_port = closed->first;
+    ::close(closed->second);
+    guacd.erase(closed);
+    int fd = accept_within(listener, 3000);
+    assert(fd >= 0);
+    guacd[port_of(fd, false)] = fd;
+
+    // Take() hands out live sockets only, each connected to "guacd". Taking
+    // wakes the refill, so a socket dialed meanwhile may be handed out before
+    // this side has accepted it.
+    int accepted = 4;
+    for (int i = 0; i < 3; ++i) {
+        int taken = pool.Take();
+        assert(taken >= 0);
+        int local = port_of(taken, true);
+        assert(local != closed_port);
+        while (!guacd.count(local)) {
+            fd = accept_within(listener, 2000);
+            assert(fd >= 0);
+            guacd[port_of(fd, false)] = fd;
+            ++accepted;
+        }
+        assert(::send(taken, "x", 1, 0) == 1);
+        char c;
+        assert(::recv(guacd[local], &c, 1, 0) == 1 && c == 'x');
+        client.Close(taken);
+    }
+
+    // The pool is back at its target: three more dials than were taken out.
+    while ((fd = accept_within(listener, 300)) >= 0) {
+        guacd[port_of(fd, false)] = fd;
+        ++accepted;
+    }
+    assert(accepted == 7);
+
+    running = false;
+    refill.join();
+    for (auto &entry : guacd)
+        ::close(entry.second);
+    ::close(listener);
+}
+
+/**
+ * @brief Without GUACD_POOL_SIZE the pool stays off and Take() never blocks
+ */
+void test_disabled() {
+    unsetenv("GUACD_POOL_SIZE");
+    GuacdClient client("127.0.0.1", 1);
+    GuacdPool pool(client);
+    assert(!pool.Enabled());
+    assert(pool.Take() == -1);
+    pool.Run().join(); // returns at once
+}
+
+/**
+ * @brief Unit tests for the warm guacd pool
+ */
+int main() {
+    test_pool();
+
+    test_disabled();
+
+    return 0;
+}
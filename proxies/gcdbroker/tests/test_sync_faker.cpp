@@ -104,22 +104,58 @@ void test_zero_length_elements() {
 }
 
 /*
- * @brief Fail-open resync: a byte the FSM rejects (here a non-ASCII byte inside
- * an element) must not permanently stop echoing — a following sync still echoes.
+ * @brief Fail-open resync: a byte the FSM rejects (here invalid UTF-8 in an
+ * opcode) must not permanently stop echoing — a following sync still echoes.
  */
 void test_recovers_from_corruption() {
     SyncFaker f;
-    // A name carrying a non-ASCII (0xC3) byte would latch STREAM_CORRUPTED; the
-    // sync after it must still be echoed.
-    std::string in = "4.name,3.a";
+    // An opcode carrying a lone lead byte (0xC3) would latch STREAM_CORRUPTED;
+    // the sync after it must still be echoed.
+    std::string in = "4.na";
     in.push_back('\xC3');
-    in += "z;4.sync,1.9;";
+    in += "e,1.a;4.sync,1.9;";
     assert(feed(f, in) == "4.sync,1.9;");
 
     // And the faker keeps working on the next chunk (state was reset, not stuck).
     assert(feed(f, "4.sync,2.42;") == "4.sync,2.42;");
 }
 
+/*
+ * @brief Skipped instructions are framed by code point: non-ASCII arguments of
+ * a non-sync instruction (not validated) are stepped over exactly, also when
+ * split across reads mid-sequence.
+ */
+void test_skips_utf8_arguments() {
+    SyncFaker f;
+    // "é,x" is 3 code points in 4 bytes; a byte-length jump would land on ','.
+    assert(feed(f, "4.name,3.\xC3\xA9,x;4.sync,1.5;") == "4.sync,1.5;");
+    std::string e = feed(f, "4.name,2.a\xC3");
+    e += feed(f, "\xA9;4.sync,1.6;");
+    assert(e == "4.sync,1.6;");
+    // Not validated: a skipped argument may carry malformed UTF-8.
+    assert(feed(f, "4.name,2.\xFF\xFE;4.sync,1.7;") == "4.sync,1.7;");
+}
+
+/*
+ * @brief A blob payload is jumped over by its length, also across reads, and a
+ * blob whose declared length does not end on a delimiter is corruption (the
+ * faker resyncs).
+ */
+void test_jumps_blobs() {
+    SyncFaker f;
+    std::string big(5 << 20, 'A'); // a multi-megabyte base64 payload
+    std::string in = "4.blob,1.0," + std::to_string(big.size()) + "." + big +
+                     ";4.sync,1.3;";
+    // Split the payload across three reads.
+    std::string e = feed(f, in.substr(0, 1000));
+    e += feed(f, in.substr(1000, 3 << 20));
+    e += feed(f, in.substr(1000 + (3 << 20)));
+    assert(e == "4.sync,1.3;");
+
+    // Declared 2, but 3 bytes follow: the byte after the jump is no delimiter.
+    assert(feed(f, "4.blob,1.0,2.abc;4.sync,1.4;") == "4.sync,1.4;");
+}
+
 int main() {
     test_basic_echo();
     test_embedded();
@@ -129,6 +165,8 @@ int main() {
     test_multiple();
     test_zero_length_elements();
     test_recovers_from_corruption();
+    test_skips_utf8_arguments();
+    test_jumps_blobs();
     std::cout << "all SyncFaker tests passed" << std::endl;
     return 0;
 }
@@ -21,7 +21,14 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 /**
  * @brief An approval verdict with an optional human-readable reason
@@ -31,6 +38,15 @@ struct ApprovalResult {
     std::string reason; // populated on denial, empty on approval
 };
 
+/**
+ * @brief A verdict on one submitted request, as the receive loop collects it
+ */
+struct ApprovalVerdict {
+    uint16_t channel;
+    std::string request_id;
+    ApprovalResult result;
+};
+
 /**
  * @brief Decides whether a connection request may proceed toward guacd.
  *
@@ -39,15 +55,30 @@ struct ApprovalResult {
  * before a human authorizes the connection. This is the OT-side gate, and it
  * lives at the guard: the operator commands the guard directly.
  *
+ * Decisions are made off the receive loop. The loop Submit()s a request and
+ * moves on; a worker thread decides it (HandleRequest) and queues the verdict,
+ * signalling WakeFd(), which the loop poll()s alongside its socket before
+ * collecting verdicts with TakeVerdicts(). A slow decision therefore never
+ * stalls the traffic of channels already running. There is one worker, though,
+ * so requests are decided one at a time: a slow decision also holds up every
+ * approval queued behind it.
+ *
  * For the PoC the decision is a single global approve/deny switch, flipped at
- * runtime over the control port (see control_channel.h). It defaults to
- * deny, so a connection is refused until an operator explicitly approves.
- * SetApprove is called from the control-listener thread while HandleRequest
- * runs on the main receive loop, so the switch is atomic.
+ * runtime over the control port (see control_channel.h). SetApprove is called
+ * from the control-listener thread while HandleRequest runs on the worker, so
+ * the switch is atomic.
  */
 class Approver {
   public:
-    Approver() = default;
+    Approver();
+
+    /**
+     * @brief Stops the worker; requests not yet decided are dropped.
+     */
+    ~Approver();
+
+    Approver(const Approver &) = delete;
+    Approver &operator=(const Approver &) = delete;
 
     /**
      * @brief Flips the global approval switch at runtime.
@@ -65,14 +96,58 @@ class Approver {
     }
 
     /**
-     * @brief Decides on a connection request.
+     * @brief Hands a request to the worker; never blocks on the decision.
+     * @param channel: the channel the request arrived on
+     * @param request_id: the inert unique request identifier
+     */
+    void Submit(uint16_t channel, const std::string &request_id);
+
+    /**
+     * @brief The eventfd that becomes readable when verdicts are queued
+     */
+    int WakeFd() const { return event_fd; }
+
+    /**
+     * @brief Also calls @p hook (on the worker) whenever a verdict is queued,
+     * for a receive loop that waits on something other than poll()
+     */
+    void SetWakeHook(std::function<void()> hook);
+
+    /**
+     * @brief Clears the wake state and moves out every queued verdict, in the
+     * order they were decided.
+     */
+    void TakeVerdicts(std::vector<ApprovalVerdict> &out);
+
+    /**
+     * @brief Decides on a connection request. Runs on the worker thread, so it
+     * may block (e.g. on an operator console) without stalling any traffic.
      * @param request_id: the inert unique request identifier
      * @return The approval result
      */
     ApprovalResult HandleRequest(const std::string &request_id);
 
   private:
+    struct Request {
+        uint16_t channel;
+        std::string request_id;
+    };
+
+    // Worker thread: decides requests in arrival order until stopped.
+    void Run();
+
     // The approval mechanism is prepared, but not implemented. Therefore,
     // the default is to approve otherwise a false sense of security is created.
     std::atomic<bool> approve_{true}; // default to approve for now!
+
+    int event_fd = -1;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Request> requests;
+    std::vector<ApprovalVerdict> verdicts;
+    std::function<void()> wake_hook;
+    bool stopping = false;
+
+    std::thread worker; // last: starts once the members above exist
 };
@@ -20,42 +20,145 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
+#include "../../shared/include/parser/opcode_parser_core.h"
 #include "../../shared/include/util/clipboard.h"
+#include "../../shared/include/util/slot_pool.h"
+#include "guard_policy.h"
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <string>
 
 /*
- * @brief Guard parser subclass from `OpcodeParser` that bounds clipboard payloads.
+ * @brief The guard's state for one channel: where its stream stands between
+ * datagrams.
+ *
+ * Kept for every possible channel id, so it holds only the framer's FSM and
+ * the guard's per-instruction fields. What is needed just while an instruction
+ * or element is split across datagrams — the element's first bytes and a copy
+ * of the instruction's rule — is borrowed from the parser's pools for only that
+ * long.
+ */
+struct GuardChannelState {
+    FrameState frame;
+
+    // The rule of the instruction in flight: in the current policy while a
+    // Parse() runs, a copy in the parser's rule pool (`rule_spilled`) once the
+    // instruction continues in a later datagram.
+    const OpcodeRule *rule = nullptr;
+    uint32_t clipboard_cap = clipboard::MAX_BYTES;
+
+    int32_t clipboard_sidx = -1; // index of the open clipboard stream, or -1
+    uint32_t current_arg = 0;    // 1-based position of the current argument
+    clipboard::StreamOpcode current_opcode = clipboard::StreamOpcode::OTHER;
+    bool cap_next_arg = false;   // the next argument is a clipboard payload
+    bool rule_spilled = false;
+};
+
+static_assert(sizeof(GuardChannelState) <= 64,
+              "per-channel guard state is kept for all 65536 channels");
+
+/*
+ * @brief Guard parser on `OpcodeParserCore` that enforces the guard
+ * policy and bounds clipboard payloads.
+ *
+ * Which opcodes may cross, how many arguments each may carry and what shape
+ * they must have come from a GuardPolicy (see guard_policy.h), read through a
+ * GuardPolicyStore so it can be swapped while channels are live. The rule for
+ * an instruction is copied when its opcode is seen, so one instruction is
+ * judged by one policy even if a reload lands halfway through it.
  *
  * Guacamole clipboard data arrives as a `clipboard,<stream>,<mime>` open, then
  * one or more `blob,<stream>,<data>` instructions, then `end,<stream>`. This
  * parser remembers the stream index opened by `clipboard`; when a `blob` carries
- * that same index, its payload argument is limited to MAX_CLIPBOARD_BYTES. An
- * oversized payload is denied — the base parser then excises the whole blob and
- * keeps forwarding the rest of the stream, rather than corrupting the channel.
- * Tracking stops on the stream's `end`. A blob that is not on the open clipboard
- * stream (e.g. a file upload) is denied outright, so only clipboard payload
- * crosses toward guacd.
+ * that same index, its payload argument is limited to the policy's clipboard
+ * cap. An oversized payload is denied — the core parser then excises the whole
+ * blob and keeps forwarding the rest of the stream, rather than corrupting the
+ * channel. Tracking stops on the stream's `end`. A blob that is not on the open
+ * clipboard stream (e.g. a file upload) is denied outright, so only clipboard
+ * payload crosses toward guacd.
+ *
+ * One parser frames every channel of the receive loop in turn: Parse() takes
+ * the channel's GuardChannelState, and the staging buffers and rule copies of
+ * channels that are mid-instruction come from pools shared by all of them. The
+ * overloads without a channel use the parser's own.
  */
-class GuardOpcodeParser : public OpcodeParser {
+class GuardOpcodeParser : public OpcodeParserCore<GuardOpcodeParser> {
   public:
-    // The shared inbound clipboard cap (base64 chars). gmlbroker fakes the ack
-    // for blobs over this size, so both must agree — see util/clipboard.h.
+    // The shared inbound clipboard cap (base64 chars) and the built-in
+    // policy's. gmlbroker fakes the ack for blobs over this size, so both must
+    // agree — see util/clipboard.h.
     static constexpr uint32_t MAX_CLIPBOARD_BYTES = clipboard::MAX_BYTES;
 
-  protected:
-    bool OnInstructionBegin(const GuacElement &instr) override;
-    bool OnArgument(const GuacElement &arg) override;
+    // A parser under the built-in policy.
+    GuardOpcodeParser() : GuardOpcodeParser(GuardPolicyStore::Builtin()) {}
+    explicit GuardOpcodeParser(const GuardPolicyStore &policy)
+        : policy(&policy) {}
+    ~GuardOpcodeParser() { Release(own); }
+
+    GuardOpcodeParser(const GuardOpcodeParser &) = delete;
+    GuardOpcodeParser &operator=(const GuardOpcodeParser &) = delete;
+
+    /*
+     * @brief Parses a channel's next datagram (see OpcodeParserCore::Parse)
+     *
+     * A DENIED_DATA result is excised with Excise() before the next Parse().
+     */
+    ParserState Parse(GuardChannelState &channel, const char *data,
+                      size_t len);
+    ParserState Parse(const char *data, size_t len) {
+        return Parse(own, data, len);
+    }
+
+    /*
+     * @brief Returns a channel to a fresh stream, handing back whatever it had
+     * borrowed from the pools. Call before its state is reused or dropped.
+     */
+    void Release(GuardChannelState &channel);
+
+    // Staging buffers lent out to channels split mid-element.
+    size_t StagingInUse() const { return staging_pool.InUse(); }
+
+    // Staging buffers allocated, lent out or kept for reuse.
+    size_t StagingHeld() const { return staging_pool.Held(); }
+
+    // Staging buffers and rule copies each pool keeps for reuse; any beyond
+    // that are freed as they come back.
+    static constexpr size_t POOL_KEEP = 256;
 
   private:
-    // The guard's opcode allowlist: only these cross toward guacd.
-    static bool IsAllowedOpcode(const GuacElement &opcode);
+    friend class OpcodeParserCore<GuardOpcodeParser>;
+
+    struct StagingSlot {
+        char bytes[MAX_ELEMENT_BYTES];
+    };
+
+    FrameState &Frame() { return channel->frame; }
+    char *AcquireStaging() { return staging_pool.Acquire()->bytes; }
+    void ReleaseStaging(char *staging) {
+        // `bytes` is the slot's first member, so the two share an address.
+        staging_pool.Release(reinterpret_cast<StagingSlot *>(staging));
+    }
 
-    std::string current_opcode;
-    int clipboard_sidx = -1;   // index of the open clipboard stream, or -1 if none
-    size_t current_arg = 0;    // 1-based position of the argument being parsed
-    bool cap_next_arg = false; // the next argument is a clipboard blob payload
+    bool OnInstructionBegin(const GuacElement &instr);
+    bool OnArgument(const GuacElement &arg);
+    bool OnInstructionEnd();
+
+    // The policy's character set (GUARD_CHARSET unless the policy sets one).
+    Charset ElementCharset() const;
+
+    // Hands a spilled rule copy back to the pool.
+    void DropRule(GuardChannelState &state);
+
+    const GuardPolicyStore *policy;
+
+    // The channel being parsed; `own` outside a channel Parse().
+    GuardChannelState own;
+    GuardChannelState *channel = &own;
+
+    SlotPool<StagingSlot> staging_pool{POOL_KEEP};
+    SlotPool<OpcodeRule> rule_pool{POOL_KEEP};
 };
+
+// Instantiated in guard_opcode_parser.cpp, next to the hooks it inlines.
+extern template class OpcodeParserCore<GuardOpcodeParser>;
@@ -0,0 +1,210 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/parser/opcode_parser_core.h"
+#include "../../shared/include/util/epoch.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * @brief The shape an argument must have to cross the guard
+ */
+enum class ArgShape : uint8_t {
+    ANY, // any content, bounded only by its length limit
+    INT  // an optional '-' followed by one or more decimal digits
+};
+
+/*
+ * @brief Limits on one positional argument of an allowed opcode
+ */
+struct ArgRule {
+    ArgShape shape = ArgShape::ANY;
+    uint32_t max_len = UINT32_MAX; // bytes
+};
+
+/*
+ * @brief What the policy allows for one opcode.
+ *
+ * Fixed size, so the parser can keep a copy of the rule for the instruction in
+ * flight instead of a pointer into a policy that may be swapped underneath it.
+ */
+struct OpcodeRule {
+    static constexpr size_t MAX_NAME = 31;
+    static constexpr size_t MAX_SHAPED_ARGS = 8;
+    static constexpr uint16_t UNBOUNDED = UINT16_MAX;
+
+    char name[MAX_NAME + 1] = {};
+    uint8_t name_len = 0;
+    uint16_t min_args = 0;
+    uint16_t max_args = UNBOUNDED;
+    // Arguments 1..shaped_args follow args[]; any later ones are ANY.
+    uint8_t shaped_args = 0;
+    ArgRule args[MAX_SHAPED_ARGS];
+};
+
+/*
+ * @brief A compiled, immutable guard policy.
+ *
+ * Compiled once from policy text (see Compile() for the format) into a
+ * perfect-hash table over the allowed opcodes: a seed is searched at compile
+ * time so that every opcode lands in its own slot, and a lookup is one hash of
+ * at most MAX_NAME bytes, one slot and one compare — constant time, with no
+ * allocation. Never modified after compiling; a new policy replaces it whole
+ * through GuardPolicyStore.
+ */
+class GuardPolicy {
+  public:
+    // Upper bound on allowed opcodes, which keeps the slot table small.
+    static constexpr size_t MAX_OPCODES = 256;
+
+    /*
+     * @brief Compiles policy text.
+     *
+     * One directive per line; '#' starts a comment.
+     *
+     *   allow <opcode> [<args>] [<shape>...]
+     *       Allows the opcode. <args> bounds its argument count: N, N-M, N-*
+     *       or * (the default). Each <shape> constrains the next positional
+     *       argument: `int`, `any`, or either with a byte limit (`any:64`).
+     *   clipboard-cap <bytes>
+     *       Largest clipboard blob payload (base64) allowed toward guacd.
+     *   charset utf8|ascii
+     *       Characters element values may contain (default: GUARD_CHARSET).
+     *
+     * @param text: the policy source
+     * @param error: set to "line N: reason" when the text does not compile
+     * @return the compiled policy, or nullptr on error
+     */
+    static std::unique_ptr<GuardPolicy> Compile(const std::string &text,
+                                                std::string &error);
+
+    /*
+     * @brief Reads and compiles a policy file
+     * @return the compiled policy, or nullptr with `error` set
+     */
+    static std::unique_ptr<GuardPolicy> Load(const std::string &path,
+                                             std::string &error);
+
+    /*
+     * @brief The built-in policy: the guard's historic allowlist, no argument
+     * limits, the shared clipboard cap. Used when no policy file is given.
+     */
+    static std::unique_ptr<GuardPolicy> Builtin();
+
+    /*
+     * @brief Looks up an opcode
+     * @return its rule, or nullptr if the opcode is not allowed
+     */
+    const OpcodeRule *Find(const GuacElement &opcode) const {
+        if (opcode.len > OpcodeRule::MAX_NAME)
+            return nullptr;
+        uint16_t slot = slots[Hash(opcode.ptr, opcode.len, seed) & mask];
+        if (slot == 0)
+            return nullptr;
+        const OpcodeRule &rule = rules[slot - 1];
+        if (rule.name_len != opcode.len ||
+            std::memcmp(rule.name, opcode.ptr, opcode.len) != 0)
+            return nullptr;
+        return &rule;
+    }
+
+    uint32_t ClipboardCap() const { return clipboard_cap; }
+    Charset ElementCharset() const { return charset; }
+    size_t OpcodeCount() const { return rules.size(); }
+
+  private:
+    GuardPolicy() = default;
+
+    // Seeded FNV-1a with a final avalanche; the seed is what the compiler
+    // searches for.
+    static uint32_t Hash(const char *p, size_t n, uint32_t seed) {
+        uint32_t h = 2166136261u ^ seed;
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    // Finds a seed and table size that place every rule in its own slot.
+    bool BuildTable();
+
+    std::vector<OpcodeRule> rules;
+    std::vector<uint16_t> slots; // rule index + 1; 0 is an empty slot
+    uint32_t seed = 0;
+    uint32_t mask = 0;
+    uint32_t clipboard_cap = 0;
+    Charset charset = Charset::UTF8;
+};
+
+/*
+ * @brief Publishes the current GuardPolicy to the receive loop and swaps it
+ * RCU style.
+ *
+ * The receive loop registers with Epoch() and holds an EpochDomain::Guard
+ * across each Parse(); policy reads inside it see one consistent policy. A
+ * reload compiles the new policy off the receive loop, then Swap() publishes
+ * it, waits until no Parse() can still be using the old one, and frees it. The
+ * receive loop never blocks or allocates for a reload.
+ */
+class GuardPolicyStore {
+  public:
+    explicit GuardPolicyStore(std::unique_ptr<GuardPolicy> initial)
+        : current(initial.release()) {}
+    ~GuardPolicyStore() { delete current.load(); }
+
+    GuardPolicyStore(const GuardPolicyStore &) = delete;
+    GuardPolicyStore &operator=(const GuardPolicyStore &) = delete;
+
+    /*
+     * @brief A store holding the built-in policy that is never swapped
+     */
+    static const GuardPolicyStore &Builtin();
+
+    /*
+     * @brief The current policy. Only valid inside an EpochDomain::Guard of
+     * Epoch(), or where no Swap() can run concurrently.
+     */
+    const GuardPolicy &Current() const { return *current.load(); }
+
+    EpochDomain &Epoch() { return epoch; }
+
+    /*
+     * @brief Publishes `next` and frees the policy it replaces once no reader
+     * can still hold it. Called from a single reloading thread.
+     */
+    void Swap(std::unique_ptr<GuardPolicy> next) {
+        const GuardPolicy *old = current.exchange(next.release());
+        epoch.Synchronize();
+        delete old;
+    }
+
+  private:
+    std::atomic<const GuardPolicy *> current;
+    EpochDomain epoch;
+};
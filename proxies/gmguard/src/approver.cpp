@@ -19,7 +19,86 @@
  */
 
 #include "../include/approver.h"
+#include <cstdio>
 #include <iostream>
+#include <iterator>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+Approver::Approver() {
+    // EFD_NONBLOCK so TakeVerdicts()' drain read() never blocks and a saturated
+    // counter write() fails with EAGAIN rather than stalling the worker.
+    event_fd = ::eventfd(0, EFD_NONBLOCK);
+    if (event_fd < 0)
+        perror("eventfd");
+    worker = std::thread(&Approver::Run, this);
+}
+
+Approver::~Approver() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    if (event_fd >= 0)
+        ::close(event_fd);
+}
+
+void Approver::Submit(uint16_t channel, const std::string &request_id) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        requests.push_back({channel, request_id});
+    }
+    cv.notify_one();
+}
+
+void Approver::SetWakeHook(std::function<void()> hook) {
+    std::lock_guard<std::mutex> lock(mtx);
+    wake_hook = std::move(hook);
+}
+
+void Approver::TakeVerdicts(std::vector<ApprovalVerdict> &out) {
+    // Clear the wake state first, then take the queue under lock. A verdict
+    // that races in between re-signals the eventfd, so the next poll wakes the
+    // caller again (at worst a spurious empty take) — none is ever lost.
+    uint64_t cnt;
+    while (event_fd >= 0 && ::read(event_fd, &cnt, sizeof(cnt)) > 0) {
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    out.insert(out.end(), std::make_move_iterator(verdicts.begin()),
+               std::make_move_iterator(verdicts.end()));
+    verdicts.clear();
+}
+
+void Approver::Run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [this] { return stopping || !requests.empty(); });
+        if (stopping)
+            return;
+        Request request = std::move(requests.front());
+        requests.pop_front();
+
+        // Decide without the lock, so Submit() and TakeVerdicts() never wait
+        // on a decision.
+        lock.unlock();
+        ApprovalResult result = HandleRequest(request.request_id);
+        lock.lock();
+
+        verdicts.push_back({request.channel, std::move(request.request_id),
+                            std::move(result)});
+        if (event_fd >= 0) {
+            uint64_t one = 1;
+            // A full counter (EAGAIN) means a wake is already pending.
+            ssize_t n = ::write(event_fd, &one, sizeof(one));
+            (void)n;
+        }
+        if (wake_hook)
+            wake_hook();
+    }
+}
 
 ApprovalResult Approver::HandleRequest(const std::string &request_id) {
     // PoC operator stand-in: honour the runtime global approve/deny switch.
@@ -35,88 +35,128 @@ int parse_stream_index(const GuacElement &arg) {
     return idx;
 }
 
+// Whether an argument has the shape its rule asks for.
+bool matches_shape(const GuacElement &arg, const ArgRule &rule) {
+    if (arg.len > rule.max_len)
+        return false;
+    if (rule.shape == ArgShape::INT) {
+        size_t i = (arg.len > 0 && arg.ptr[0] == '-') ? 1 : 0;
+        if (i == arg.len)
+            return false; // empty, or a lone '-'
+        for (; i < arg.len; ++i)
+            if (arg.ptr[i] < '0' || arg.ptr[i] > '9')
+                return false;
+    }
+    return true;
+}
+
 } // namespace
 
-bool GuardOpcodeParser::IsAllowedOpcode(const GuacElement &opcode) {
-    /*
-     * Only connection-setup, input and stream-control opcodes may cross toward
-     * guacd. `sync` is deliberately NOT allowed: it is blocked on the inbound
-     * path and the brokers fake the keepalive instead.
-     *
-     * 3.key   3.ack   3.end
-     * 4.size  4.name  4.argv  4.blob
-     * 5.audio 5.video 5.image 5.mouse
-     * 6.select 7.connect 8.timezone 9.clipboard 10.disconnect
-     *
-     * `sync` and `nop` are NOT allowed: they are keepalives that gmlbroker
-     * swallows on the forward path (ForwardKeepaliveFilter) and the brokers fake.
-     */
-    switch (opcode.len) {
-    case 3:
-        return !memcmp(opcode.ptr, "key", 3) || !memcmp(opcode.ptr, "ack", 3) ||
-               !memcmp(opcode.ptr, "end", 3);
-    case 4:
-        return !memcmp(opcode.ptr, "blob", 4) ||
-               !memcmp(opcode.ptr, "size", 4) ||
-               !memcmp(opcode.ptr, "name", 4) ||
-               !memcmp(opcode.ptr, "argv", 4);
-    case 5:
-        return !memcmp(opcode.ptr, "audio", 5) ||
-               !memcmp(opcode.ptr, "video", 5) ||
-               !memcmp(opcode.ptr, "image", 5) ||
-               !memcmp(opcode.ptr, "mouse", 5);
-    case 6:
-        return !memcmp(opcode.ptr, "select", 6);
-    case 7:
-        return !memcmp(opcode.ptr, "connect", 7);
-    case 8:
-        return !memcmp(opcode.ptr, "timezone", 8);
-    case 9:
-        return !memcmp(opcode.ptr, "clipboard", 9);
-    case 10:
-        return !memcmp(opcode.ptr, "disconnect", 10);
-    default:
-        return false;
+Charset GuardOpcodeParser::ElementCharset() const {
+    return policy->Current().ElementCharset();
+}
+
+ParserState GuardOpcodeParser::Parse(GuardChannelState &state,
+                                     const char *data, size_t len) {
+    channel = &state;
+    ParserState result = OpcodeParserCore::Parse(data, len);
+
+    // An instruction that continues in the next datagram keeps the rule it
+    // started with, but the policy it points into may be swapped and freed
+    // before then: take a copy.
+    if (result != ParserState::STREAM_CORRUPTED &&
+        !state.frame.reading_opcode && state.rule && !state.rule_spilled) {
+        OpcodeRule *copy = rule_pool.Acquire();
+        *copy = *state.rule;
+        state.rule = copy;
+        state.rule_spilled = true;
+    }
+
+    channel = &own;
+    return result;
+}
+
+void GuardOpcodeParser::Release(GuardChannelState &state) {
+    channel = &state;
+    Reset();
+    channel = &own;
+    DropRule(state);
+    state = GuardChannelState();
+}
+
+void GuardOpcodeParser::DropRule(GuardChannelState &state) {
+    if (state.rule_spilled) {
+        rule_pool.Release(const_cast<OpcodeRule *>(state.rule));
+        state.rule_spilled = false;
     }
+    state.rule = nullptr;
 }
 
 bool GuardOpcodeParser::OnInstructionBegin(const GuacElement &instr) {
-    current_opcode.assign(instr.ptr, instr.len);
+    GuardChannelState &state = *channel;
+    state.current_opcode = clipboard::stream_opcode(instr.View());
 
     // Reset per-instruction state here rather than in OnInstructionEnd: the base
     // does not call OnInstructionEnd for a denied instruction, but every
     // instruction passes through OnInstructionBegin exactly once.
-    current_arg = 0;
-    cap_next_arg = false;
+    state.current_arg = 0;
+    state.cap_next_arg = false;
+    DropRule(state);
 
-    return IsAllowedOpcode(instr);
+    // Only opcodes the policy lists cross toward guacd. The rule stays valid
+    // for the rest of this Parse(); Parse() copies it if the instruction goes
+    // on past it.
+    const GuardPolicy &current = policy->Current();
+    const OpcodeRule *found = current.Find(instr);
+    if (!found)
+        return false;
+    state.rule = found;
+    state.clipboard_cap = current.ClipboardCap();
+    return true;
 }
 
 bool GuardOpcodeParser::OnArgument(const GuacElement &arg) {
-    ++current_arg;
+    GuardChannelState &state = *channel;
+    const OpcodeRule &rule = *state.rule;
+    ++state.current_arg;
+
+    // Argument count and shape, as the policy's rule for this opcode has them.
+    if (state.current_arg > rule.max_args)
+        return false;
+    if (state.current_arg <= rule.shaped_args &&
+        !matches_shape(arg, rule.args[state.current_arg - 1]))
+        return false;
 
     // The payload argument of a clipboard blob: deny it (the base then excises
     // the whole blob) when it exceeds the cap.
-    if (cap_next_arg) {
-        cap_next_arg = false;
-        return arg.len <= MAX_CLIPBOARD_BYTES;
+    if (state.cap_next_arg) {
+        state.cap_next_arg = false;
+        return arg.len <= state.clipboard_cap;
     }
 
     // The first argument of clipboard/blob/end is the stream index.
-    if (current_arg == 1) {
+    if (state.current_arg == 1) {
         int sidx = parse_stream_index(arg);
-        if (current_opcode == "clipboard") {
-            clipboard_sidx = sidx; // start tracking this stream
-        } else if (current_opcode == "blob") {
+        if (state.current_opcode == clipboard::StreamOpcode::CLIPBOARD) {
+            state.clipboard_sidx = sidx; // start tracking this stream
+        } else if (state.current_opcode == clipboard::StreamOpcode::BLOB) {
             // Only the open clipboard stream may carry blob payload toward guacd;
             // deny any other blob (e.g. a file upload) so it is excised.
-            if (sidx < 0 || sidx != clipboard_sidx)
+            if (sidx < 0 || sidx != state.clipboard_sidx)
                 return false;
-            cap_next_arg = true; // the next argument is the clipboard payload
-        } else if (current_opcode == "end" && sidx == clipboard_sidx) {
-            clipboard_sidx = -1; // stream closed, stop tracking
+            state.cap_next_arg = true; // the next argument is the payload
+        } else if (state.current_opcode == clipboard::StreamOpcode::END &&
+                   sidx == state.clipboard_sidx) {
+            state.clipboard_sidx = -1; // stream closed, stop tracking
         }
     }
 
     return true;
 }
+
+bool GuardOpcodeParser::OnInstructionEnd() {
+    // Too few arguments for the policy: deny the instruction.
+    return channel->current_arg >= channel->rule->min_args;
+}
+
+template class OpcodeParserCore<GuardOpcodeParser>;
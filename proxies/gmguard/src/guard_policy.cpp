@@ -0,0 +1,254 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guard_policy.h"
+#include "../../shared/include/util/clipboard.h"
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace {
+
+/*
+ * The guard's historic allowlist. Only connection-setup, input and
+ * stream-control opcodes may cross toward guacd. `sync` and `nop` are NOT
+ * allowed: they are keepalives that gmlbroker swallows on the forward path
+ * (ForwardKeepaliveFilter) and the brokers fake.
+ */
+const char *const BUILTIN_POLICY = R"(
+allow key
+allow ack
+allow end
+allow size
+allow name
+allow argv
+allow blob
+allow audio
+allow video
+allow image
+allow mouse
+allow select
+allow connect
+allow timezone
+allow clipboard
+allow disconnect
+)";
+
+// Characters element values may contain when the policy does not say. utf8
+// (the default) admits any well-formed UTF-8 and frames it by code point; ascii
+// rejects every byte above 127, for deployments that want the narrowest
+// possible inbound surface. Tunable via GUARD_CHARSET.
+Charset guard_charset() {
+    const char *env = std::getenv("GUARD_CHARSET");
+    if (env && !std::strcmp(env, "ascii"))
+        return Charset::ASCII;
+    return Charset::UTF8;
+}
+
+// Parses a whole token as an unsigned number no larger than `max`.
+bool parse_uint(const std::string &token, uint32_t max, uint32_t &out) {
+    uint32_t v = 0;
+    auto [ptr, ec] =
+        std::from_chars(token.data(), token.data() + token.size(), v);
+    if (ec != std::errc() || ptr != token.data() + token.size() || v > max)
+        return false;
+    out = v;
+    return true;
+}
+
+// <args>: N, N-M, N-* or *.
+bool parse_arg_count(const std::string &token, OpcodeRule &rule) {
+    if (token == "*")
+        return true;
+    size_t dash = token.find('-');
+    uint32_t lo, hi;
+    if (!parse_uint(token.substr(0, dash), OpcodeRule::UNBOUNDED - 1, lo))
+        return false;
+    if (dash == std::string::npos) {
+        hi = lo;
+    } else if (token.substr(dash + 1) == "*") {
+        hi = OpcodeRule::UNBOUNDED;
+    } else if (!parse_uint(token.substr(dash + 1), OpcodeRule::UNBOUNDED - 1,
+                           hi) ||
+               hi < lo) {
+        return false;
+    }
+    rule.min_args = static_cast<uint16_t>(lo);
+    rule.max_args = static_cast<uint16_t>(hi);
+    return true;
+}
+
+// <shape>: int, any, int:N or any:N.
+bool parse_shape(const std::string &token, ArgRule &arg) {
+    size_t colon = token.find(':');
+    std::string kind = token.substr(0, colon);
+    if (kind == "int")
+        arg.shape = ArgShape::INT;
+    else if (kind == "any")
+        arg.shape = ArgShape::ANY;
+    else
+        return false;
+    if (colon != std::string::npos &&
+        !parse_uint(token.substr(colon + 1), UINT32_MAX, arg.max_len))
+        return false;
+    return true;
+}
+
+// The optional <args> token comes first and, unlike a shape, starts with a
+// digit or '*'.
+bool is_arg_count(const std::string &token) {
+    return token[0] == '*' || (token[0] >= '0' && token[0] <= '9');
+}
+
+} // namespace
+
+std::unique_ptr<GuardPolicy> GuardPolicy::Compile(const std::string &text,
+                                                  std::string &error) {
+    std::unique_ptr<GuardPolicy> policy(new GuardPolicy());
+    policy->clipboard_cap = clipboard::MAX_BYTES;
+    policy->charset = guard_charset();
+
+    std::istringstream lines(text);
+    std::string line;
+    for (int lineno = 1; std::getline(lines, line); ++lineno) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive))
+            continue; // blank or comment
+
+        auto fail = [&](const std::string &reason) {
+            error = "line " + std::to_string(lineno) + ": " + reason;
+            return nullptr;
+        };
+
+        std::string token;
+        if (directive == "allow") {
+            OpcodeRule rule;
+            if (!(words >> token))
+                return fail("allow needs an opcode");
+            if (token.size() > OpcodeRule::MAX_NAME)
+                return fail("opcode '" + token + "' is longer than " +
+                            std::to_string(OpcodeRule::MAX_NAME) + " bytes");
+            std::memcpy(rule.name, token.data(), token.size());
+            rule.name_len = static_cast<uint8_t>(token.size());
+            for (const OpcodeRule &seen : policy->rules)
+                if (seen.name_len == rule.name_len &&
+                    !std::memcmp(seen.name, rule.name, rule.name_len))
+                    return fail("opcode '" + token + "' allowed twice");
+            if (policy->rules.size() == MAX_OPCODES)
+                return fail("more than " + std::to_string(MAX_OPCODES) +
+                            " opcodes");
+
+            bool first = true;
+            while (words >> token) {
+                if (first && is_arg_count(token)) {
+                    if (!parse_arg_count(token, rule))
+                        return fail("bad argument count '" + token + "'");
+                } else {
+                    if (rule.shaped_args == OpcodeRule::MAX_SHAPED_ARGS)
+                        return fail("more than " +
+                                    std::to_string(OpcodeRule::MAX_SHAPED_ARGS) +
+                                    " argument shapes");
+                    if (!parse_shape(token, rule.args[rule.shaped_args]))
+                        return fail("bad argument shape '" + token + "'");
+                    ++rule.shaped_args;
+                }
+                first = false;
+            }
+            policy->rules.push_back(rule);
+        } else if (directive == "clipboard-cap") {
+            std::string extra;
+            if (!(words >> token) ||
+                !parse_uint(token, UINT32_MAX, policy->clipboard_cap) ||
+                (words >> extra))
+                return fail("clipboard-cap needs one byte count");
+        } else if (directive == "charset") {
+            std::string extra;
+            if (!(words >> token) || (token != "utf8" && token != "ascii") ||
+                (words >> extra))
+                return fail("charset must be utf8 or ascii");
+            policy->charset =
+                token == "ascii" ? Charset::ASCII : Charset::UTF8;
+        } else {
+            return fail("unknown directive '" + directive + "'");
+        }
+    }
+
+    if (!policy->BuildTable()) {
+        error = "no perfect hash found for the opcode set";
+        return nullptr;
+    }
+    return policy;
+}
+
+std::unique_ptr<GuardPolicy> GuardPolicy::Load(const std::string &path,
+                                               std::string &error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    std::unique_ptr<GuardPolicy> policy = Compile(text.str(), error);
+    if (!policy)
+        error = path + ": " + error;
+    return policy;
+}
+
+std::unique_ptr<GuardPolicy> GuardPolicy::Builtin() {
+    std::string error;
+    return Compile(BUILTIN_POLICY, error);
+}
+
+bool GuardPolicy::BuildTable() {
+    // Start at a load factor of at most 1/2 and grow the table if no seed in
+    // the budget separates every opcode. Compile-time cost only.
+    constexpr uint32_t SEEDS_PER_SIZE = 4096;
+    size_t size = 8;
+    while (size < 2 * rules.size())
+        size *= 2;
+    for (; size <= 16 * MAX_OPCODES; size *= 2) {
+        mask = static_cast<uint32_t>(size - 1);
+        for (seed = 0; seed < SEEDS_PER_SIZE; ++seed) {
+            slots.assign(size, 0);
+            bool collision = false;
+            for (size_t r = 0; r < rules.size() && !collision; ++r) {
+                uint16_t &slot =
+                    slots[Hash(rules[r].name, rules[r].name_len, seed) & mask];
+                if (slot != 0)
+                    collision = true;
+                else
+                    slot = static_cast<uint16_t>(r + 1);
+            }
+            if (!collision)
+                return true;
+        }
+    }
+    return false;
+}
+
+const GuardPolicyStore &GuardPolicyStore::Builtin() {
+    static const GuardPolicyStore store(GuardPolicy::Builtin());
+    return store;
+}
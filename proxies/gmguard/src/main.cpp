@@ -18,35 +18,71 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include "../../shared/include/network/bridge_transport.h"
 #include "../../shared/include/network/multiplexer.h"
 #include "../../shared/include/network/udpreceiver.h"
-#include "../../shared/include/network/udpsender.h"
 #include "../../shared/include/parser/opcode_parser.h"
 #include "../include/guard_opcode_parser.h"
+#include "../include/guard_policy.h"
+#include "../../shared/include/util/clipboard.h"
 #include "../../shared/include/util/control_channel.h"
 #include "../../shared/include/util/netargs.h"
+#include "../../shared/include/util/running.h"
 #include "../include/approver.h"
 #include <atomic>
+#include <chrono>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <poll.h>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
-// Cleared by the SIGINT handler; the receive loop polls it to stop. The guard's
-// UDPReceiver has a recv timeout, so the loop wakes to observe this even when no
-// traffic is arriving.
-std::atomic<bool> running = true;
-
+namespace {
 /*
- * @brief Clears the run flag on SIGINT.
+ * @brief Clears the run flag on SIGINT; the receive loop polls it to stop.
+ * The loop's poll() has a timeout, so it wakes to observe this even when no
+ * traffic is arriving.
  *
  * Deliberately does no I/O: it must stay async-signal-safe. (Logging on
  * shutdown is left to the future logging facility.)
  */
 void interrupt_handler(int) { running = false; }
+} // namespace
+
+// Set by the SIGHUP handler; the policy thread polls it to reload the policy
+// file without dropping any channel.
+std::atomic<bool> reload_policy = false;
+
+void reload_handler(int) { reload_policy = true; }
+
+// Path of the guard policy file (see guard_policy.h for the format). Unset
+// means the built-in policy, which SIGHUP then has nothing to reload from.
+const char *guard_policy_path() {
+    const char *env = std::getenv("GUARD_POLICY");
+    return env && *env ? env : nullptr;
+}
+
+/*
+ * @brief Logs what a freshly loaded policy allows
+ */
+void log_policy(const char *source, const GuardPolicy &policy) {
+    std::cout << "guard: policy from " << source << ": "
+              << policy.OpcodeCount() << " opcodes, clipboard cap "
+              << policy.ClipboardCap() << " bytes, charset "
+              << (policy.ElementCharset() == Charset::ASCII ? "ascii" : "utf8")
+              << std::endl;
+    // gmlbroker fakes the ack for blobs over its compiled cap; a different cap
+    // here means some blobs get two acks or none.
+    if (policy.ClipboardCap() != clipboard::MAX_BYTES)
+        std::cerr << "guard: warning: clipboard cap differs from gmlbroker's ("
+                  << clipboard::MAX_BYTES << " bytes)" << std::endl;
+}
 
 // A request id is gmlbroker's inert connection identifier: exactly
 // REQUEST_ID_LEN lowercase hex characters (see make_request_id in gmlbroker).
@@ -92,7 +128,7 @@ const char *state_name(ParserState state) {
  *
  * Channel lifecycle messages (CREATE/SHUTDOWN) are passed through untouched; the
  * guard only inspects NONE payloads. Because channels are multiplexed over a
- * single UDP stream, each channel keeps its own Finite State Machine parser.
+ * single UDP stream, each channel keeps its own Finite State Machine state.
  * Disallowed opcodes and traffic that is not valid Guacamole are blocked, and a
  * channel that violates policy is poisoned until it is torn down.
  */
@@ -128,24 +164,60 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &sa, nullptr);
     sigaction(SIGTERM, &sa, nullptr);
 
+    struct sigaction hup{};
+    hup.sa_handler = reload_handler;
+    sigemptyset(&hup.sa_mask);
+    hup.sa_flags = 0;
+    sigaction(SIGHUP, &hup, nullptr);
+
+    // The guard policy. A policy file that does not compile at startup is
+    // fatal: the guard never runs on a policy other than the one asked for.
+    const char *policy_path = guard_policy_path();
+    std::unique_ptr<GuardPolicy> initial_policy;
+    if (policy_path) {
+        std::string error;
+        initial_policy = GuardPolicy::Load(policy_path, error);
+        if (!initial_policy) {
+            std::cerr << "guard: cannot load policy: " << error << std::endl;
+            return 1;
+        }
+    } else {
+        initial_policy = GuardPolicy::Builtin();
+    }
+    log_policy(policy_path ? policy_path : "built-in", *initial_policy);
+    GuardPolicyStore policy(std::move(initial_policy));
+    int policy_reader = policy.Epoch().Register();
+
     int rc;
-    UDPReceiver receiver = UDPReceiver(src_port.value());
-    if ((rc = receiver.Initialize()) != 0)
+    // The bridge hops: UDP, or shared-memory rings when both neighbours run
+    // on this host (BRIDGE_TRANSPORT=shm).
+    std::unique_ptr<BridgeReceiver> receiver =
+        MakeBridgeReceiver(src_port.value());
+    if ((rc = receiver->Initialize()) != 0)
         return rc;
 
-    std::cout << "Listening on UDP port " << src_port.value() << std::endl;
+    std::cout << "Listening on bridge port " << src_port.value() << std::endl;
 
-    UDPSender sender = UDPSender(dst_ip, dst_port.value());
-    if ((rc = sender.Initialize()) != 0)
+    std::unique_ptr<BridgeSender> sender =
+        MakeBridgeSender(dst_ip, dst_port.value());
+    if ((rc = sender->Initialize()) != 0)
         return rc;
 
-    // One parser per channel; channels that violate policy are poisoned
-    std::unordered_map<uint16_t, GuardOpcodeParser> parsers;
+    // One parser frames every channel, resuming each from its own state in a
+    // dense array indexed by channel id (ids are 16 bits). Channels that
+    // violate policy are poisoned.
+    GuardOpcodeParser guard(policy);
+    std::unique_ptr<GuardChannelState[]> channels(
+        new GuardChannelState[1 << 16]);
     std::unordered_set<uint16_t> poisoned;
 
     // The guard is the approval gate: the operator decides on each inert CREATE
-    // request here. `approved` holds the channels cleared to carry Guacamole.
+    // request here. The decision is made on the approver's worker; `pending`
+    // maps each channel awaiting one to its request id, so a verdict that
+    // arrives after its channel was shut down or re-created is recognised as
+    // stale. `approved` holds the channels cleared to carry Guacamole.
     Approver approver;
+    std::unordered_map<uint16_t, std::string> pending;
     std::unordered_set<uint16_t> approved;
 
     // Set by the control listener on a global "deny"; the main loop observes it
@@ -186,7 +258,46 @@ int main(int argc, char *argv[]) {
         }
     });
 
+    // Policy reloads on SIGHUP. Compiling happens here, off the receive loop,
+    // which only ever sees the swap of a finished policy. A policy that does
+    // not compile is logged and the current one stays in force.
+    std::thread policy_thread([&policy, policy_path]() {
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            if (!reload_policy.exchange(false))
+                continue;
+            if (!policy_path) {
+                std::cerr << "guard: SIGHUP ignored, no GUARD_POLICY file"
+                          << std::endl;
+                continue;
+            }
+            std::string error;
+            std::unique_ptr<GuardPolicy> next =
+                GuardPolicy::Load(policy_path, error);
+            if (!next) {
+                std::cerr << "guard: policy reload failed, keeping the current "
+                             "policy: "
+                          << error << std::endl;
+                continue;
+            }
+            log_policy(policy_path, *next);
+            policy.Swap(std::move(next));
+        }
+    });
+
     char buffer[Multiplexer::MAX_DATAGRAM_SIZE + 1];
+    std::vector<ApprovalVerdict> verdicts;
+
+    // The bridge socket and the approver's verdicts are waited on together, so
+    // a verdict is acted on as soon as it is ready, whatever the traffic. The
+    // timeout lets the loop observe `running` and a global deny when idle.
+    // A shared-memory ring has no fd: Receive() itself waits, and the approver
+    // interrupts that wait when it queues a verdict.
+    pollfd pfds[2] = {{receiver->Fd(), POLLIN, 0},
+                      {approver.WakeFd(), POLLIN, 0}};
+    const bool receive_waits = pfds[0].fd < 0;
+    if (receive_waits)
+        approver.SetWakeHook([&receiver]() { receiver->Interrupt(); });
 
     while (running) {
         // Act on a global deny: tear down every still-approved channel. This
@@ -195,15 +306,65 @@ int main(int argc, char *argv[]) {
             for (uint16_t ch : approved) {
                 BridgeMessage shutdown{ch, ChannelAction::SHUTDOWN_CHANNEL, ""};
                 std::string wire = Multiplexer::Serialize(shutdown);
-                sender.Send(wire.data(), wire.size());
-                parsers.erase(ch);
+                sender->Send(wire.data(), wire.size());
+                guard.Release(channels[ch]);
                 std::cout << "guard: channel " << (int)ch
                           << " torn down by global deny" << std::endl;
             }
             approved.clear();
         }
 
-        int received = receiver.Receive(buffer, sizeof(buffer));
+        if (!receive_waits && ::poll(pfds, 2, 200) < 0)
+            continue; // EINTR
+
+        // Verdicts: announce each one forward, and clear or tear down its
+        // channel. Without an eventfd they are simply collected every turn;
+        // behind a ring, every turn that has requests outstanding.
+        if ((pfds[1].revents & POLLIN) || pfds[1].fd < 0 ||
+            (receive_waits && !pending.empty())) {
+            approver.TakeVerdicts(verdicts);
+            for (const ApprovalVerdict &verdict : verdicts) {
+                auto it = pending.find(verdict.channel);
+                if (it == pending.end() || it->second != verdict.request_id) {
+                    std::cout << "guard: dropped stale verdict for channel "
+                              << (int)verdict.channel << std::endl;
+                    continue;
+                }
+                pending.erase(it);
+
+                // Emit the verdict forward; gcdbroker flips it onto the return
+                // path back to gmlbroker (the guard is forward-only). Payload
+                // byte 0 is the printable verdict char, the rest is the
+                // request id.
+                char v = verdict.result.approved ? APPROVAL_APPROVE
+                                                 : APPROVAL_DENY;
+                BridgeMessage approval{verdict.channel, ChannelAction::APPROVAL,
+                                       std::string(1, v) + verdict.request_id};
+                std::string wire = Multiplexer::Serialize(approval);
+                sender->Send(wire.data(), wire.size());
+
+                if (verdict.result.approved) {
+                    approved.insert(verdict.channel);
+                    std::cout << "guard: channel " << (int)verdict.channel
+                              << " APPROVED" << std::endl;
+                } else {
+                    // Denied: no Guacamole will ever cross; tear the channel
+                    // down.
+                    BridgeMessage shutdown{verdict.channel,
+                                           ChannelAction::SHUTDOWN_CHANNEL, ""};
+                    std::string sd = Multiplexer::Serialize(shutdown);
+                    sender->Send(sd.data(), sd.size());
+                    guard.Release(channels[verdict.channel]);
+                    std::cout << "guard: channel " << (int)verdict.channel
+                              << " DENIED" << std::endl;
+                }
+            }
+            verdicts.clear();
+        }
+
+        if (!receive_waits && !(pfds[0].revents & POLLIN))
+            continue;
+        int received = receiver->Receive(buffer, sizeof(buffer));
         if (received <= 0)
             continue;
 
@@ -230,49 +391,30 @@ int main(int argc, char *argv[]) {
                 break;
             }
 
-            // Fresh state for a (possibly reused) channel id
-            parsers[msg.channel] = GuardOpcodeParser{};
+            // Fresh state for a (possibly reused) channel id; a verdict still
+            // due on an earlier request for it is now stale.
+            guard.Release(channels[msg.channel]);
             poisoned.erase(msg.channel);
             approved.erase(msg.channel);
+            pending[msg.channel] = request_id;
 
-            ApprovalResult verdict = approver.HandleRequest(request_id);
+            // Decided on the approver's worker; the verdict is acted on when
+            // it comes back, and no traffic waits for it meanwhile.
+            approver.Submit(msg.channel, request_id);
 
             // Forward the CREATE downstream (gcdbroker dials guacd only when it
             // sees the APPROVAL verdict, never on CREATE alone).
-            sender.Send(buffer, received);
-
-            // Emit the verdict forward; gcdbroker flips it onto the return path
-            // back to gmlbroker (the guard is forward-only). Payload byte 0 is
-            // the printable verdict char, the rest is the request id.
-            char v = verdict.approved ? APPROVAL_APPROVE : APPROVAL_DENY;
-            BridgeMessage approval{msg.channel, ChannelAction::APPROVAL,
-                                   std::string(1, v) + request_id};
-            std::string wire = Multiplexer::Serialize(approval);
-            sender.Send(wire.data(), wire.size());
-
-            if (verdict.approved) {
-                approved.insert(msg.channel);
-                std::cout << "guard: channel " << (int)msg.channel
-                          << " APPROVED" << std::endl;
-            } else {
-                // Denied: no Guacamole will ever cross; tear the channel down.
-                BridgeMessage shutdown{msg.channel,
-                                       ChannelAction::SHUTDOWN_CHANNEL, ""};
-                std::string sd = Multiplexer::Serialize(shutdown);
-                sender.Send(sd.data(), sd.size());
-                parsers.erase(msg.channel);
-                std::cout << "guard: channel " << (int)msg.channel
-                          << " DENIED" << std::endl;
-            }
+            sender->Send(buffer, received);
             break;
         }
 
         // Remove channel reference
         case ChannelAction::SHUTDOWN_CHANNEL:
-            parsers.erase(msg.channel);
+            guard.Release(channels[msg.channel]);
             poisoned.erase(msg.channel);
+            pending.erase(msg.channel);
             approved.erase(msg.channel);
-            sender.Send(buffer, received);
+            sender->Send(buffer, received);
             std::cout << "guard: channel " << (int)msg.channel
                       << " SHUTDOWN, forwarded SHUTDOWN"
                       << std::endl;
@@ -296,20 +438,24 @@ int main(int argc, char *argv[]) {
                 break;
             }
 
-            GuardOpcodeParser &parser = parsers[msg.channel];
-            ParserState state =
-                parser.Parse(msg.payload.data(), msg.payload.size());
+            ParserState state;
+            {
+                // The policy cannot be freed by a reload while this parses.
+                EpochDomain::Guard reading(policy.Epoch(), policy_reader);
+                state = guard.Parse(channels[msg.channel], msg.payload.data(),
+                                    msg.payload.size());
+            }
 
             // The stream can no longer be trusted. Tell the OT side to tear the
-            // channel down, forget its parser, and drop everything further on
-            // it (a fresh CREATE for a reused id will clear the poison).
+            // channel down, reset its parser state, and drop everything further
+            // on it (a fresh CREATE for a reused id will clear the poison).
             if (state == ParserState::STREAM_CORRUPTED) {
                 BridgeMessage shutdown{msg.channel,
                                        ChannelAction::SHUTDOWN_CHANNEL, ""};
                 std::string wire = Multiplexer::Serialize(shutdown);
-                sender.Send(wire.data(), wire.size());
+                sender->Send(wire.data(), wire.size());
 
-                parsers.erase(msg.channel);
+                guard.Release(channels[msg.channel]);
                 approved.erase(msg.channel);
                 poisoned.insert(msg.channel);
                 std::cerr << "guard: channel " << (int)msg.channel
@@ -328,7 +474,7 @@ int main(int argc, char *argv[]) {
                           << " excising data, got: '" << msg.payload
                           << "'" << std::endl;
 
-                parser.Excise(msg.payload.data(), plen);
+                guard.Excise(msg.payload.data(), plen);
                 msg.payload.resize(plen);
 
                 std::cerr << "DENIED_DATA: channel " << (int)msg.channel
@@ -339,10 +485,10 @@ int main(int argc, char *argv[]) {
                     break; // nothing left to forward
 
                 std::string wire = Multiplexer::Serialize(msg);
-                sender.Send(wire.data(), wire.size());
+                sender->Send(wire.data(), wire.size());
             } else {
                 // Clean: forward the datagram verbatim.
-                sender.Send(buffer, received);
+                sender->Send(buffer, received);
             }
             break;
         }
@@ -351,19 +497,25 @@ int main(int argc, char *argv[]) {
 
     // Announce a clean teardown to the rest of the bridge: emit SHUTDOWN for
     // every still-approved channel so gcdbroker closes guacd and gmlbroker tears
-    // the browser down. SIGTERM now reaches us, so this runs within the stop
+    // the browser down, and for every channel still awaiting a verdict, which
+    // will not come now. SIGTERM now reaches us, so this runs within the stop
     // grace period on `docker compose down`. The main loop is the sole owner of
-    // `approved`/`sender`, and it has already left its loop here.
+    // `approved`/`pending`/`sender`, and it has already left its loop here.
+    for (const auto &entry : pending)
+        approved.insert(entry.first);
     for (uint16_t ch : approved) {
         BridgeMessage shutdown{ch, ChannelAction::SHUTDOWN_CHANNEL, ""};
         std::string wire = Multiplexer::Serialize(shutdown);
-        sender.Send(wire.data(), wire.size());
+        sender->Send(wire.data(), wire.size());
         std::cout << "guard: channel " << (int)ch << " SHUTDOWN on stop"
                   << std::endl;
     }
     approved.clear();
 
     // SIGINT/SIGTERM cleared `running`; the control listener's recv times out
-    // and the thread leaves its loop, so join it before returning.
+    // and the thread leaves its loop, so join it before returning. The policy
+    // thread wakes within its poll interval.
     control_thread.join();
+    policy_thread.join();
+    return 0;
 }
@@ -0,0 +1,90 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/approver.h"
+#include <cassert>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Waits on the approver's eventfd, as gmguard's receive loop does, until
+// `count` verdicts have been collected.
+std::vector<ApprovalVerdict> collect(Approver &approver, size_t count) {
+    std::vector<ApprovalVerdict> verdicts;
+    while (verdicts.size() < count) {
+        pollfd pfd{approver.WakeFd(), POLLIN, 0};
+        assert(::poll(&pfd, 1, 5000) == 1);
+        approver.TakeVerdicts(verdicts);
+    }
+    return verdicts;
+}
+
+} // namespace
+
+/**
+ * @brief Submitted requests come back as verdicts, in order, through the
+ * eventfd
+ */
+void test_verdicts() {
+    Approver approver;
+    approver.Submit(1, "0123456789ab");
+    approver.Submit(7, "aaaaaaaaaaaa");
+    std::vector<ApprovalVerdict> verdicts = collect(approver, 2);
+    assert(verdicts.size() == 2);
+    assert(verdicts[0].channel == 1 && verdicts[0].request_id == "0123456789ab");
+    assert(verdicts[1].channel == 7 && verdicts[1].request_id == "aaaaaaaaaaaa");
+    assert(verdicts[0].result.approved && verdicts[1].result.approved);
+
+    // The switch is read when the worker decides.
+    approver.SetApprove(false);
+    approver.Submit(7, "bbbbbbbbbbbb");
+    verdicts = collect(approver, 1);
+    assert(verdicts.size() == 1 && !verdicts[0].result.approved);
+    assert(!verdicts[0].result.reason.empty());
+
+    // Nothing left: the wake state is cleared and no verdict is repeated.
+    pollfd pfd{approver.WakeFd(), POLLIN, 0};
+    assert(::poll(&pfd, 1, 0) == 0);
+    verdicts.clear();
+    approver.TakeVerdicts(verdicts);
+    assert(verdicts.empty());
+}
+
+/**
+ * @brief An approver with requests still queued shuts down cleanly
+ */
+void test_stop_with_pending() {
+    Approver approver;
+    for (int i = 0; i < 100; ++i)
+        approver.Submit(static_cast<uint16_t>(i), "0123456789ab");
+}
+
+/**
+ * @brief Unit tests for the asynchronous approver
+ */
+int main() {
+    test_verdicts();
+
+    test_stop_with_pending();
+
+    return 0;
+}
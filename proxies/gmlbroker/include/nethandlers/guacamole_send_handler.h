@@ -21,11 +21,10 @@
 #pragma once
 
 #include "../../../shared/include/network/netqueue.h"
-#include "../approval_registry.h"
-#include "../channel_mailbox.h"
+#include "../channel_registry.h"
 #include <thread>
 
 class GuacamoleSendHandler {
     public:
-        std::thread Run(NetQueue &queue, MailboxRegistry &mailboxes, ApprovalRegistry &approvals);
+        std::thread Run(NetQueue &queue, ChannelRegistry &table);
 };
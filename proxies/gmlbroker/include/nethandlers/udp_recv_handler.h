@@ -20,11 +20,11 @@
 
 #pragma once
 
-#include "../../../shared/include/network/netqueue.h"
-#include "../../../shared/include/network/udpreceiver.h"
+#include "../../../shared/include/network/bridge_transport.h"
+#include "../router_queues.h"
 #include <thread>
 
 class UDPRecvHandler {
     public:
-        std::thread Run(NetQueue &queue, UDPReceiver &udp_receiver);
+        std::thread Run(RouterQueues &queues, BridgeReceiver &udp_receiver);
 };
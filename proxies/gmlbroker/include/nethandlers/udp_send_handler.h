@@ -21,10 +21,10 @@
 #pragma once
 
 #include "../../../shared/include/network/netqueue.h"
-#include "../../../shared/include/network/udpsender.h"
+#include "../../../shared/include/network/bridge_transport.h"
 #include <thread>
 
 class UDPSendHandler {
     public:
-        std::thread Run(NetQueue &queue, UDPSender &udp_sender);
+        std::thread Run(NetQueue &queue, BridgeSender &udp_sender);
 };
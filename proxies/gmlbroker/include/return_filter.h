@@ -20,7 +20,7 @@
 
 #pragma once
 
-#include "../../shared/include/parser/opcode_parser.h"
+#include "../../shared/include/parser/opcode_parser_core.h"
 #include <string>
 
 /**
@@ -36,7 +36,7 @@
  * Once piping, frames are forwarded verbatim without parsing, so large drawing
  * elements (e.g. image blobs) are never measured against the parser's limits.
  */
-class ReturnFilter : public OpcodeParser {
+class ReturnFilter : public OpcodeParserCore<ReturnFilter> {
   public:
     /**
      * @brief Feed guacd return bytes; returns the bytes to forward to the web
@@ -44,13 +44,16 @@ class ReturnFilter : public OpcodeParser {
      */
     std::string Feed(const char *data, size_t len);
 
-  protected:
-    bool OnInstructionBegin(const GuacElement &instr) override;
+  private:
+    friend class OpcodeParserCore<ReturnFilter>;
 
-    bool OnInstructionEnd() override;
+    bool OnInstructionBegin(const GuacElement &instr);
+    bool OnInstructionEnd();
 
-  private:
-    std::string current_opcode;
+    bool is_ready = false; // the current instruction is guacd's `ready`
     bool piping = false;  // true once guacd's `ready` has been swallowed
     size_t ready_end = 0; // offset of the drawing tail within the ready frame
 };
+
+// Instantiated in return_filter.cpp, next to the hooks it inlines.
+extern template class OpcodeParserCore<ReturnFilter>;
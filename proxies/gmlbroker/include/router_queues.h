@@ -0,0 +1,87 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/network/netqueue.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief How many return-path router threads to run
+ * (GMLBROKER_ROUTER_SHARDS, default 1, at most MAX_ROUTER_SHARDS)
+ */
+inline size_t router_shards() {
+    constexpr int MAX_ROUTER_SHARDS = 16;
+    const char *env = std::getenv("GMLBROKER_ROUTER_SHARDS");
+    int v = env ? std::atoi(env) : 0;
+    return static_cast<size_t>(v > 0 ? std::min(v, MAX_ROUTER_SHARDS) : 1);
+}
+
+/*
+ * @brief The return path's queues, one per router thread.
+ *
+ * A message goes to the shard its channel maps to, so each channel is routed
+ * by one thread only: its data and control frames (APPROVAL, SHUTDOWN) keep
+ * the order they were queued in, and that thread alone holds the channel's
+ * return filter. Different channels are routed in parallel.
+ */
+class RouterQueues {
+  public:
+    explicit RouterQueues(size_t shards) {
+        for (size_t i = 0; i < std::max<size_t>(shards, 1); ++i)
+            queues.push_back(std::make_unique<NetQueue>());
+    }
+
+    size_t Shards() const { return queues.size(); }
+
+    /**
+     * @brief The queue of one router thread
+     */
+    NetQueue &Shard(size_t shard) { return *queues[shard]; }
+
+    /**
+     * @brief The queue that routes @p channel
+     */
+    NetQueue &For(uint16_t channel) {
+        return *queues[channel % queues.size()];
+    }
+
+    /**
+     * @brief Queues a message on its channel's shard
+     */
+    void Enqueue(BridgeMessage &&message) {
+        For(message.channel).Enqueue(std::move(message));
+    }
+
+    /**
+     * @brief Closes every shard (see NetQueue::Close())
+     */
+    void Close() {
+        for (auto &queue : queues)
+            queue->Close();
+    }
+
+  private:
+    std::vector<std::unique_ptr<NetQueue>> queues;
+};
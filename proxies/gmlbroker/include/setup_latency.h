@@ -0,0 +1,111 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "../../shared/include/util/latency_histogram.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+/*
+ * @brief The steps a connection goes through before guacd's first frame
+ * reaches the browser, in order.
+ */
+enum class SetupPhase : uint8_t {
+    ACCEPTED,    // the web server's TCP connection was accepted
+    HANDSHAKE,   // the forged handshake with the web server is established
+    CREATE_SENT, // the approval request (CREATE) is queued for the bridge
+    VERDICT,     // the guard's verdict came back over the return path
+    REPLAYED,    // the captured handshake is queued for the bridge
+    FIRST_FRAME, // guacd's first return frame arrived for the browser
+    COUNT
+};
+
+/*
+ * @brief Short log name of a phase
+ */
+const char *setup_phase_name(SetupPhase phase);
+
+/*
+ * @brief When each setup phase of one channel was reached (µs on the steady
+ * clock, 0 while not yet reached).
+ *
+ * Phases are stamped by different threads — the accept thread, the channel's
+ * reader and the return-path router — so every stamp is atomic.
+ */
+struct SetupTimeline {
+    std::atomic<int64_t> at[static_cast<size_t>(SetupPhase::COUNT)] = {};
+};
+
+/*
+ * @brief Connection-setup latency: a histogram per phase of the time since the
+ * phase before it, and one of the whole setup.
+ *
+ * Mark() stamps a channel's phase only once, and only after the phase before
+ * it, so a phase reached out of order (e.g. a stray frame for a channel that
+ * never replayed) is not counted. When a channel reaches FIRST_FRAME its whole
+ * breakdown is logged.
+ */
+class SetupLatency {
+  public:
+    /*
+     * @brief Starts a channel's timeline at ACCEPTED (clearing any earlier one)
+     */
+    void Begin(SetupTimeline &timeline);
+
+    /*
+     * @brief Stamps a phase of a channel's timeline and records its latency
+     * @return whether the phase was stamped now
+     */
+    bool Mark(SetupTimeline &timeline, uint16_t channel, SetupPhase phase);
+
+    /*
+     * @brief Whether a channel has already reached a phase; cheap enough for
+     * the per-message path
+     */
+    static bool Reached(const SetupTimeline &timeline, SetupPhase phase) {
+        return timeline.at[static_cast<size_t>(phase)].load(
+                   std::memory_order_relaxed) != 0;
+    }
+
+    /*
+     * @brief Logs one line per phase with samples
+     */
+    void Report(const char *tag) const;
+
+  private:
+    // phases[p] holds the time from phase p-1 to p (ACCEPTED has none).
+    LatencyHistogram phases[static_cast<size_t>(SetupPhase::COUNT)];
+    LatencyHistogram total;
+};
+
+/*
+ * @brief Optional diagnostic: periodically log the setup latency histograms.
+ *
+ * Enabled only when `SETUP_STATS_MS` is set to a positive interval in
+ * milliseconds; otherwise this returns a non-joinable (no-op) thread. The
+ * returned thread polls `running` so it stops on shutdown; join it before
+ * `latency` is destroyed.
+ */
+std::thread StartSetupReporter(const SetupLatency &latency,
+                               const std::atomic<bool> &running,
+                               const char *tag);
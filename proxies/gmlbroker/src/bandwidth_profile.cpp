@@ -0,0 +1,359 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/bandwidth_profile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Protocols that can have a profile of their own (BANDWIDTH_PROFILE_<NAME>).
+const char *const PROTOCOLS[] = {"rdp", "vnc", "ssh", "telnet", "kubernetes"};
+
+// The estimate's reference session: a full-HD desktop at 32 bits doing steady
+// office work (typing, scrolling, switching windows). About half a screen of
+// pixels changes per second, and guacd's PNG/JPEG/WebP re-encoding gets that
+// to roughly an eighth of its raw size. Lower colour depths and smaller
+// displays scale it down in proportion.
+constexpr int REF_WIDTH = 1920;
+constexpr int REF_HEIGHT = 1080;
+constexpr int REF_DEPTH = 32;
+constexpr double SCREENS_PER_SECOND = 0.5;
+constexpr double COMPRESSION = 8.0;
+
+// Extra redraw traffic of each desktop feature while it is on. guacd leaves
+// the enable-* features off and GFX on unless the connection asks otherwise.
+constexpr double WALLPAPER_COST = 1.25;
+constexpr double THEMING_COST = 1.10;
+constexpr double FONT_SMOOTHING_COST = 1.15;
+constexpr double FULL_WINDOW_DRAG_COST = 1.30;
+constexpr double DESKTOP_COMPOSITION_COST = 1.20;
+constexpr double MENU_ANIMATIONS_COST = 1.10;
+constexpr double GFX_COST = 1.10;
+
+std::optional<BandwidthProfile> builtin(const std::string &name) {
+    BandwidthProfile p;
+    p.name = name;
+    if (name == "full")
+        return p; // no caps: replay as captured
+    if (name == "balanced") {
+        p.color_depth = 24;
+        p.max_width = 1920;
+        p.max_height = 1080;
+        p.max_dpi = 96;
+        p.wallpaper = false;
+        p.full_window_drag = false;
+        p.desktop_composition = false;
+        p.menu_animations = false;
+        return p;
+    }
+    if (name == "low" || name == "minimal") {
+        bool minimal = name == "minimal";
+        p.color_depth = minimal ? 8 : 16;
+        p.max_width = minimal ? 1024 : 1280;
+        p.max_height = minimal ? 768 : 800;
+        p.max_dpi = 96;
+        p.wallpaper = false;
+        p.theming = false;
+        p.font_smoothing = false;
+        p.full_window_drag = false;
+        p.desktop_composition = false;
+        p.menu_animations = false;
+        if (minimal)
+            p.gfx = false;
+        return p;
+    }
+    return std::nullopt;
+}
+
+// A positive decimal, or 0 for anything else (including empty).
+int to_int(const std::string &s) {
+    if (s.empty() || s.size() > 6 ||
+        !std::all_of(s.begin(), s.end(),
+                     [](unsigned char c) { return std::isdigit(c); }))
+        return 0;
+    return std::atoi(s.c_str());
+}
+
+// Scales a width and height down into the cap, keeping the aspect ratio.
+void cap_size(std::string &width, std::string &height, int max_width,
+              int max_height) {
+    int w = to_int(width), h = to_int(height);
+    if (w <= 0 || h <= 0)
+        return;
+    double f = 1.0;
+    if (max_width > 0)
+        f = std::min(f, double(max_width) / w);
+    if (max_height > 0)
+        f = std::min(f, double(max_height) / h);
+    if (f >= 1.0)
+        return;
+    width = std::to_string(std::max(1, int(w * f)));
+    height = std::to_string(std::max(1, int(h * f)));
+}
+
+void cap_value(std::string &value, int cap) {
+    int v = to_int(value);
+    if (cap > 0 && v > cap)
+        value = std::to_string(cap);
+}
+
+std::optional<bool> parse_switch(const std::string &v) {
+    if (v == "on" || v == "true" || v == "1")
+        return true;
+    if (v == "off" || v == "false" || v == "0")
+        return false;
+    return std::nullopt;
+}
+
+std::optional<bool> *feature(BandwidthProfile &p, const std::string &key) {
+    if (key == "wallpaper")
+        return &p.wallpaper;
+    if (key == "theming")
+        return &p.theming;
+    if (key == "font-smoothing")
+        return &p.font_smoothing;
+    if (key == "full-window-drag")
+        return &p.full_window_drag;
+    if (key == "desktop-composition")
+        return &p.desktop_composition;
+    if (key == "menu-animations")
+        return &p.menu_animations;
+    if (key == "gfx")
+        return &p.gfx;
+    return nullptr;
+}
+
+std::string format_kbps(double kbps) {
+    std::ostringstream s;
+    if (kbps >= 1000)
+        s << std::fixed << std::setprecision(1) << kbps / 1000 << " Mbit/s";
+    else
+        s << static_cast<int>(kbps + 0.5) << " kbit/s";
+    return s.str();
+}
+
+} // namespace
+
+std::optional<BandwidthProfile>
+BandwidthProfile::Parse(const std::string &spec) {
+    std::istringstream in(spec);
+    std::string token;
+    std::getline(in, token, ',');
+    std::optional<BandwidthProfile> p = builtin(token);
+    if (!p)
+        return std::nullopt;
+
+    while (std::getline(in, token, ',')) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos)
+            return std::nullopt;
+        std::string key = token.substr(0, eq);
+        std::string value = token.substr(eq + 1);
+        if (key == "color-depth") {
+            int depth = to_int(value);
+            if (depth != 8 && depth != 16 && depth != 24 && depth != 32)
+                return std::nullopt;
+            p->color_depth = depth;
+        } else if (key == "max-size") {
+            size_t x = value.find('x');
+            if (x == std::string::npos)
+                return std::nullopt;
+            p->max_width = to_int(value.substr(0, x));
+            p->max_height = to_int(value.substr(x + 1));
+            if (p->max_width <= 0 || p->max_height <= 0)
+                return std::nullopt;
+        } else if (key == "max-dpi") {
+            if ((p->max_dpi = to_int(value)) <= 0)
+                return std::nullopt;
+        } else if (std::optional<bool> *f = feature(*p, key)) {
+            if (!(*f = parse_switch(value)))
+                return std::nullopt;
+        } else {
+            return std::nullopt;
+        }
+    }
+    p->name = spec;
+    return p;
+}
+
+void BandwidthProfile::RewriteSize(std::vector<std::string> &size_args) const {
+    if (size_args.size() >= 2)
+        cap_size(size_args[0], size_args[1], max_width, max_height);
+    if (size_args.size() >= 3)
+        cap_value(size_args[2], max_dpi);
+}
+
+void BandwidthProfile::RewriteConnect(const std::vector<std::string> &names,
+                                      std::vector<std::string> &values) const {
+    auto value_of = [&](const char *name) -> std::string * {
+        for (size_t i = 1; i < names.size() && i < values.size(); ++i)
+            if (names[i] == name)
+                return &values[i];
+        return nullptr;
+    };
+    auto set = [&](const char *name, const std::string &v) {
+        if (std::string *value = value_of(name))
+            *value = v;
+    };
+
+    if (std::string *depth = value_of("color-depth");
+        depth && color_depth > 0) {
+        int v = to_int(*depth);
+        if (v <= 0 || v > color_depth)
+            *depth = std::to_string(color_depth); // empty: guacd's 32 bits
+    }
+
+    // An explicit size in the connection settings wins over `size`, so cap it
+    // too. Resizing later would undo the cap, so it is turned off.
+    if (max_width > 0 || max_height > 0) {
+        std::string *w = value_of("width"), *h = value_of("height");
+        if (w && h)
+            cap_size(*w, *h, max_width, max_height);
+        set("resize-method", "");
+    }
+    if (std::string *dpi = value_of("dpi"))
+        cap_value(*dpi, max_dpi);
+
+    auto set_switch = [&](const char *name, const std::optional<bool> &on) {
+        if (on)
+            set(name, *on ? "true" : "false");
+    };
+    set_switch("enable-wallpaper", wallpaper);
+    set_switch("enable-theming", theming);
+    set_switch("enable-font-smoothing", font_smoothing);
+    set_switch("enable-full-window-drag", full_window_drag);
+    set_switch("enable-desktop-composition", desktop_composition);
+    set_switch("enable-menu-animations", menu_animations);
+    if (gfx)
+        set("disable-gfx", *gfx ? "false" : "true");
+}
+
+double BandwidthProfile::EstimatedKbps() const {
+    std::string w = std::to_string(REF_WIDTH), h = std::to_string(REF_HEIGHT);
+    cap_size(w, h, max_width, max_height);
+    int depth = color_depth > 0 ? std::min(color_depth, REF_DEPTH) : REF_DEPTH;
+
+    double bits = double(to_int(w)) * to_int(h) * depth * SCREENS_PER_SECOND /
+                  COMPRESSION;
+    if (wallpaper.value_or(false))
+        bits *= WALLPAPER_COST;
+    if (theming.value_or(false))
+        bits *= THEMING_COST;
+    if (font_smoothing.value_or(false))
+        bits *= FONT_SMOOTHING_COST;
+    if (full_window_drag.value_or(false))
+        bits *= FULL_WINDOW_DRAG_COST;
+    if (desktop_composition.value_or(false))
+        bits *= DESKTOP_COMPOSITION_COST;
+    if (menu_animations.value_or(false))
+        bits *= MENU_ANIMATIONS_COST;
+    if (gfx.value_or(true))
+        bits *= GFX_COST;
+    return bits / 1000;
+}
+
+std::string BandwidthProfile::Describe() const {
+    std::ostringstream s;
+    const char *sep = "";
+    auto item = [&]() -> std::ostringstream & {
+        s << sep;
+        sep = ", ";
+        return s;
+    };
+    if (color_depth > 0)
+        item() << "color-depth<=" << color_depth;
+    if (max_width > 0 || max_height > 0)
+        item() << "max-size=" << max_width << "x" << max_height;
+    if (max_dpi > 0)
+        item() << "max-dpi=" << max_dpi;
+    const std::pair<const char *, const std::optional<bool> *> features[] = {
+        {"wallpaper", &wallpaper},
+        {"theming", &theming},
+        {"font-smoothing", &font_smoothing},
+        {"full-window-drag", &full_window_drag},
+        {"desktop-composition", &desktop_composition},
+        {"menu-animations", &menu_animations},
+        {"gfx", &gfx}};
+    for (const auto &[name, on] : features)
+        if (*on)
+            item() << name << "=" << (**on ? "on" : "off");
+    if (*sep == '\0')
+        s << "no caps";
+    return s.str();
+}
+
+BandwidthPolicy BandwidthPolicy::FromEnv() {
+    BandwidthPolicy policy;
+    auto read = [](const std::string &var) -> std::optional<BandwidthProfile> {
+        const char *env = std::getenv(var.c_str());
+        if (!env || !*env)
+            return std::nullopt;
+        std::optional<BandwidthProfile> p = BandwidthProfile::Parse(env);
+        if (!p)
+            std::cerr << var << ": ignoring invalid bandwidth profile '" << env
+                      << "'" << std::endl;
+        return p;
+    };
+
+    policy.fallback = read("BANDWIDTH_PROFILE");
+    for (const char *protocol : PROTOCOLS) {
+        std::string var = "BANDWIDTH_PROFILE_";
+        for (const char *c = protocol; *c; ++c)
+            var += static_cast<char>(
+                std::toupper(static_cast<unsigned char>(*c)));
+        if (std::optional<BandwidthProfile> p = read(var))
+            policy.per_protocol[protocol] = std::move(*p);
+    }
+    return policy;
+}
+
+const BandwidthProfile *
+BandwidthPolicy::For(const std::string &protocol) const {
+    auto it = per_protocol.find(protocol);
+    if (it != per_protocol.end())
+        return &it->second;
+    return fallback ? &*fallback : nullptr;
+}
+
+void BandwidthPolicy::Log(const char *tag) const {
+    auto log = [tag](const std::string &scope, const BandwidthProfile &p) {
+        std::cout << tag << ": bandwidth profile '" << p.name << "' for "
+                  << scope << ": " << p.Describe() << "; estimated "
+                  << format_kbps(p.EstimatedKbps())
+                  << " per desktop session" << std::endl;
+    };
+    if (fallback)
+        log("all protocols", *fallback);
+    for (const char *protocol : PROTOCOLS) {
+        auto it = per_protocol.find(protocol);
+        if (it != per_protocol.end())
+            log(protocol, it->second);
+    }
+}
+
+const BandwidthPolicy &bandwidth_policy() {
+    static const BandwidthPolicy policy = BandwidthPolicy::FromEnv();
+    return policy;
+}
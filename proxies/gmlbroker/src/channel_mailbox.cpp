@@ -82,23 +82,3 @@ void ChannelMailbox::Drain(std::vector<std::string> &out, bool &out_teardown,
     out_teardown = teardown;
     out_announce = announce;
 }
-
-std::shared_ptr<ChannelMailbox> MailboxRegistry::Create(uint16_t channel) {
-    auto mailbox = std::make_shared<ChannelMailbox>();
-    std::lock_guard<std::mutex> lock(mtx);
-    mailboxes[channel] = mailbox;
-    return mailbox;
-}
-
-std::shared_ptr<ChannelMailbox> MailboxRegistry::Get(uint16_t channel) const {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = mailboxes.find(channel);
-    if (it == mailboxes.end())
-        return nullptr;
-    return it->second;
-}
-
-void MailboxRegistry::Remove(uint16_t channel) {
-    std::lock_guard<std::mutex> lock(mtx);
-    mailboxes.erase(channel);
-}
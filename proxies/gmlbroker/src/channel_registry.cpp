@@ -0,0 +1,97 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/channel_registry.h"
+#include <optional>
+
+namespace {
+
+/*
+ * @brief Packs a 12-hex-char request id into 48 bits; nullopt if malformed
+ */
+std::optional<uint64_t> pack_request_id(const std::string &id) {
+    if (id.size() != 12)
+        return std::nullopt;
+    uint64_t packed = 0;
+    for (char c : id) {
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return std::nullopt;
+        packed = (packed << 4) | static_cast<uint64_t>(digit);
+    }
+    return packed;
+}
+
+} // namespace
+
+ChannelRegistry::~ChannelRegistry() {
+    // Only reached after every reader and router has stopped.
+    for (size_t channel = 0; channel < CHANNELS; ++channel)
+        delete StateOf(static_cast<uint16_t>(channel)).mailbox.load();
+}
+
+void ChannelRegistry::Open(uint16_t channel) {
+    GmlChannelState &state = StateOf(channel);
+    state.approval.store(0);
+    setup.Begin(state.setup);
+    delete state.mailbox.exchange(new ChannelMailbox());
+}
+
+void ChannelRegistry::SetRequestId(uint16_t channel, const std::string &id) {
+    std::optional<uint64_t> packed = pack_request_id(id);
+    if (packed)
+        StateOf(channel).approval.store(REQUESTED | *packed);
+}
+
+bool ChannelRegistry::Approve(uint16_t channel, const std::string &id) {
+    std::optional<uint64_t> packed = pack_request_id(id);
+    if (!packed)
+        return false;
+    // One CAS both matches the id and sets the bit, so a stale verdict can't
+    // approve a channel that was released and reopened in between.
+    uint64_t expected = REQUESTED | *packed;
+    if (StateOf(channel).approval.compare_exchange_strong(expected,
+                                                          expected | APPROVED))
+        return true;
+    return expected == (REQUESTED | APPROVED | *packed); // duplicate verdict
+}
+
+bool ChannelRegistry::Matches(uint16_t channel, const std::string &id) const {
+    std::optional<uint64_t> packed = pack_request_id(id);
+    return packed &&
+           (StateOf(channel).approval.load() & ~APPROVED) == (REQUESTED | *packed);
+}
+
+std::optional<int> ChannelRegistry::Release(uint16_t channel) {
+    GmlChannelState &state = StateOf(channel);
+    ChannelMailbox *mailbox = state.mailbox.exchange(nullptr);
+    state.approval.store(0);
+    if (mailbox) {
+        epoch.Synchronize(); // no router still holds the pointer after this
+        delete mailbox;
+    }
+    return Remove(channel);
+}
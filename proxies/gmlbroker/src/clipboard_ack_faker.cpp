@@ -40,22 +40,14 @@ std::string make_ack(int sidx) {
 }
 } // namespace
 
-std::string ClipboardAckFaker::Feed(const char *data, size_t len) {
-    acks.clear();
-    // Browser input is well-formed ASCII Guacamole, but fail open like the other
-    // faker: a stray byte should resync, not permanently stop ack-faking.
-    size_t off = 0;
-    while (off < len) {
-        if (Parse(data + off, len - off) != ParserState::STREAM_CORRUPTED)
-            break;
-        off += CurrentIndex() + 1;
-        Reset();
-    }
-    return acks;
+std::string ClipboardAckFaker::TakeAcks() {
+    std::string taken;
+    taken.swap(acks);
+    return taken;
 }
 
 bool ClipboardAckFaker::OnInstructionBegin(const GuacElement &instr) {
-    current_opcode.assign(instr.ptr, instr.len);
+    current_opcode = clipboard::stream_opcode(instr.View());
     current_arg = 0;
     blob_on_clipboard = false;
     return true; // observe only; never deny
@@ -67,11 +59,12 @@ bool ClipboardAckFaker::OnArgument(const GuacElement &arg) {
     // The first argument of clipboard/blob/end is the stream index.
     if (current_arg == 1) {
         int sidx = parse_index(arg);
-        if (current_opcode == "clipboard")
+        if (current_opcode == clipboard::StreamOpcode::CLIPBOARD)
             clipboard_sidx = sidx; // start tracking this stream
-        else if (current_opcode == "blob")
+        else if (current_opcode == clipboard::StreamOpcode::BLOB)
             blob_on_clipboard = (sidx >= 0 && sidx == clipboard_sidx);
-        else if (current_opcode == "end" && sidx == clipboard_sidx)
+        else if (current_opcode == clipboard::StreamOpcode::END &&
+                 sidx == clipboard_sidx)
             clipboard_sidx = -1; // stream closed
     }
     // The second argument of a clipboard blob is its payload. If it exceeds the
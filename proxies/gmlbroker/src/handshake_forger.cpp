@@ -26,10 +26,14 @@
 namespace {
 
 // Build one Guacamole instruction from its elements: "len.elem,len.elem,...;"
+// Lengths count code points: UTF-8 continuation bytes are not counted.
 std::string instr(const std::vector<std::string> &elems) {
     std::string s;
     for (size_t i = 0; i < elems.size(); ++i) {
-        s += std::to_string(elems[i].size());
+        size_t len = 0;
+        for (unsigned char c : elems[i])
+            len += (c & 0xC0) != 0x80;
+        s += std::to_string(len);
         s += '.';
         s += elems[i];
         s += (i + 1 < elems.size()) ? ',' : ';';
@@ -111,6 +115,7 @@ std::string HandshakeForger::Feed(const char *data, size_t len) {
     out.clear();
     // Keep a verbatim copy of the handshake so it can be replayed to the real
     // guacd once approved. (Feed is only called before ESTABLISHED.)
+    feed_start = handshake_raw.size();
     handshake_raw.append(data, len);
     Parse(data, len);
     if (GetState() == ParserState::STREAM_CORRUPTED)
@@ -135,6 +140,14 @@ bool HandshakeForger::OnArgument(const GuacElement &arg) {
 }
 
 bool HandshakeForger::OnInstructionEnd() {
+    // Instructions are back to back, so this one ends where the next begins.
+    size_t end = feed_start + CurrentIndex() + 1;
+    if (current_opcode == "size")
+        size_range = {instr_start, end};
+    else if (current_opcode == "connect")
+        connect_range = {instr_start, end};
+    instr_start = end;
+
     // After select was sent, send fake connection parameters
     if (current_opcode == "select") {
         out += CannedArgs();
@@ -159,6 +172,43 @@ std::string HandshakeForger::CannedArgs() const {
     return SSH_ARGS_1_6_0; // PoC fallback
 }
 
+std::vector<std::string> HandshakeForger::ArgNames() const {
+    // The canned reply is ASCII, so lengths are byte counts.
+    std::string args = CannedArgs();
+    std::vector<std::string> names;
+    size_t pos = 0;
+    while (pos < args.size()) {
+        size_t dot = args.find('.', pos);
+        size_t len = std::stoul(args.substr(pos, dot - pos));
+        names.push_back(args.substr(dot + 1, len));
+        pos = dot + 1 + len + 1; // past the ',' or ';'
+    }
+    names.erase(names.begin()); // the "args" opcode
+    return names;
+}
+
+std::string HandshakeForger::Handshake(const BandwidthProfile &profile) const {
+    if (connect_range.second == 0)
+        return handshake_raw; // no connect captured: nothing to rewrite
+
+    std::vector<std::string> connect = connect_values;
+    profile.RewriteConnect(ArgNames(), connect);
+    connect.insert(connect.begin(), "connect");
+
+    // Splice from the back so the earlier range stays valid.
+    std::string s = handshake_raw;
+    s.replace(connect_range.first, connect_range.second - connect_range.first,
+              instr(connect));
+    if (size_range.second != 0 && size_range.second <= connect_range.first) {
+        std::vector<std::string> size = size_args;
+        profile.RewriteSize(size);
+        size.insert(size.begin(), "size");
+        s.replace(size_range.first, size_range.second - size_range.first,
+                  instr(size));
+    }
+    return s;
+}
+
 std::string HandshakeForger::WaitingScreen() const {
     // PROVISIONAL: paint the default layer a solid colour. The exact compositing
     // mode and argument order are to be confirmed against the 1.6.0 client when
@@ -186,3 +236,5 @@ std::string HandshakeForger::DeniedScreen() {
     s += instr({"disconnect"});
     return s;
 }
+
+template class OpcodeParserCore<HandshakeForger>;
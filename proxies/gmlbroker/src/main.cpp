@@ -18,7 +18,7 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-#include "../../shared/include/network/channeltable.h"
+#include "../../shared/include/network/bridge_transport.h"
 #include "../../shared/include/network/netqueue.h"
 #include "../../shared/include/network/guacamole_server.h"
 #include "../../shared/include/network/reader_group.h"
@@ -27,20 +27,25 @@
 #include "../../shared/include/util/control_channel.h"
 #include "../../shared/include/util/netargs.h"
 #include "../../shared/include/util/queue_monitor.h"
+#include "../../shared/include/util/timer_wheel.h"
 #include "../include/nethandlers/guacamole_accept_handler.h"
 #include "../include/nethandlers/guacamole_send_handler.h"
 #include "../include/nethandlers/udp_recv_handler.h"
 #include "../include/nethandlers/udp_send_handler.h"
-#include "../include/channel_mailbox.h"
-#include "../include/running.h"
+#include "../include/router_queues.h"
+#include "../include/bandwidth_profile.h"
+#include "../include/channel_registry.h"
+#include "../include/setup_latency.h"
+#include "../../shared/include/util/running.h"
 #include <atomic>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <signal.h>
 #include <thread>
+#include <vector>
 
-std::atomic<bool> running = true;
-
+namespace {
 /*
  * @brief Signals all threads to stop when an interrupt signal is received
  */
@@ -48,6 +53,7 @@ void interrupt_handler(int signum) {
     std::cout << "Stopping program..." << std::endl;
     running = false;
 }
+} // namespace
 
 /*
  * @brief Starts the Guacamole broker that imitates the guacd program and
@@ -105,18 +111,22 @@ int main(int argc, char *argv[]) {
     std::cout << "Listening on TCP port " << guac_listen_port << "..."
               << std::endl;
 
-    UDPReceiver udp_receiver(udp_recv_port);
-    if ((exit = udp_receiver.Initialize()) != 0)
+    // The bridge hops: UDP, or shared-memory rings when both neighbours run
+    // on this host (BRIDGE_TRANSPORT=shm).
+    std::unique_ptr<BridgeReceiver> udp_receiver =
+        MakeBridgeReceiver(udp_recv_port);
+    if ((exit = udp_receiver->Initialize()) != 0)
         return exit;
 
-    std::cout << "Initialized UDP receiver on port " << udp_recv_port
+    std::cout << "Initialized bridge receiver on port " << udp_recv_port
               << std::endl;
 
-    UDPSender udp_sender(udp_send_ip, udp_send_port);
-    if ((exit = udp_sender.Initialize()) != 0)
+    std::unique_ptr<BridgeSender> udp_sender =
+        MakeBridgeSender(udp_send_ip, udp_send_port);
+    if ((exit = udp_sender->Initialize()) != 0)
         return exit;
 
-    std::cout << "Initialized UDP sender for " << udp_send_ip << ":"
+    std::cout << "Initialized bridge sender for " << udp_send_ip << ":"
               << udp_send_port << std::endl;
 
     // Demo affordance: relay the approval switch from the IT side to the guard.
@@ -125,82 +135,111 @@ int main(int argc, char *argv[]) {
     // gmlbroker forwards a recognised "approve"/"deny" (e.g. from nettest) on to
     // the guard's control port. NOTE: this intentionally re-opens an IT->gate
     // channel; for a hardened deployment, remove it and toggle only from the
-    // OT-side approver.
+    // OT-side approver. In gdd-allinone (BRIDGE_TRANSPORT=mem) the guard binds
+    // the control port itself in this same process, so there is nothing to
+    // relay.
     int apprv_port = ControlChannel::APPROVAL_CONTROL_PORT;
+    bool relay_control = !bridge_in_process();
     UDPReceiver control_receiver(apprv_port);
-    if ((exit = control_receiver.Initialize()) != 0)
-        return exit;
     UDPSender control_sender(udp_send_ip, apprv_port);
-    if ((exit = control_sender.Initialize()) != 0)
-        return exit;
-    std::cout << "Relaying approval toggles on UDP port " << apprv_port << " to "
-              << udp_send_ip << ":" << apprv_port << std::endl;
+    if (relay_control) {
+        if ((exit = control_receiver.Initialize()) != 0)
+            return exit;
+        if ((exit = control_sender.Initialize()) != 0)
+            return exit;
+        std::cout << "Relaying approval toggles on UDP port " << apprv_port
+                  << " to " << udp_send_ip << ":" << apprv_port << std::endl;
+    }
 
-    ChannelTable table; // Shared by accept thread and guacamole_send thread to keep track of connections
-    ApprovalRegistry approvals; // Per-channel approval flags
-    MailboxRegistry mailboxes; // Per-channel outbound mailbox: the reader is the sole socket writer
+    // Caps on what each session may cost the diode (BANDWIDTH_PROFILE*).
+    bandwidth_policy().Log("gmlbroker");
+
+    ChannelRegistry table; // Flat per-channel fd, outbound mailbox and approval state, shared by all handlers
     ReaderGroup readers; // Tracks the per-connection reader threads for shutdown
-    NetQueue recv_queue;
+    TimerWheel timers; // Waiting-screen heartbeats for all channels
+    // Return path, one queue per router thread (GMLBROKER_ROUTER_SHARDS)
+    RouterQueues recv_queues(router_shards());
     NetQueue send_queue;
 
     // Start the handler threads. The accept and guacamole_send handlers route by
-    // channel via the shared ChannelTable and ApprovalRegistry; the UDP
+    // channel via the shared ChannelRegistry; the UDP
     // handlers ferry between the bridge and the queues.
     GuacamoleAcceptHandler accept_handler;
     GuacamoleSendHandler guacamole_send_handler;
     UDPSendHandler udp_send_handler;
     UDPRecvHandler udp_recv_handler;
 
-    std::thread t_accept =
-        accept_handler.Run(send_queue, recv_queue, gml_server, table, approvals, mailboxes, readers);
-    std::thread t_guacamole_send =
-        guacamole_send_handler.Run(recv_queue, mailboxes, approvals);
-    std::thread t_udp_send = udp_send_handler.Run(send_queue, udp_sender);
-    std::thread t_udp_recv = udp_recv_handler.Run(recv_queue, udp_receiver);
+    // One accept thread per listener (GMLBROKER_ACCEPT_SHARDS).
+    std::vector<std::thread> t_accept;
+    for (size_t shard = 0; shard < gml_server.Shards(); ++shard)
+        t_accept.push_back(accept_handler.Run(send_queue, recv_queues,
+                                              gml_server, table, readers,
+                                              timers, shard));
+    std::vector<std::thread> t_guacamole_send;
+    for (size_t shard = 0; shard < recv_queues.Shards(); ++shard)
+        t_guacamole_send.push_back(
+            guacamole_send_handler.Run(recv_queues.Shard(shard), table));
+    std::thread t_udp_send = udp_send_handler.Run(send_queue, *udp_sender);
+    std::thread t_udp_recv = udp_recv_handler.Run(recv_queues, *udp_receiver);
 
     // Validating relay: only recognised toggles are forwarded (normalised), so
     // arbitrary bytes never reach the guard's control port. The receiver's 200 ms
     // SO_RCVTIMEO lets this loop observe `running` and stop on shutdown.
-    std::thread t_control([&control_receiver, &control_sender]() {
-        char buf[256];
-        while (running) {
-            int n = control_receiver.Receive(buf, sizeof(buf));
-            if (n <= 0)
-                continue;
-            std::optional<bool> mode =
-                ControlChannel::ParseApprovalToggle(std::string(buf, n));
-            if (!mode) {
-                std::cerr << "gmlbroker: ignored unrecognised approval command"
-                          << std::endl;
-                continue;
+    std::thread t_control;
+    if (relay_control)
+        t_control = std::thread([&control_receiver, &control_sender]() {
+            char buf[256];
+            while (running) {
+                int n = control_receiver.Receive(buf, sizeof(buf));
+                if (n <= 0)
+                    continue;
+                std::optional<bool> mode =
+                    ControlChannel::ParseApprovalToggle(std::string(buf, n));
+                if (!mode) {
+                    std::cerr << "gmlbroker: ignored unrecognised approval "
+                                 "command"
+                              << std::endl;
+                    continue;
+                }
+                std::string norm = *mode ? "approve" : "deny";
+                control_sender.Send(norm.data(), norm.size());
+                std::cout << "gmlbroker: relayed approval toggle (" << norm
+                          << ") to the guard" << std::endl;
             }
-            std::string norm = *mode ? "approve" : "deny";
-            control_sender.Send(norm.data(), norm.size());
-            std::cout << "gmlbroker: relayed approval toggle (" << norm
-                      << ") to the guard" << std::endl;
-        }
-    });
-
-    // Optional diagnostic (set QUEUE_STATS_MS): watch for the return-path
-    // recv_queue growing, which means the browser side can't drain the bridge.
+        });
+
+    // Optional diagnostic (set SETUP_STATS_MS): per-phase connection-setup
+    // latency histograms.
+    std::thread t_setup_stats =
+        StartSetupReporter(table.Setup(), running, "gmlbroker");
+
+    // Optional diagnostic (set QUEUE_STATS_MS): watch for a return-path
+    // queue growing, which means the browser side can't drain the bridge.
     // std::thread t_qstats =
-    //     StartQueueMonitor(recv_queue, send_queue, running, "gmlbroker");
-
-    // Shutdown ordering (SIGINT clears `running`): the blocked accept() and
-    // recvfrom() time out (SO_RCVTIMEO), so the two producer threads fall out of
-    // their loops first. recv_queue then has no producer, so closing it drains
-    // t_guacamole_send — once it is gone, only the detached reader threads still
-    // touch the table and gml_server. We wake those readers by shutting down
-    // their fds (each reader still owns its own close()) and WaitAll() for them
-    // before destroying the state they capture. Finally send_queue, whose last
-    // producers were those readers, is closed to drain t_udp_send.
+    //     StartQueueMonitor(recv_queues.Shard(0), send_queue, running,
+    //                       "gmlbroker");
+
+    // Shutdown ordering (SIGINT clears `running`): the accept poll() and the
+    // blocked bridge receive time out, so the producer threads fall out of
+    // their loops first. recv_queues then have no producer, so closing them
+    // drains the t_guacamole_send routers — once they are gone, only the
+    // detached reader threads still touch the table and gml_server. We wake
+    // those readers by shutting down their fds (each reader still owns its own
+    // close()) and WaitAll() for them before destroying the state they capture.
+    // Finally send_queue, whose last producers were those readers, is closed to
+    // drain t_udp_send.
     // if (t_qstats.joinable())
     //     t_qstats.join();
-    t_accept.join();
+    if (t_setup_stats.joinable())
+        t_setup_stats.join();
+    for (std::thread &t : t_accept)
+        t.join();
     t_udp_recv.join();
-    t_control.join();
-    recv_queue.Close();
-    t_guacamole_send.join();
+    if (t_control.joinable())
+        t_control.join();
+    recv_queues.Close();
+    for (std::thread &t : t_guacamole_send)
+        t.join();
 
     for (int fd : table.Fds())
         gml_server.Shutdown(fd);
@@ -208,4 +247,5 @@ int main(int argc, char *argv[]) {
 
     send_queue.Close();
     t_udp_send.join();
+    return 0;
 }
@@ -20,61 +20,79 @@
 
 #include "../../include/nethandlers/guacamole_accept_handler.h"
 #include "../../include/nethandlers/guacamole_read_handler.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include <iostream>
 #include <optional>
+#include <vector>
 
 // [ISSUE] MS: Also in this case there is no cap on the created threads which opens up DoS possibilties again.
 //             A client that opens many connections (up to 65536) and can exhaust memory.
 
+namespace {
+// How long one accept wait may last before the loop re-checks `running`.
+constexpr int ACCEPT_POLL_MS = 200;
+} // namespace
+
 /*
- * @brief Accepts Guacamole connections, allocating a channel for each
+ * @brief Accepts Guacamole connections on one listener, allocating a channel
+ * for each
+ *
+ * Each wake-up takes the listener's whole pending backlog at once (see
+ * GuacamoleServer::AcceptBatch), so a burst of connects is not paced by one
+ * poll per connection. Several of these run side by side when the server
+ * shards its listeners; the channel registry is safe to allocate from all of
+ * them.
  */
-std::thread GuacamoleAcceptHandler::Run(NetQueue &queue, NetQueue &recv_queue,
+std::thread GuacamoleAcceptHandler::Run(NetQueue &queue, RouterQueues &recv_queues,
                                   GuacamoleServer &guacamole_server,
-                                  ChannelTable &table,
-                                  ApprovalRegistry &approvals,
-                                  MailboxRegistry &mailboxes,
-                                  ReaderGroup &readers) {
-    return std::thread([&queue, &recv_queue, &guacamole_server, &table, &approvals, &mailboxes, &readers]() {
+                                  ChannelRegistry &table,
+                                  ReaderGroup &readers, TimerWheel &timers,
+                                  size_t shard) {
+    return std::thread([&queue, &recv_queues, &guacamole_server, &table, &readers, &timers, shard]() {
+        std::vector<int> accepted;
+        accepted.reserve(GuacamoleServer::ACCEPT_BATCH);
+
         while (running) {
-            int fd = guacamole_server.Accept();
-            if (fd < 0) {
-                if (running)
-                    continue;
-                break;
-            }
+            accepted.clear();
+            if (guacamole_server.AcceptBatch(shard, accepted, ACCEPT_POLL_MS) < 0)
+                break; // listener gone
 
-            // Try to allocate the lowest channel not yet taken
-            std::optional<uint16_t> channel = table.Allocate(fd);
-            if (!channel) {
-                std::cerr
-                    << "accept_handler: channel table full, rejecting client"
-                    << std::endl;
-                guacamole_server.Close(fd);
-                continue;
-            }
+            for (int fd : accepted) {
+                // Allocate the next free channel after the last one handed out
+                std::optional<uint16_t> channel = table.Allocate(fd);
+                if (!channel) {
+                    std::cerr
+                        << "accept_handler: channel table full, rejecting client"
+                        << std::endl;
+                    guacamole_server.Close(fd);
+                    continue;
+                }
 
-            // Register the channel's approval state and outbound mailbox before
-            // its reader can run, so the guacamole_send thread can always route
-            // to it. The CREATE (approval request) is sent later, once the forged
-            // handshake is done — nothing crosses the bridge for an incomplete
-            // handshake.
-            approvals.Create(channel.value());
-            mailboxes.Create(channel.value());
-            std::cout << "accept_handler: new channel " << (int)channel.value()
-                      << std::endl;
+                // Register the channel's approval state and outbound mailbox
+                // before its reader can run, so the guacamole_send thread can
+                // always route to it. The CREATE (approval request) is sent
+                // later, once the forged handshake is done — nothing crosses
+                // the bridge for an incomplete handshake.
+                table.Open(channel.value());
+                std::cout << "accept_handler: new channel " << (int)channel.value()
+                          << std::endl;
 
-            // Hand the connection to its own reader thread and detach it, so the
-            // accept loop can keep accepting connections. The reader's thread
-            // body captures only the shared refs (not the handler), so the
-            // temporary handler going out of scope here is safe. Count the reader
-            // in before launching it (this thread is joined on shutdown before
-            // WaitAll runs, so the count is final by then).
-            readers.Enter();
-            GuacamoleReadHandler reader;
-            reader.Run(queue, recv_queue, guacamole_server, table, approvals, mailboxes, readers, channel.value(), fd)
-                .detach();
+                // Hand the connection to its own reader thread and detach it,
+                // so the accept loop can keep accepting connections. The
+                // reader's thread body captures only the shared refs (not the
+                // handler), so the temporary handler going out of scope here is
+                // safe. Count the reader in before launching it (this thread is
+                // joined on shutdown before WaitAll runs, so the count is final
+                // by then). Its return-path messages (faked acks) go to the
+                // router shard its channel maps to, in order with the bridge
+                // traffic for that channel.
+                readers.Enter();
+                GuacamoleReadHandler reader;
+                reader.Run(queue, recv_queues.For(channel.value()),
+                           guacamole_server, table, readers,
+                           timers, channel.value(), fd)
+                    .detach();
+            }
         }
     });
 }
@@ -20,15 +20,14 @@
 
 #include "../../include/nethandlers/guacamole_read_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
+#include "../../../shared/include/parser/instruction_pipeline.h"
 #include "../../include/clipboard_ack_faker.h"
 #include "../../include/forward_keepalive_filter.h"
 #include "../../include/handshake_forger.h"
-#include "../../include/running.h"
-#include <atomic>
+#include "../../../shared/include/util/running.h"
 #include <cerrno>
 #include <chrono>
 #include <iostream>
-#include <memory>
 #include <poll.h>
 #include <random>
 #include <string>
@@ -38,7 +37,7 @@ namespace {
 
 // Heartbeat interval that keeps a forged session alive; the Guacamole session
 // times out without a periodic sync.
-constexpr int SYNC_INTERVAL_MS = 1000;
+constexpr std::chrono::milliseconds SYNC_INTERVAL(1000);
 
 /*
  * @brief A unique, inert connection-request identifier (12 hex chars).
@@ -99,7 +98,9 @@ void replay_handshake(NetQueue &send_queue, uint16_t channel,
  * forwards no Guacamole bytes across the bridge until the connection is
  * approved. Once the forged handshake is established it sends an inert CREATE
  * (carrying a unique request id) as the approval request, and keeps the waiting
- * screen alive with a periodic sync. Only after the matching APPROVAL verdict
+ * screen alive with a sync the timer wheel posts to its mailbox every second,
+ * so an idle reader sleeps until there is work. Only after the matching
+ * APPROVAL verdict
  * does it replay the captured handshake and pipe browser input across the bridge
  * (guacd's own sync then drives the keepalive). On close it removes the channel;
  * if it was first to remove it, it announces SHUTDOWN. The reader is the sole
@@ -107,10 +108,9 @@ void replay_handshake(NetQueue &send_queue, uint16_t channel,
  */
 std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
                                 GuacamoleServer &guacamole_server,
-                                ChannelTable &table, ApprovalRegistry &approvals,
-                                MailboxRegistry &mailboxes, ReaderGroup &readers,
-                                uint16_t channel, int fd) {
-    return std::thread([&queue, &recv_queue, &guacamole_server, &table, &approvals, &mailboxes, &readers, channel, fd]() {
+                                ChannelRegistry &table, ReaderGroup &readers,
+                                TimerWheel &timers, uint16_t channel, int fd) {
+    return std::thread([&queue, &recv_queue, &guacamole_server, &table, &readers, &timers, channel, fd]() {
         // Declared first so it is destroyed last: Leave() runs only after all
         // shared-state access below is done, letting main's WaitAll() proceed.
         ReaderGroup::Sentinel sentinel(readers);
@@ -119,31 +119,55 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
         HandshakeForger forger; // forges the guacd handshake toward the web server
         ForwardKeepaliveFilter keepalive_filter; // swallows the browser's sync/nop keepalives
         ClipboardAckFaker clipboard_faker; // fakes acks for guard-dropped clipboard blobs
-        std::shared_ptr<std::atomic<bool>> approved = approvals.Flag(channel);
-        std::shared_ptr<ChannelMailbox> mailbox = mailboxes.Get(channel);
+        // Frames browser input once for both forward filters.
+        InstructionPipeline<ClipboardAckFaker, ForwardKeepaliveFilter> forward(
+            clipboard_faker, keepalive_filter);
+        // Owned by this reader until its Release() below; no epoch guard needed.
+        ChannelMailbox *mailbox = table.Mailbox(channel);
         bool replayed = false;
         // Whether to announce SHUTDOWN to the peer on close. Stays true for any
         // locally-initiated teardown (client close, error, denial); flipped off
         // only when the peer's own SHUTDOWN drove the teardown (no echo).
         bool announce = true;
+        // Waiting-screen heartbeat, armed once the forged handshake is up and
+        // cancelled on approval; 0 while none is armed.
+        TimerWheel::TimerId heartbeat = 0;
+        auto stop_heartbeat = [&]() {
+            if (heartbeat)
+                timers.Cancel(heartbeat);
+            heartbeat = 0;
+        };
 
         // Once approved, replay the captured handshake across the bridge exactly
-        // once. The guard validates it en route; gcdbroker forwards it to guacd.
+        // once, within the protocol's bandwidth profile if one is set. The
+        // guard validates it en route; gcdbroker forwards it to guacd.
         auto maybe_replay = [&]() {
             if (!replayed &&
                 forger.GetHandshakeState() == HandshakeState::ESTABLISHED &&
-                approved && approved->load()) {
-                replay_handshake(queue, channel, forger.Handshake());
+                table.IsApproved(channel)) {
+                const BandwidthProfile *profile =
+                    bandwidth_policy().For(forger.Protocol());
+                if (profile)
+                    std::cout << "guacamole_reader: channel " << (int)channel
+                              << " using bandwidth profile '" << profile->name
+                              << "'" << std::endl;
+                replay_handshake(queue, channel,
+                                 profile ? forger.Handshake(*profile)
+                                         : forger.Handshake());
                 replayed = true;
+                table.MarkSetup(channel, SetupPhase::REPLAYED);
+                // guacd's own sync drives the keepalive from here on.
+                stop_heartbeat();
             }
         };
 
         while (running) {
             // Poll the socket and the mailbox together: the socket carries
             // browser input, the mailbox carries return traffic / teardown
-            // requests from the guacamole_send thread. A timeout lets us emit a
-            // heartbeat (4.sync,...;) even when both are idle. All socket writes
-            // happen here, on this one thread.
+            // requests from the guacamole_send thread and the waiting-screen
+            // heartbeat from the timer wheel. Nothing else needs a wakeup, so
+            // there is no timeout. All socket writes happen here, on this one
+            // thread.
             // Under TLS, OpenSSL may hold a fully-buffered record the socket
             // poll won't report, so don't block when there's pending plaintext.
             bool ssl_pending = guacamole_server.HasPending(fd);
@@ -156,7 +180,7 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
             pfds[1].events = POLLIN;
             pfds[1].revents = 0;
 
-            int ready = ::poll(pfds, 2, ssl_pending ? 0 : SYNC_INTERVAL_MS);
+            int ready = ::poll(pfds, 2, ssl_pending ? 0 : -1);
             if (ready < 0) {
                 if (errno == EINTR)
                     continue;
@@ -165,43 +189,33 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
             }
 
             // Outbound: drain return traffic the send thread handed us, writing
-            // it to the browser ourselves, and honour a teardown request.
+            // it to the browser ourselves, and honour a teardown request. The
+            // send thread also wakes us the moment the channel is approved, so
+            // the handshake is replayed at once rather than on the next idle
+            // timeout or browser input.
             if (mailbox && (pfds[1].revents & POLLIN)) {
                 std::vector<std::string> chunks;
                 bool teardown = false, do_announce = true;
                 mailbox->Drain(chunks, teardown, do_announce);
-                bool write_failed = false;
-                for (const std::string &chunk : chunks) {
-                    if (guacamole_server.Send(fd, chunk.data(), chunk.size()) < 0) {
-                        write_failed = true;
-                        break;
-                    }
-                }
+                // Flush the whole drain at once (writev / full TLS records)
+                // rather than one send per bridge payload.
+                bool write_failed =
+                    !chunks.empty() &&
+                    guacamole_server.SendChunks(fd, chunks) < 0;
                 if (teardown) {
                     announce = do_announce;
                     break;
                 }
                 if (write_failed)
                     break; // announce stays true: tell the peer the browser died
+                maybe_replay();
             }
 
             // Readable if the socket signalled or TLS has a buffered record.
             bool readable =
                 (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) || ssl_pending;
-            if (!readable) {
-                // Genuine idle timeout (no socket event, nothing buffered).
-                if (ready == 0) {
-                    // Keep the waiting screen alive only until approval;
-                    // afterwards guacd's own sync drives the keepalive.
-                    if (forger.GetHandshakeState() == HandshakeState::ESTABLISHED &&
-                        !(approved && approved->load())) {
-                        std::string s = sync_instruction();
-                        guacamole_server.Send(fd, s.data(), s.size());
-                    }
-                    maybe_replay();
-                }
+            if (!readable)
                 continue;
-            }
 
             // There is data waiting from the browser
             int received = guacamole_server.Receive(fd, buffer, sizeof(buffer));
@@ -230,13 +244,25 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
                 // inert CREATE carrying a unique id — no Guacamole traffic
                 // crosses yet.
                 if (forger.GetHandshakeState() == HandshakeState::ESTABLISHED) {
+                    table.MarkSetup(channel, SetupPhase::HANDSHAKE);
                     std::string req_id = make_request_id();
-                    approvals.SetRequestId(channel, req_id);
+                    table.SetRequestId(channel, req_id);
                     BridgeMessage create;
                     create.channel = channel;
                     create.action = ChannelAction::CREATE_CHANNEL;
                     create.payload = req_id;
                     queue.Enqueue(std::move(create));
+                    table.MarkSetup(channel, SetupPhase::CREATE_SENT);
+                    // Keep the waiting screen alive until approval. The mailbox
+                    // outlives the timer: it is cancelled before Release().
+                    if (mailbox)
+                        heartbeat = timers.Arm(
+                            SYNC_INTERVAL,
+                            [&table, mailbox, channel]() {
+                                if (!table.IsApproved(channel))
+                                    mailbox->Post(sync_instruction());
+                            },
+                            SYNC_INTERVAL);
                     std::cout << "guacamole_reader: channel " << (int)channel
                               << " requesting approval"
                               << std::endl;
@@ -249,20 +275,19 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
             // dropped.
             maybe_replay();
             if (replayed) {
-                // For a clipboard paste the guard will drop (payload over the
-                // cap), fake the success ack back to the browser so its clipboard
-                // stream doesn't stall waiting for guacd. Read the original bytes
-                // before the keepalive filter rewrites the buffer.
-                std::string acks = clipboard_faker.Feed(buffer, received);
+                // One framing pass: swallow the browser's keepalives (sync/nop)
+                // so they never cross the bridge (the guard validates the rest),
+                // and for a clipboard paste the guard will drop (payload over the
+                // cap) fake the success ack back to the browser so its clipboard
+                // stream doesn't stall waiting for guacd.
+                size_t len = static_cast<size_t>(received);
+                forward.Run(buffer, len);
+                std::string acks = clipboard_faker.TakeAcks();
                 if (!acks.empty()) {
                     BridgeMessage ack{channel, ChannelAction::NONE, std::move(acks)};
                     recv_queue.Enqueue(std::move(ack));
                 }
 
-                // Swallow the browser's keepalives (sync/nop) here so they never
-                // cross the bridge; the guard validates the rest.
-                size_t len = static_cast<size_t>(received);
-                keepalive_filter.Filter(buffer, len);
                 if (len > 0) {
                     BridgeMessage msg;
                     msg.channel = channel;
@@ -273,9 +298,8 @@ std::thread GuacamoleReadHandler::Run(NetQueue &queue, NetQueue &recv_queue,
             }
         }
 
-        approvals.Remove(channel);
-        mailboxes.Remove(channel);
-        table.Remove(channel);
+        stop_heartbeat();
+        table.Release(channel);
 
         // The reader is the only thread that removes the channel, so `announce`
         // alone decides whether to notify the peer: true for a locally-initiated
@@ -22,7 +22,7 @@
 #include "../../../shared/include/network/multiplexer.h"
 #include "../../include/handshake_forger.h"
 #include "../../include/return_filter.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include <iostream>
 #include <optional>
 #include <string>
@@ -35,10 +35,17 @@
  * I/O. Return traffic and teardown requests are handed to the channel's
  * ChannelMailbox, which wakes the reader to do the actual write/close on its
  * own thread.
+ *
+ * Routing takes no locks: mailbox and approval lookups are atomic loads from the
+ * flat ChannelRegistry. Each message is handled inside an epoch guard, so a
+ * reader releasing its channel concurrently waits before freeing the mailbox.
+ *
+ * One of these runs per RouterQueues shard. A channel always maps to the same
+ * shard, so its return filter lives in that thread's `filters` only.
  */
-std::thread GuacamoleSendHandler::Run(NetQueue &queue, MailboxRegistry &mailboxes,
-                                ApprovalRegistry &approvals) {
-    return std::thread([&queue, &mailboxes, &approvals]() {
+std::thread GuacamoleSendHandler::Run(NetQueue &queue, ChannelRegistry &table) {
+    return std::thread([&queue, &table]() {
+        const int router = table.RegisterRouter();
         // Per-channel return-path filter that swallows guacd's real args/ready.
         std::unordered_map<uint16_t, ReturnFilter> filters;
 
@@ -47,13 +54,16 @@ std::thread GuacamoleSendHandler::Run(NetQueue &queue, MailboxRegistry &mailboxe
             if (!opt)
                 break; // queue closed and drained: shutting down
             BridgeMessage msg = std::move(*opt);
+            // Not held while blocked in Dequeue(), so an idle router never
+            // delays a channel's teardown.
+            EpochDomain::Guard guard(table.Epoch(), router);
 
             switch (msg.action) {
             case ChannelAction::SHUTDOWN_CHANNEL: {
                 filters.erase(msg.channel);
                 // Ask the reader to tear down without re-announcing: the peer
                 // initiated this SHUTDOWN, so echoing it back would loop.
-                if (auto mailbox = mailboxes.Get(msg.channel)) {
+                if (ChannelMailbox *mailbox = table.Mailbox(msg.channel)) {
                     mailbox->RequestTeardown(/*announce=*/false);
                     std::cout << "guacamole_send_handler: received channel "
                               << (int)msg.channel << " SHUTDOWN from peer"
@@ -72,29 +82,34 @@ std::thread GuacamoleSendHandler::Run(NetQueue &queue, MailboxRegistry &mailboxe
                 if (verdict == APPROVAL_APPROVE) {
                     // Match the verdict to the outstanding request before acting,
                     // so a stale verdict can't approve a reused channel.
-                    if (!approvals.Approve(msg.channel, id)) {
+                    if (!table.Approve(msg.channel, id)) {
                         std::cerr << "guacamole_send_handler: channel "
                                   << (int)msg.channel
                                   << " ignoring unmatched approval" << std::endl;
                         break;
                     }
+                    table.MarkSetup(msg.channel, SetupPhase::VERDICT);
                     // The reader will replay the handshake and pipe input; arm
-                    // the return filter to swallow guacd's real args/ready.
+                    // the return filter to swallow guacd's real args/ready, then
+                    // wake the reader so it replays now.
                     filters[msg.channel] = ReturnFilter{};
+                    if (ChannelMailbox *mailbox = table.Mailbox(msg.channel))
+                        mailbox->Wake();
                     std::cout << "guacamole_send_handler: channel " << (int)msg.channel
                               << " APPROVED" << std::endl;
                 } else {
-                    if (!approvals.Matches(msg.channel, id)) {
+                    if (!table.Matches(msg.channel, id)) {
                         std::cerr << "guacamole_send_handler: channel "
                                   << (int)msg.channel
                                   << " ignoring unmatched denial" << std::endl;
                         break;
                     }
+                    table.MarkSetup(msg.channel, SetupPhase::VERDICT);
                     std::cout << "guacamole_send_handler: channel " << (int)msg.channel
                               << " DENIED" << std::endl;
                     // Paint the denied screen, then have the reader tear down and
                     // announce SHUTDOWN to the peer.
-                    if (auto mailbox = mailboxes.Get(msg.channel)) {
+                    if (ChannelMailbox *mailbox = table.Mailbox(msg.channel)) {
                         mailbox->Post(HandshakeForger::DeniedScreen());
                         mailbox->RequestTeardown(/*announce=*/true);
                     }
@@ -103,7 +118,7 @@ std::thread GuacamoleSendHandler::Run(NetQueue &queue, MailboxRegistry &mailboxe
             }
             case ChannelAction::NONE:
             default: {
-                auto mailbox = mailboxes.Get(msg.channel);
+                ChannelMailbox *mailbox = table.Mailbox(msg.channel);
                 if (!mailbox) {
                     std::cerr << "guacamole_send_handler: no socket for channel "
                               << (int)msg.channel << ", dropping "
@@ -114,6 +129,9 @@ std::thread GuacamoleSendHandler::Run(NetQueue &queue, MailboxRegistry &mailboxe
                 // server. By default the payload is forwarded as-is (no copy);
                 // a new string is only materialized when a return filter is
                 // active and actually rewrites it.
+                // guacd's first frame ends the channel's setup, even when it is
+                // the args reply the filter swallows.
+                table.MarkSetup(msg.channel, SetupPhase::FIRST_FRAME);
                 const std::string *out = &msg.payload;
                 std::string filtered;
                 auto fit = filters.find(msg.channel);
@@ -20,14 +20,16 @@
 
 #include "../../include/nethandlers/udp_recv_handler.h"
 #include "../../../shared/include/network/multiplexer.h"
-#include "../../include/running.h"
+#include "../../../shared/include/util/running.h"
 #include <iostream>
 
 /*
- * @brief Receives datagrams from the bridge and queues the parsed messages
+ * @brief Receives datagrams from the bridge and queues the parsed messages on
+ * their channel's router shard
  */
-std::thread UDPRecvHandler::Run(NetQueue &queue, UDPReceiver &udp_receiver) {
-    return std::thread([&queue, &udp_receiver]() {
+std::thread UDPRecvHandler::Run(RouterQueues &queues,
+                                BridgeReceiver &udp_receiver) {
+    return std::thread([&queues, &udp_receiver]() {
         // + 1 for null byte - c-style strings
         char buffer[Multiplexer::MAX_DATAGRAM_SIZE + 1];
 
@@ -43,7 +45,7 @@ std::thread UDPRecvHandler::Run(NetQueue &queue, UDPReceiver &udp_receiver) {
                 continue;
             }
 
-            queue.Enqueue(std::move(msg));
+            queues.Enqueue(std::move(msg));
         }
     });
 }
@@ -33,14 +33,16 @@ std::string ReturnFilter::Feed(const char *data, size_t len) {
 }
 
 bool ReturnFilter::OnInstructionBegin(const GuacElement &instr) {
-    current_opcode.assign(instr.ptr, instr.len);
+    is_ready = instr.View() == "ready";
     return true;
 }
 
 bool ReturnFilter::OnInstructionEnd() {
-    if (!piping && current_opcode == "ready") {
+    if (!piping && is_ready) {
         piping = true;
         ready_end = CurrentIndex() + 1; // first byte after ready's ';'
     }
     return true;
 }
+
+template class OpcodeParserCore<ReturnFilter>;
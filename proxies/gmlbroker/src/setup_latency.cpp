@@ -0,0 +1,124 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/setup_latency.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+constexpr size_t PHASES = static_cast<size_t>(SetupPhase::COUNT);
+
+int64_t now_micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+const char *setup_phase_name(SetupPhase phase) {
+    switch (phase) {
+    case SetupPhase::ACCEPTED:
+        return "accepted";
+    case SetupPhase::HANDSHAKE:
+        return "handshake";
+    case SetupPhase::CREATE_SENT:
+        return "create";
+    case SetupPhase::VERDICT:
+        return "verdict";
+    case SetupPhase::REPLAYED:
+        return "replay";
+    case SetupPhase::FIRST_FRAME:
+    default:
+        return "first_frame";
+    }
+}
+
+void SetupLatency::Begin(SetupTimeline &timeline) {
+    for (size_t p = 1; p < PHASES; ++p)
+        timeline.at[p].store(0);
+    timeline.at[0].store(now_micros());
+}
+
+bool SetupLatency::Mark(SetupTimeline &timeline, uint16_t channel,
+                        SetupPhase phase) {
+    size_t p = static_cast<size_t>(phase);
+    if (p == 0 || p >= PHASES)
+        return false;
+    int64_t prev = timeline.at[p - 1].load();
+    if (prev == 0)
+        return false; // the phase before it was never reached
+    int64_t now = now_micros();
+    int64_t expected = 0;
+    if (!timeline.at[p].compare_exchange_strong(expected, now))
+        return false; // already stamped
+    phases[p].Record(static_cast<uint64_t>(now > prev ? now - prev : 0));
+
+    if (phase == SetupPhase::FIRST_FRAME) {
+        int64_t start = timeline.at[0].load();
+        total.Record(static_cast<uint64_t>(now > start ? now - start : 0));
+        std::ostringstream line;
+        line << "gmlbroker: channel " << (int)channel << " setup "
+             << (now - start) << "us:";
+        for (size_t q = 1; q < PHASES; ++q)
+            line << " " << setup_phase_name(static_cast<SetupPhase>(q)) << "="
+                 << (timeline.at[q].load() - timeline.at[q - 1].load()) << "us";
+        std::cout << line.str() << std::endl;
+    }
+    return true;
+}
+
+void SetupLatency::Report(const char *tag) const {
+    for (size_t p = 1; p < PHASES; ++p) {
+        if (phases[p].Count() == 0)
+            continue;
+        std::cout << tag << " setup "
+                  << setup_phase_name(static_cast<SetupPhase>(p)) << ": "
+                  << phases[p].Summary() << std::endl;
+    }
+    if (total.Count() > 0)
+        std::cout << tag << " setup total: " << total.Summary() << std::endl;
+}
+
+std::thread StartSetupReporter(const SetupLatency &latency,
+                               const std::atomic<bool> &running,
+                               const char *tag) {
+    const char *env = std::getenv("SETUP_STATS_MS");
+    int interval = env ? std::atoi(env) : 0;
+    if (interval <= 0)
+        return std::thread(); // disabled: no-op thread
+
+    return std::thread([&latency, &running, tag, interval]() {
+        int elapsed = 0;
+        while (running.load()) {
+            // Sleep in small steps so shutdown stays responsive regardless of
+            // the chosen interval.
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            elapsed += 200;
+            if (elapsed >= interval) {
+                latency.Report(tag);
+                elapsed = 0;
+            }
+        }
+    });
+}
@@ -0,0 +1,162 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../shared/include/network/guacamole_server.h"
+#include "../../shared/include/util/latency_histogram.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/*
+ * Accept-path benchmark for GuacamoleServer; run it with
+ * `meson test --benchmark`.
+ *
+ * Client threads open ACCEPT_BENCH_CONNS connections (default 4000) as fast as
+ * they can, each sending its connect timestamp as the first 8 bytes, the way
+ * the web server speaks first. The accept threads take them with AcceptBatch()
+ * and record connect-to-accept latency. Reported once with a single listener
+ * and once with ACCEPT_BENCH_SHARDS SO_REUSEPORT listeners (default 4).
+ * GMLBROKER_LISTEN_BACKLOG and GMLBROKER_DEFER_ACCEPT apply as in production.
+ */
+
+namespace {
+
+int env_int(const char *name, int fallback) {
+    const char *env = std::getenv(name);
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : fallback;
+}
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// A loopback port nothing listens on right now.
+int free_port() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+void run(int shards, int conns, int clients) {
+    setenv("GMLBROKER_ACCEPT_SHARDS", std::to_string(shards).c_str(), 1);
+    int port = free_port();
+    GuacamoleServer server("127.0.0.1", port);
+    assert(server.Initialize() == 0);
+
+    LatencyHistogram latency;
+    std::atomic<int> accepted{0};
+    std::atomic<int64_t> last_accept{0};
+    std::vector<std::thread> acceptors;
+    for (size_t shard = 0; shard < server.Shards(); ++shard) {
+        acceptors.emplace_back([&, shard]() {
+            // Connections whose timestamp has not arrived yet, with the time
+            // they were accepted. Never read blocking here: that would stall
+            // the accept loop, which is what is being measured.
+            std::vector<std::pair<int, int64_t>> waiting;
+            std::vector<int> fds;
+            while (accepted.load() < conns || !waiting.empty()) {
+                fds.clear();
+                int wait_ms = waiting.empty() ? 50 : 0;
+                if (server.AcceptBatch(shard, fds, wait_ms) < 0)
+                    break;
+                int64_t at = now_us();
+                for (int fd : fds) {
+                    waiting.emplace_back(fd, at);
+                    last_accept.store(at);
+                    ++accepted;
+                }
+                for (size_t i = 0; i < waiting.size();) {
+                    int64_t sent = 0;
+                    ssize_t n = ::recv(waiting[i].first, &sent, sizeof(sent),
+                                       MSG_DONTWAIT | MSG_PEEK);
+                    if (n < 0 && errno == EAGAIN) {
+                        ++i;
+                        continue;
+                    }
+                    if (n == sizeof(sent))
+                        latency.Record(
+                            static_cast<uint64_t>(waiting[i].second - sent));
+                    server.Close(waiting[i].first);
+                    waiting[i] = waiting.back();
+                    waiting.pop_back();
+                }
+            }
+        });
+    }
+
+    int64_t start = now_us();
+    std::vector<std::thread> senders;
+    for (int c = 0; c < clients; ++c) {
+        senders.emplace_back([&, c]() {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            for (int i = c; i < conns; i += clients) {
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                int64_t at = now_us();
+                if (::connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                              sizeof(addr)) == 0)
+                    ::send(fd, &at, sizeof(at), 0);
+                ::close(fd);
+            }
+        });
+    }
+    for (std::thread &t : senders)
+        t.join();
+    for (std::thread &t : acceptors)
+        t.join();
+
+    double secs = (last_accept.load() - start) / 1e6;
+    std::cout << "accept: listeners=" << server.Shards() << " conns=" << conns
+              << " rate=" << static_cast<int64_t>(accepted.load() / secs)
+              << "/s latency " << latency.Summary() << std::endl;
+}
+
+} // namespace
+
+int main() {
+    int conns = env_int("ACCEPT_BENCH_CONNS", 4000);
+    int clients = env_int("ACCEPT_BENCH_CLIENTS", 8);
+    run(1, conns, clients);
+    run(env_int("ACCEPT_BENCH_SHARDS", 4), conns, clients);
+    return 0;
+}
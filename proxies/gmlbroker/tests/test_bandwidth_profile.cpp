@@ -0,0 +1,146 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/bandwidth_profile.h"
+#include <cassert>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Built-in names parse, overrides apply, anything else is refused
+ */
+void test_parse() {
+    std::optional<BandwidthProfile> full = BandwidthProfile::Parse("full");
+    assert(full && full->color_depth == 0 && !full->wallpaper);
+    assert(full->Describe() == "no caps");
+
+    std::optional<BandwidthProfile> p =
+        BandwidthProfile::Parse("low,color-depth=24,wallpaper=on,max-size="
+                                "1600x900,max-dpi=120,gfx=off");
+    assert(p);
+    assert(p->color_depth == 24);
+    assert(p->max_width == 1600 && p->max_height == 900 && p->max_dpi == 120);
+    assert(p->wallpaper == true && p->gfx == false);
+    assert(p->theming == false); // from `low`
+
+    assert(!BandwidthProfile::Parse(""));
+    assert(!BandwidthProfile::Parse("cheap"));
+    assert(!BandwidthProfile::Parse("low,color-depth=12"));
+    assert(!BandwidthProfile::Parse("low,max-size=1280"));
+    assert(!BandwidthProfile::Parse("low,wallpaper=maybe"));
+    assert(!BandwidthProfile::Parse("low,sound=off"));
+}
+
+/**
+ * @brief The display size is scaled into the cap with its aspect kept; DPI
+ * is capped; smaller displays are left alone
+ */
+void test_rewrite_size() {
+    BandwidthProfile p = *BandwidthProfile::Parse("minimal");
+    std::vector<std::string> size = {"1920", "1200", "192"};
+    p.RewriteSize(size);
+    assert(size[0] == "1024" && size[1] == "640" && size[2] == "96");
+
+    size = {"800", "600", "72"};
+    p.RewriteSize(size);
+    assert(size[0] == "800" && size[1] == "600" && size[2] == "72");
+}
+
+/**
+ * @brief Connect values are matched by name; an unset colour depth gets the
+ * cap, a lower one is kept
+ */
+void test_rewrite_connect() {
+    std::vector<std::string> names = {"VERSION_1_5_0", "hostname",
+                                      "color-depth", "width", "height",
+                                      "disable-gfx", "enable-theming"};
+    std::vector<std::string> values = {"VERSION_1_5_0", "desktop", "", "3840",
+                                       "2160", "", "true"};
+    BandwidthProfile minimal = *BandwidthProfile::Parse("minimal");
+    minimal.RewriteConnect(names, values);
+    assert(values[1] == "desktop");
+    assert(values[2] == "8");
+    assert(values[3] == "1024" && values[4] == "576");
+    assert(values[5] == "true");
+    assert(values[6] == "false");
+
+    values = {"VERSION_1_5_0", "desktop", "8", "", "", "", "true"};
+    BandwidthProfile balanced = *BandwidthProfile::Parse("balanced");
+    balanced.RewriteConnect(names, values);
+    assert(values[2] == "8");
+    assert(values[3].empty() && values[4].empty());
+    assert(values[6] == "true"); // `balanced` leaves theming as sent
+}
+
+/**
+ * @brief Each built-in profile is estimated cheaper than the one above it
+ */
+void test_estimates() {
+    double full = BandwidthProfile::Parse("full")->EstimatedKbps();
+    double balanced = BandwidthProfile::Parse("balanced")->EstimatedKbps();
+    double low = BandwidthProfile::Parse("low")->EstimatedKbps();
+    double minimal = BandwidthProfile::Parse("minimal")->EstimatedKbps();
+    assert(full > balanced && balanced > low && low > minimal && minimal > 0);
+
+    // Turning features on costs more.
+    double lush =
+        BandwidthProfile::Parse("full,wallpaper=on,font-smoothing=on")
+            ->EstimatedKbps();
+    assert(lush > full);
+}
+
+/**
+ * @brief A per-protocol profile overrides the deployment's one
+ */
+void test_policy() {
+    setenv("BANDWIDTH_PROFILE", "low", 1);
+    setenv("BANDWIDTH_PROFILE_SSH", "full", 1);
+    setenv("BANDWIDTH_PROFILE_VNC", "bogus", 1);
+    BandwidthPolicy policy = BandwidthPolicy::FromEnv();
+    assert(policy.For("rdp") && policy.For("rdp")->name == "low");
+    assert(policy.For("vnc") && policy.For("vnc")->name == "low");
+    assert(policy.For("ssh") && policy.For("ssh")->name == "full");
+
+    unsetenv("BANDWIDTH_PROFILE");
+    BandwidthPolicy partial = BandwidthPolicy::FromEnv();
+    assert(!partial.For("rdp"));
+    assert(partial.For("ssh"));
+    unsetenv("BANDWIDTH_PROFILE_SSH");
+    unsetenv("BANDWIDTH_PROFILE_VNC");
+}
+
+/**
+ * @brief Unit tests for the bandwidth profiles
+ */
+int main() {
+    test_parse();
+
+    test_rewrite_size();
+
+    test_rewrite_connect();
+
+    test_estimates();
+
+    test_policy();
+
+    return 0;
+}
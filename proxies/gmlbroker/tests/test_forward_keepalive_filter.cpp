@@ -23,11 +23,17 @@
 #include <iostream>
 #include <string>
 
+// A forward pipeline holding just the keepalive filter.
+struct KeepalivePipeline {
+    ForwardKeepaliveFilter filter;
+    InstructionPipeline<ForwardKeepaliveFilter> pipeline{filter};
+};
+
 // Run one chunk through the filter and return what would cross the bridge.
-static std::string filtered(ForwardKeepaliveFilter &f, const std::string &s) {
+static std::string filtered(KeepalivePipeline &f, const std::string &s) {
     std::string buf = s;
     size_t len = buf.size();
-    f.Filter(buf.data(), len);
+    f.pipeline.Run(buf.data(), len);
     return std::string(buf.data(), len);
 }
 
@@ -35,15 +41,15 @@ static std::string filtered(ForwardKeepaliveFilter &f, const std::string &s) {
  * @brief A standalone client sync or nop is swallowed entirely.
  */
 void test_keepalive_only() {
-    { ForwardKeepaliveFilter f; assert(filtered(f, "4.sync,7.1234567;") == ""); }
-    { ForwardKeepaliveFilter f; assert(filtered(f, "3.nop;") == ""); }
+    { KeepalivePipeline f; assert(filtered(f, "4.sync,7.1234567;") == ""); }
+    { KeepalivePipeline f; assert(filtered(f, "3.nop;") == ""); }
 }
 
 /*
  * @brief sync/nop mixed with input are removed; the input survives.
  */
 void test_keepalive_among_input() {
-    ForwardKeepaliveFilter f;
+    KeepalivePipeline f;
     assert(filtered(f,
         "3.key,3.109,1.1;4.sync,2.31;3.nop;5.mouse,3.988,3.369,1.0;") ==
         "3.key,3.109,1.1;5.mouse,3.988,3.369,1.0;");
@@ -53,7 +59,7 @@ void test_keepalive_among_input() {
  * @brief Non-keepalive input passes through untouched (the guard validates it).
  */
 void test_passthrough() {
-    ForwardKeepaliveFilter f;
+    KeepalivePipeline f;
     const std::string in = "5.mouse,3.988,3.369,1.0;3.key,3.109,1.1;";
     assert(filtered(f, in) == in);
 }
@@ -63,7 +69,7 @@ void test_passthrough() {
  * passed through (the guard judges it), never corrupting the stream.
  */
 void test_large_element_passthrough() {
-    ForwardKeepaliveFilter f;
+    KeepalivePipeline f;
     std::string big(20000, 'a');
     std::string in = "4.blob,1.0," + std::to_string(big.size()) + "." + big + ";";
     assert(filtered(f, in) == in);
@@ -76,7 +82,7 @@ void test_large_element_passthrough() {
  * filter resyncs so later chunks are handled again.
  */
 void test_fail_open_and_resync() {
-    ForwardKeepaliveFilter f;
+    KeepalivePipeline f;
     const std::string garbage = "not guacamole";
     assert(filtered(f, garbage) == garbage); // untouched
     // Resynced: a clean keepalive afterwards is swallowed again.
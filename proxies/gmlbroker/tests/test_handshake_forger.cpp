@@ -18,11 +18,13 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-#include "../../include/handshake_forger.h"
-#include "../../../shared/include/parser/opcode_parser.h"
+#include "../include/handshake_forger.h"
+#include "../../shared/include/parser/opcode_parser.h"
 #include <cassert>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <vector>
 
 // TODO: put the test/ directory in the same directory as src/
 
@@ -106,10 +108,108 @@ void test_partial_select_across_feeds() {
     assert(contains(o2, "4.args,"));
 }
 
+// Encodes one instruction; lengths count code points.
+static std::string encode(const std::vector<std::string> &elems) {
+    std::string s;
+    for (size_t i = 0; i < elems.size(); ++i) {
+        size_t len = 0;
+        for (unsigned char c : elems[i])
+            len += (c & 0xC0) != 0x80;
+        s += std::to_string(len) + "." + elems[i];
+        s += (i + 1 < elems.size()) ? ',' : ';';
+    }
+    return s;
+}
+
+// The elements of the first instruction in s (ASCII only).
+static std::vector<std::string> decode(const std::string &s) {
+    std::vector<std::string> elems;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t dot = s.find('.', pos);
+        size_t len = std::stoul(s.substr(pos, dot - pos));
+        elems.push_back(s.substr(dot + 1, len));
+        if (s[dot + 1 + len] == ';')
+            break;
+        pos = dot + 1 + len + 1;
+    }
+    return elems;
+}
+
+/**
+ * @brief A bandwidth profile rewrites `size` and `connect` in the replayed
+ * handshake, and leaves every other byte as captured
+ */
+void test_bandwidth_profile_rewrite() {
+    HandshakeForger f;
+    std::vector<std::string> names = decode(f.Feed("6.select,3.rdp;", 15));
+    names.erase(names.begin()); // "args"
+
+    // One value per arg, as the browser sends them.
+    std::vector<std::string> connect(names.size());
+    auto at = [&](const std::string &name) -> std::string & {
+        for (size_t i = 0; i < names.size(); ++i)
+            if (names[i] == name)
+                return connect[i];
+        assert(false);
+        return connect[0];
+    };
+    connect[0] = "VERSION_1_5_0";
+    at("hostname") = "desktop";
+    const std::string password = "p\xc3\xa4ss\xe2\x82\xac"; // multi-byte
+    at("password") = password;
+    at("color-depth") = "32";
+    at("dpi") = "144";
+    at("enable-wallpaper") = "true";
+    at("resize-method") = "display-update";
+    connect.insert(connect.begin(), "connect");
+
+    std::string rest = "4.size,4.2560,4.1440,3.144;5.audio,9.audio/L16;" +
+                       encode(connect) + "5.mouse,1.1,1.1,1.0;";
+    f.Feed(rest.data(), rest.size());
+    assert(f.GetHandshakeState() == HandshakeState::ESTABLISHED);
+
+    std::optional<BandwidthProfile> low = BandwidthProfile::Parse("low");
+    assert(low);
+    std::string replay = f.Handshake(*low);
+    assert(well_formed(replay));
+    assert(contains(replay, "4.size,4.1280,3.720,2.96;"));
+    assert(contains(replay, "5.audio,9.audio/L16;"));
+    // Input that followed connect in the same read is kept, after it.
+    assert(replay.size() > 20 &&
+           replay.substr(replay.size() - 20) == "5.mouse,1.1,1.1,1.0;");
+
+    // Parsed back, connect carries the capped values and the rest unchanged.
+    HandshakeForger g;
+    g.Feed(replay.data(), replay.size());
+    assert(g.GetHandshakeState() == HandshakeState::ESTABLISHED);
+    const std::vector<std::string> &values = g.ConnectValues();
+    assert(values.size() == names.size());
+    auto value = [&](const std::string &name) {
+        for (size_t i = 0; i < names.size(); ++i)
+            if (names[i] == name)
+                return values[i];
+        assert(false);
+        return std::string();
+    };
+    assert(value("hostname") == "desktop");
+    assert(value("password") == password);
+    assert(value("color-depth") == "16");
+    assert(value("dpi") == "96");
+    assert(value("enable-wallpaper") == "false");
+    assert(value("enable-menu-animations") == "false");
+    assert(value("resize-method").empty());
+    assert(value("disable-gfx").empty()); // `low` leaves GFX as sent
+
+    // The unprofiled replay is still the verbatim capture.
+    assert(f.Handshake() == "6.select,3.rdp;" + rest);
+}
+
 int main() {
     test_select_triggers_args();
     test_connect_triggers_ready_and_screen();
     test_partial_select_across_feeds();
+    test_bandwidth_profile_rewrite();
 
     std::cout << "handshake_forger: all tests passed" << std::endl;
     return 0;
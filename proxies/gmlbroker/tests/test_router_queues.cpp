@@ -0,0 +1,101 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/router_queues.h"
+#include <cassert>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+BridgeMessage message(uint16_t channel, ChannelAction action,
+                      const std::string &payload) {
+    BridgeMessage msg;
+    msg.channel = channel;
+    msg.action = action;
+    msg.payload = payload;
+    return msg;
+}
+
+} // namespace
+
+/**
+ * @brief A channel always lands on one shard, with its control frames in
+ * order among its data
+ */
+void test_per_channel_order() {
+    RouterQueues queues(4);
+    assert(queues.Shards() == 4);
+
+    queues.Enqueue(message(5, ChannelAction::APPROVAL, "1aaaaaaaaaaaa"));
+    queues.Enqueue(message(6, ChannelAction::NONE, "other"));
+    queues.Enqueue(message(5, ChannelAction::NONE, "first"));
+    queues.For(5).Enqueue(message(5, ChannelAction::NONE, "ack"));
+    queues.Enqueue(message(5, ChannelAction::SHUTDOWN_CHANNEL, ""));
+    queues.Close();
+
+    NetQueue &shard = queues.For(5);
+    assert(&shard == &queues.Shard(5 % 4));
+    assert(&queues.For(9) == &shard && &queues.For(6) != &shard);
+
+    std::vector<BridgeMessage> got;
+    while (std::optional<BridgeMessage> msg = shard.Dequeue())
+        got.push_back(std::move(*msg));
+    assert(got.size() == 4);
+    assert(got[0].action == ChannelAction::APPROVAL);
+    assert(got[1].payload == "first");
+    assert(got[2].payload == "ack");
+    assert(got[3].action == ChannelAction::SHUTDOWN_CHANNEL);
+
+    // Close() reached every shard: the other channel's drains, then ends.
+    std::optional<BridgeMessage> other = queues.For(6).Dequeue();
+    assert(other && other->payload == "other");
+    assert(!queues.For(6).Dequeue());
+    assert(!queues.Shard(3).Dequeue());
+}
+
+/**
+ * @brief The shard count comes from GMLBROKER_ROUTER_SHARDS, within bounds
+ */
+void test_shard_count() {
+    unsetenv("GMLBROKER_ROUTER_SHARDS");
+    assert(router_shards() == 1);
+    setenv("GMLBROKER_ROUTER_SHARDS", "4", 1);
+    assert(router_shards() == 4);
+    setenv("GMLBROKER_ROUTER_SHARDS", "1000", 1);
+    assert(router_shards() == 16);
+    setenv("GMLBROKER_ROUTER_SHARDS", "0", 1);
+    assert(router_shards() == 1);
+
+    assert(RouterQueues(0).Shards() == 1);
+}
+
+/**
+ * @brief Unit tests for the return path's router queues
+ */
+int main() {
+    test_per_channel_order();
+
+    test_shard_count();
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/setup_latency.h"
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief Histogram buckets are powers of two; quantiles report bucket bounds
+ */
+void test_histogram() {
+    LatencyHistogram h;
+    assert(h.Count() == 0 && h.Quantile(0.5) == 0);
+    for (int i = 0; i < 90; ++i)
+        h.Record(100); // bucket [64, 128)
+    for (int i = 0; i < 10; ++i)
+        h.Record(5000); // bucket [4096, 8192)
+    h.Record(0);
+    assert(h.Count() == 101);
+    assert(h.Quantile(0.5) == 128);
+    assert(h.Quantile(0.99) == 8192);
+    assert(h.Max() == 5000);
+}
+
+/**
+ * @brief Phases are stamped once each, and only in order
+ */
+void test_phases_in_order() {
+    SetupLatency latency;
+    SetupTimeline timeline;
+
+    // Nothing before the channel is accepted.
+    assert(!latency.Mark(timeline, 1, SetupPhase::HANDSHAKE));
+
+    latency.Begin(timeline);
+    assert(SetupLatency::Reached(timeline, SetupPhase::ACCEPTED));
+    // A phase cannot skip the one before it...
+    assert(!latency.Mark(timeline, 1, SetupPhase::VERDICT));
+    assert(latency.Mark(timeline, 1, SetupPhase::HANDSHAKE));
+    // ...nor be stamped twice.
+    assert(!latency.Mark(timeline, 1, SetupPhase::HANDSHAKE));
+    assert(latency.Mark(timeline, 1, SetupPhase::CREATE_SENT));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    assert(latency.Mark(timeline, 1, SetupPhase::VERDICT));
+    assert(latency.Mark(timeline, 1, SetupPhase::REPLAYED));
+    assert(latency.Mark(timeline, 1, SetupPhase::FIRST_FRAME));
+    assert(SetupLatency::Reached(timeline, SetupPhase::FIRST_FRAME));
+
+    // A reused channel starts over.
+    latency.Begin(timeline);
+    assert(!SetupLatency::Reached(timeline, SetupPhase::HANDSHAKE));
+    assert(latency.Mark(timeline, 1, SetupPhase::HANDSHAKE));
+}
+
+/**
+ * @brief Unit tests for connection-setup latency tracking
+ */
+int main() {
+    test_histogram();
+
+    test_phases_in_order();
+
+    return 0;
+}
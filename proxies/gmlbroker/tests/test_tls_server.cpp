@@ -0,0 +1,314 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../shared/include/network/guacamole_server.h"
+#include <arpa/inet.h>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// A loopback port nothing listens on right now.
+int free_port() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+// Writes a fresh self-signed certificate and key into @p dir and points
+// GMLBROKER_TLS_CERT/_KEY at them.
+void make_cert(const std::string &dir) {
+    EVP_PKEY *pkey = EVP_RSA_gen(2048);
+    assert(pkey);
+    X509 *x509 = X509_new();
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME *name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>(
+                                   "gmlbroker-test"),
+                               -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    assert(X509_sign(x509, pkey, EVP_sha256()) > 0);
+
+    std::string cert = dir + "/cert.pem";
+    std::string key = dir + "/key.pem";
+    FILE *f = std::fopen(cert.c_str(), "w");
+    assert(f && PEM_write_X509(f, x509) == 1);
+    std::fclose(f);
+    f = std::fopen(key.c_str(), "w");
+    assert(f && PEM_write_PrivateKey(f, pkey, nullptr, nullptr, 0, nullptr,
+                                     nullptr) == 1);
+    std::fclose(f);
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+
+    setenv("GMLBROKER_TLS_CERT", cert.c_str(), 1);
+    setenv("GMLBROKER_TLS_KEY", key.c_str(), 1);
+}
+
+// How the test client connects: TLS 1.3 with tickets by default, or TLS 1.2
+// with the given cipher list and/or without tickets (session ids only).
+struct ClientOptions {
+    const char *tls12_ciphers = nullptr;
+    bool tls12 = false;
+    bool no_tickets = false;
+};
+
+struct ClientResult {
+    SSL_SESSION *session = nullptr; // to resume from; caller frees
+    bool reused = false;
+    std::string reply;
+};
+
+// One connection: handshake (resuming @p resume if given), "ping", read the
+// reply, close.
+ClientResult run_client(int port, const ClientOptions &opts,
+                        SSL_SESSION *resume) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    assert(ctx);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr); // self-signed
+    if (opts.tls12 || opts.tls12_ciphers)
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    if (opts.tls12_ciphers)
+        assert(SSL_CTX_set_cipher_list(ctx, opts.tls12_ciphers) == 1);
+    if (opts.no_tickets)
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    assert(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+           0);
+
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (resume)
+        SSL_set_session(ssl, resume);
+    assert(SSL_connect(ssl) == 1);
+    assert(SSL_write(ssl, "ping", 4) == 4);
+    char buf[64];
+    int n = SSL_read(ssl, buf, sizeof(buf));
+    assert(n > 0);
+
+    ClientResult result;
+    result.reply.assign(buf, static_cast<size_t>(n));
+    result.reused = SSL_session_reused(ssl) == 1;
+    // Read after the reply, so a TLS 1.3 ticket has arrived by now.
+    result.session = SSL_get1_session(ssl);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    ::close(fd);
+    SSL_CTX_free(ctx);
+    return result;
+}
+
+// Serves one connection from the client: takes its "ping", answers "pong",
+// and waits for it to close.
+ClientResult serve_one(GuacamoleServer &server, int port,
+                       const ClientOptions &opts,
+                       SSL_SESSION *resume = nullptr) {
+    ClientResult result;
+    std::thread client(
+        [&]() { result = run_client(port, opts, resume); });
+
+    std::vector<int> fds;
+    while (fds.empty())
+        assert(server.AcceptBatch(0, fds, 2000) >= 0);
+    int fd = fds[0];
+    char buf[64];
+    int n;
+    while ((n = server.Receive(fd, buf, sizeof(buf))) ==
+           GuacamoleServer::RETRY) {
+    }
+    assert(n == 4 && std::string(buf, 4) == "ping");
+    assert(server.Send(fd, "pong", 4) == 4);
+    while ((n = server.Receive(fd, buf, sizeof(buf))) > 0 ||
+           n == GuacamoleServer::RETRY) {
+    }
+    server.Close(fd);
+
+    client.join();
+    assert(result.reply == "pong");
+    return result;
+}
+
+} // namespace
+
+/**
+ * @brief With kTLS requested, a connection on a suite the kernel cannot take
+ * (or on a host without the tls module) still completes on user-space TLS
+ */
+void test_ktls_fallback() {
+    setenv("GMLBROKER_KTLS", "1", 1);
+    int port = free_port();
+    GuacamoleServer server("127.0.0.1", port);
+    assert(server.Initialize() == 0);
+
+    // AES-CBC: no kTLS for it, whatever the kernel.
+    ClientOptions cbc;
+    cbc.tls12_ciphers = "ECDHE-RSA-AES128-SHA256";
+    ClientResult r = serve_one(server, port, cbc);
+    SSL_SESSION_free(r.session);
+
+    // The default suites, offloaded if this host can.
+    r = serve_one(server, port, ClientOptions{});
+    SSL_SESSION_free(r.session);
+    assert(server.SessionMisses() == 2);
+    unsetenv("GMLBROKER_KTLS");
+}
+
+/**
+ * @brief A full handshake counts as a miss; resuming by ticket or from the
+ * session cache counts as a hit
+ */
+void test_resumption_counters() {
+    int port = free_port();
+    GuacamoleServer server("127.0.0.1", port);
+    assert(server.Initialize() == 0);
+    assert(server.SessionHits() == 0 && server.SessionMisses() == 0);
+
+    // TLS 1.3, ticket.
+    ClientResult first = serve_one(server, port, ClientOptions{});
+    assert(!first.reused);
+    assert(server.SessionHits() == 0 && server.SessionMisses() == 1);
+    ClientResult again = serve_one(server, port, ClientOptions{}, first.session);
+    assert(again.reused);
+    assert(server.SessionHits() == 1 && server.SessionMisses() == 1);
+    SSL_SESSION_free(first.session);
+    SSL_SESSION_free(again.session);
+
+    // TLS 1.2 without tickets: only the server-side cache can resume it.
+    ClientOptions ids;
+    ids.tls12 = true;
+    ids.no_tickets = true;
+    first = serve_one(server, port, ids);
+    again = serve_one(server, port, ids, first.session);
+    assert(!first.reused && again.reused);
+    assert(server.SessionHits() == 2 && server.SessionMisses() == 2);
+    SSL_SESSION_free(first.session);
+    SSL_SESSION_free(again.session);
+}
+
+/**
+ * @brief With the cache turned off, a session-id resumption is a full
+ * handshake again
+ */
+void test_cache_off() {
+    setenv("GMLBROKER_TLS_SESSION_CACHE", "0", 1);
+    int port = free_port();
+    GuacamoleServer server("127.0.0.1", port);
+    assert(server.Initialize() == 0);
+
+    ClientOptions ids;
+    ids.tls12 = true;
+    ids.no_tickets = true;
+    ClientResult first = serve_one(server, port, ids);
+    ClientResult again = serve_one(server, port, ids, first.session);
+    assert(!again.reused);
+    assert(server.SessionHits() == 0 && server.SessionMisses() == 2);
+    SSL_SESSION_free(first.session);
+    SSL_SESSION_free(again.session);
+    unsetenv("GMLBROKER_TLS_SESSION_CACHE");
+}
+
+/**
+ * @brief A ticket sealed under the previous key still resumes after a
+ * rotation; one sealed by another server's keys does not
+ */
+void test_ticket_rotation() {
+    // Keys rotate every 3 s, from Initialize(). The ticket is issued 1.5 s in,
+    // under the first key, and used 3.5 s in: after the rotation, but well
+    // inside its session lifetime.
+    setenv("GMLBROKER_TLS_SESSION_LIFETIME", "3", 1);
+    int port = free_port();
+    GuacamoleServer server("127.0.0.1", port);
+    assert(server.Initialize() == 0);
+    auto started = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_until(started + 1500ms);
+    ClientResult first = serve_one(server, port, ClientOptions{});
+    std::this_thread::sleep_until(started + 3500ms);
+    ClientResult again = serve_one(server, port, ClientOptions{}, first.session);
+    assert(again.reused);
+    assert(server.SessionHits() == 1 && server.SessionMisses() == 1);
+
+    // A server with keys of its own cannot open the ticket.
+    int other_port = free_port();
+    GuacamoleServer other("127.0.0.1", other_port);
+    assert(other.Initialize() == 0);
+    ClientResult foreign =
+        serve_one(other, other_port, ClientOptions{}, again.session);
+    assert(!foreign.reused);
+    assert(other.SessionHits() == 0 && other.SessionMisses() == 1);
+
+    SSL_SESSION_free(first.session);
+    SSL_SESSION_free(again.session);
+    SSL_SESSION_free(foreign.session);
+    unsetenv("GMLBROKER_TLS_SESSION_LIFETIME");
+}
+
+/**
+ * @brief Unit tests for GuacamoleServer's TLS mode, over loopback
+ */
+int main() {
+    char dir[] = "/tmp/gdd-tls-XXXXXX";
+    assert(::mkdtemp(dir) != nullptr);
+    make_cert(dir);
+    setenv("GMLBROKER_TLS", "1", 1);
+
+    test_ktls_fallback();
+
+    test_resumption_counters();
+
+    test_cache_off();
+
+    test_ticket_rotation();
+
+    ::unlink((std::string(dir) + "/cert.pem").c_str());
+    ::unlink((std::string(dir) + "/key.pem").c_str());
+    ::rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief The sending end of one bridge hop (one diode direction)
+ *
+ * Each hop carries serialized BridgeMessages one way only. UDPSender is the
+ * production transport; ShmRingSender stands in for it when the two ends share
+ * a host (BRIDGE_TRANSPORT=shm), and MemBridgeSender when they share a process
+ * (BRIDGE_TRANSPORT=mem, gdd-allinone).
+ */
+class BridgeSender {
+  public:
+    virtual ~BridgeSender() = default;
+
+    /**
+     * @brief Opens the transport
+     * @return 0 on success, nonzero on failure
+     */
+    virtual int Initialize() = 0;
+
+    /**
+     * @brief Sends one message; like a datagram, it is lost if the receiver
+     *        cannot keep up
+     * @return How many bytes were sent, or -1 on error
+     */
+    virtual ssize_t Send(const char *buffer, size_t len) = 0;
+};
+
+/**
+ * @brief The receiving end of one bridge hop
+ */
+class BridgeReceiver {
+  public:
+    /**
+     * @brief Longest a Receive() waits for a message, so the caller notices
+     *        a shutdown
+     */
+    static constexpr std::chrono::milliseconds RECEIVE_WAIT{200};
+
+    virtual ~BridgeReceiver() = default;
+
+    /**
+     * @brief Opens the transport
+     * @return 0 on success, nonzero on failure
+     */
+    virtual int Initialize() = 0;
+
+    /**
+     * @brief An fd to poll() for incoming messages, or -1 if Receive() does
+     *        its own waiting (wake it early with Interrupt())
+     */
+    virtual int Fd() const = 0;
+
+    /**
+     * @brief Receives one message into buffer, NUL-terminated; waits at most
+     *        RECEIVE_WAIT so the caller can check whether to keep running
+     * @return Bytes received, 0 if there was nothing (timeout, interrupt),
+     *         -1 on error
+     */
+    virtual int Receive(char buffer[], size_t len) = 0;
+
+    /**
+     * @brief Makes a waiting Receive() return 0 now (no-op where Fd() is
+     *        polled instead)
+     */
+    virtual void Interrupt() {}
+};
+
+/**
+ * @brief Whether BRIDGE_TRANSPORT selects the shared-memory rings
+ *
+ * `udp` (the default) or `shm`. Only meaningful when both ends of every hop
+ * run on one host and share /dev/shm (or BRIDGE_SHM_DIR).
+ */
+bool bridge_uses_shm();
+
+/**
+ * @brief Whether BRIDGE_TRANSPORT selects the in-process queues (`mem`)
+ *
+ * Set by gdd-allinone, which runs all three stages in one process.
+ */
+bool bridge_in_process();
+
+/**
+ * @brief The configured transport's sender for the hop to host:port
+ *
+ * For the shared-memory and in-process transports the port only names the
+ * ring or queue, so the hop is configured the same way whichever transport
+ * carries it.
+ */
+std::unique_ptr<BridgeSender> MakeBridgeSender(const std::string &host,
+                                               int port);
+
+/**
+ * @brief The configured transport's receiver for the hop arriving on port
+ */
+std::unique_ptr<BridgeReceiver> MakeBridgeReceiver(int port);
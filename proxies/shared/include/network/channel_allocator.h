@@ -0,0 +1,202 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief How long a freed channel id is held back before it can be handed out
+ * again (CHANNEL_QUARANTINE_MS, default 10 s).
+ *
+ * Control frames for a just-closed channel (a peer SHUTDOWN echo, a stale
+ * APPROVAL) can still be in flight on the bridge; reusing the id while they
+ * are would let them tear down or disrupt the new occupant. 0 disables the
+ * hold.
+ */
+inline std::chrono::milliseconds channel_quarantine() {
+    const char *env = std::getenv("CHANNEL_QUARANTINE_MS");
+    int v = env ? std::atoi(env) : -1;
+    return std::chrono::milliseconds(v >= 0 ? v : 10000);
+}
+
+/**
+ * @brief Hands out 16-bit channel ids round-robin, in constant time
+ *
+ * Free ids are bits in a two-level bitmap: 1024 words of 64 ids, plus 16
+ * summary words with a bit per non-empty word. Acquire() finds the first free
+ * id at or after the round-robin cursor with at most a couple of
+ * find-first-set steps per level, however full the table is, rather than
+ * probing slot by slot.
+ *
+ * A Release()d id is not free straight away: it waits out the quarantine in a
+ * FIFO (every entry has the same hold, so the oldest is always in front) and
+ * only then gets its bit back. Claim() takes a specific, peer-chosen id out of
+ * circulation. All operations take one short lock; they run once per
+ * connection, never per message.
+ */
+class ChannelAllocator {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t IDS = 1 << 16;
+
+    explicit ChannelAllocator(
+        std::chrono::milliseconds quarantine = channel_quarantine())
+        : quarantine(quarantine) {
+        free_bits.fill(~uint64_t(0));
+        summary.fill(~uint64_t(0));
+        held.fill(0);
+    }
+
+    ChannelAllocator(const ChannelAllocator &) = delete;
+    ChannelAllocator &operator=(const ChannelAllocator &) = delete;
+
+    /**
+     * @brief Takes the first free id at or after the cursor (wrapping)
+     * @return The id, or std::nullopt if every id is in use or quarantined
+     */
+    std::optional<uint16_t> Acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!quarantined.empty())
+            Thaw(Clock::now());
+
+        size_t word = cursor >> 6;
+        uint64_t bits = free_bits[word] & (~uint64_t(0) << (cursor & 63));
+        if (!bits) {
+            word = NextWord(word + 1);
+            if (word == WORDS)
+                word = NextWord(0); // wrap; may land back on the cursor's word
+            if (word == WORDS)
+                return std::nullopt;
+            bits = free_bits[word];
+        }
+        uint16_t id =
+            static_cast<uint16_t>((word << 6) + __builtin_ctzll(bits));
+        Take(id);
+        cursor = static_cast<uint16_t>(id + 1);
+        return id;
+    }
+
+    /**
+     * @brief Takes a specific id out of circulation, free or quarantined
+     * @return False if it is already held
+     */
+    bool Claim(uint16_t id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (Held(id))
+            return false;
+        Take(id);
+        return true;
+    }
+
+    /**
+     * @brief Returns a held id; it becomes free once its quarantine is over
+     */
+    void Release(uint16_t id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!Held(id))
+            return;
+        held[id >> 6] &= ~(uint64_t(1) << (id & 63));
+        Clock::time_point now = Clock::now();
+        if (quarantine.count() == 0) {
+            Free(id);
+            return;
+        }
+        quarantined.push_back({id, ++releases[id], now + quarantine});
+        Thaw(now); // keep the FIFO short when nobody Acquire()s
+    }
+
+    /** @brief Ids released but still held back (for tests and stats) */
+    size_t Quarantined() {
+        std::lock_guard<std::mutex> lock(mtx);
+        Thaw(Clock::now());
+        return quarantined.size();
+    }
+
+  private:
+    static constexpr size_t WORDS = IDS / 64;
+
+    struct Hold {
+        uint16_t id;
+        uint32_t release; // releases[id] when this hold began
+        Clock::time_point until;
+    };
+
+    bool Held(uint16_t id) const {
+        return held[id >> 6] & (uint64_t(1) << (id & 63));
+    }
+
+    void Take(uint16_t id) {
+        size_t word = id >> 6;
+        free_bits[word] &= ~(uint64_t(1) << (id & 63));
+        if (!free_bits[word])
+            summary[word >> 6] &= ~(uint64_t(1) << (word & 63));
+        held[word] |= uint64_t(1) << (id & 63);
+    }
+
+    void Free(uint16_t id) {
+        size_t word = id >> 6;
+        free_bits[word] |= uint64_t(1) << (id & 63);
+        summary[word >> 6] |= uint64_t(1) << (word & 63);
+    }
+
+    // Frees every id whose hold is over. One Claim()ed again in the meantime
+    // stays taken; if it was also Release()d again, this older hold is stale
+    // and the id waits out its newest one.
+    void Thaw(Clock::time_point now) {
+        while (!quarantined.empty() && quarantined.front().until <= now) {
+            Hold hold = quarantined.front();
+            quarantined.pop_front();
+            if (!Held(hold.id) && hold.release == releases[hold.id])
+                Free(hold.id);
+        }
+    }
+
+    // First word at or after `from` with a free id, or WORDS if none.
+    size_t NextWord(size_t from) const {
+        for (size_t s = from >> 6; s < summary.size(); ++s) {
+            uint64_t bits = summary[s];
+            if (s == from >> 6)
+                bits &= ~uint64_t(0) << (from & 63);
+            if (bits)
+                return (s << 6) + __builtin_ctzll(bits);
+        }
+        return WORDS;
+    }
+
+    const std::chrono::milliseconds quarantine;
+
+    std::mutex mtx;
+    std::array<uint64_t, WORDS> free_bits;       // bit per free id
+    std::array<uint64_t, WORDS / 64> summary;    // bit per word with a free id
+    std::array<uint64_t, WORDS> held;            // bit per id in use
+    std::deque<Hold> quarantined;                // oldest first
+    // Per id, bumped by each Release(), so Thaw() can tell a stale hold.
+    std::unique_ptr<uint32_t[]> releases{new uint32_t[IDS]()};
+    uint16_t cursor = 0;
+};
@@ -20,70 +20,86 @@
 
 #pragma once
 
+#include "channel_allocator.h"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
-#include <mutex>
+#include <memory>
 #include <optional>
-#include <unordered_map>
 #include <vector>
 
 /**
- * @brief Thread-safe mapping between multiplexing channel IDs and socket fds
+ * @brief Extra per-channel state for tables that need none (gcdbroker).
+ */
+struct NoChannelState {};
+
+/**
+ * @brief Wait-free mapping between multiplexing channel IDs and socket fds
  *
  * One side of the bridge (gmlbroker) allocates channels with Allocate(); the
  * other side (gcdbroker) records the peer's choice with Insert(). Both look up
  * fds with Get() and tear channels down with Remove().
+ *
+ * Channel ids are 16 bits, so the table is a flat array of 65536 slots indexed
+ * directly by channel: a lookup is one atomic load, with no lock and no hashing
+ * on the routing hot path. An fd of -1 marks a free slot. Which ids may be
+ * bound is kept by a ChannelAllocator, so Allocate() finds a free id in
+ * constant time, and a Remove()d id sits out a quarantine before it is handed
+ * out again.
+ *
+ * @p State is extra per-channel state kept in the same slot (e.g. gmlbroker's
+ * mailbox and approval word); it must be default-constructible and is managed by
+ * the derived table. A slot's fd is only freed after its state is reset, so a
+ * newly bound channel always starts from a clean slot.
  */
-class ChannelTable {
-  private:
-    mutable std::mutex mtx;
-    std::unordered_map<uint16_t, int> channel_to_fd;
-    // Round-robin cursor for Allocate. Channels are handed out sequentially and
-    // a freed channel is not reused until the cursor wraps the whole 16-bit
-    // space. This matters because control frames (a peer SHUTDOWN echo, a stale
-    // APPROVAL) for a just-closed channel can still be in flight on the bridge;
-    // reusing that id immediately — as lowest-free allocation did — let such a
-    // frame tear down or disrupt the new occupant. Delaying reuse lets the old
-    // frames drain first.
-    uint16_t next_channel = 0;
-
+template <typename State = NoChannelState> class BasicChannelTable {
   public:
+    static constexpr size_t CHANNELS = 1 << 16;
+
+    BasicChannelTable() : slots(new Slot[CHANNELS]) {}
+
+    /**
+     * @param quarantine How long a removed channel is held back from reuse
+     */
+    explicit BasicChannelTable(std::chrono::milliseconds quarantine)
+        : slots(new Slot[CHANNELS]), allocator(quarantine) {}
+
+    BasicChannelTable(const BasicChannelTable &) = delete;
+    BasicChannelTable &operator=(const BasicChannelTable &) = delete;
+
     /**
      * @brief Allocates the next free channel ID (round-robin) and binds it to fd
-     * @return The allocated channel, or std::nullopt if all 65536 are in use
+     * @return The allocated channel, or std::nullopt if all 65536 are in use or
+     *         quarantined
      */
     std::optional<uint16_t> Allocate(int fd) {
-        std::lock_guard<std::mutex> lock(mtx);
-        for (int i = 0; i <= 0xFFFF; ++i) {
-            // next_channel + i wraps mod 65536 on the cast, so the scan covers
-            // every slot starting from the cursor.
-            uint16_t channel = static_cast<uint16_t>(next_channel + i);
-            if (channel_to_fd.find(channel) == channel_to_fd.end()) {
-                channel_to_fd[channel] = fd;
-                next_channel = static_cast<uint16_t>(channel + 1);
-                return channel;
-            }
-        }
-        return std::nullopt;
+        std::optional<uint16_t> channel = allocator.Acquire();
+        if (channel)
+            slots[*channel].fd.store(fd, std::memory_order_release);
+        return channel;
     }
 
     /**
      * @brief Binds a specific (peer-chosen) channel to fd
+     *
+     * The peer runs its own quarantine, so a quarantined id is accepted here.
      * @return False if the channel was already in use
      */
     bool Insert(uint16_t channel, int fd) {
-        std::lock_guard<std::mutex> lock(mtx);
-        return channel_to_fd.emplace(channel, fd).second;
+        if (!allocator.Claim(channel))
+            return false;
+        slots[channel].fd.store(fd, std::memory_order_release);
+        return true;
     }
 
     /**
      * @brief Looks up the fd bound to a channel
      */
     std::optional<int> Get(uint16_t channel) const {
-        std::lock_guard<std::mutex> lock(mtx);
-        auto it = channel_to_fd.find(channel);
-        if (it == channel_to_fd.end())
+        int fd = slots[channel].fd.load(std::memory_order_acquire);
+        if (fd < 0)
             return std::nullopt;
-        return it->second;
+        return fd;
     }
 
     /**
@@ -92,12 +108,10 @@ class ChannelTable {
      *         The caller that receives the fd is responsible for closing it.
      */
     std::optional<int> Remove(uint16_t channel) {
-        std::lock_guard<std::mutex> lock(mtx);
-        auto it = channel_to_fd.find(channel);
-        if (it == channel_to_fd.end())
+        int fd = slots[channel].fd.exchange(-1);
+        if (fd < 0)
             return std::nullopt;
-        int fd = it->second;
-        channel_to_fd.erase(it);
+        allocator.Release(channel);
         return fd;
     }
 
@@ -106,14 +120,35 @@ class ChannelTable {
      *
      * Used on shutdown to shutdown() every live connection and wake the reader
      * threads blocked in recv(). The fds are not removed: each channel's reader
-     * remains the sole owner of close().
+     * remains the sole owner of close(). Scans all slots; not for the hot path.
      */
     std::vector<int> Fds() const {
-        std::lock_guard<std::mutex> lock(mtx);
         std::vector<int> fds;
-        fds.reserve(channel_to_fd.size());
-        for (const auto &entry : channel_to_fd)
-            fds.push_back(entry.second);
+        for (size_t channel = 0; channel < CHANNELS; ++channel) {
+            int fd = slots[channel].fd.load(std::memory_order_acquire);
+            if (fd >= 0)
+                fds.push_back(fd);
+        }
         return fds;
     }
+
+  protected:
+    State &StateOf(uint16_t channel) { return slots[channel].state; }
+    const State &StateOf(uint16_t channel) const {
+        return slots[channel].state;
+    }
+
+  private:
+    struct Slot {
+        std::atomic<int> fd{-1};
+        State state;
+    };
+    std::unique_ptr<Slot[]> slots;
+    // Channels are handed out round-robin from a cursor, and a removed one is
+    // quarantined (CHANNEL_QUARANTINE_MS) before it can be reused, so control
+    // frames still in flight for it can't reach a new occupant. Neither relies
+    // on the table being too empty for the cursor to wrap quickly.
+    ChannelAllocator allocator;
 };
+
+using ChannelTable = BasicChannelTable<>;
@@ -22,21 +22,37 @@
 
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 // Forward-declared so includers don't pull in <openssl/ssl.h>. SSL_CTX and SSL
 // are typedefs for `struct ssl_ctx_st` / `struct ssl_st`; the .cpp uses the real
 // OpenSSL types.
 struct ssl_ctx_st;
 struct ssl_st;
+struct evp_cipher_ctx_st;
+struct evp_mac_ctx_st;
 
 /**
  * @brief A TCP server that accepts and serves multiple simultaneous clients
  *
- * Owns only the listening socket. Accepted client sockets are handed back to the
- * caller as raw fds; the caller (via a ChannelTable) decides their lifetime.
+ * Owns only the listening sockets. Accepted client sockets are handed back to
+ * the caller as raw fds; the caller (via a ChannelTable) decides their
+ * lifetime.
+ *
+ * Accepting is built for bursts (a shift change opens hundreds of tunnels in
+ * seconds): each listener is non-blocking, and AcceptBatch() drains everything
+ * pending with accept4() after one poll(). The listen backlog is configurable
+ * (GMLBROKER_LISTEN_BACKLOG), TCP_DEFER_ACCEPT (GMLBROKER_DEFER_ACCEPT) keeps a
+ * connection out of the accept queue until the web server has sent its first
+ * bytes, and GMLBROKER_ACCEPT_SHARDS > 1 opens that many SO_REUSEPORT listeners
+ * on the same port, so the kernel spreads connections over several accept
+ * threads.
  * Receive/Send/Shutdown/Close all operate on a caller-supplied fd, so the same
  * server instance can be used from multiple threads, one per client.
  *
@@ -45,22 +61,79 @@ struct ssl_st;
  * in its own SSL object; when disabled, ssl_ctx stays null and every operation
  * is plaintext — byte-for-byte the original behaviour. The per-connection SSL
  * object is only ever used from the single thread that owns the fd.
+ *
+ * With kTLS also requested (GMLBROKER_KTLS), each connection checks after its
+ * handshake whether OpenSSL moved record encryption into the kernel. If it did,
+ * Send/SendChunks write the socket directly (send/writev) and the kernel frames
+ * the records; otherwise they keep using SSL_write. Reads always go through
+ * SSL_read, which copes with kTLS receive and non-data records.
+ *
+ * Repeat connections from the web server resume earlier sessions instead of
+ * doing a full handshake: TLS 1.2 clients through a bounded server-side session
+ * cache, and any client through session tickets sealed with keys that rotate
+ * every session lifetime (see util/tls.h). Hits and misses are counted.
  */
 class GuacamoleServer {
   private:
     std::string host;
     int recv_port;
-    int listen_fd = -1;
+    std::vector<int> listen_fds; // one per accept shard
 
     bool tls_on = false;          // whether this server speaks TLS
+    bool ktls_on = false;         // whether kTLS offload was requested
     ssl_ctx_st *ssl_ctx = nullptr; // shared server context (null in plaintext mode)
 
-    // Per-connection SSL objects, keyed by fd. The accept thread inserts on
-    // Accept(); the connection's owning thread looks them up for I/O and erases
+    /**
+     * @brief Per-connection TLS state; only touched by the fd's owning thread
+     */
+    struct TlsConn {
+        ssl_st *ssl = nullptr;
+        bool handshake_done = false;  // resumption and kTLS status recorded
+        bool ktls_send = false;       // kernel encrypts outgoing records
+    };
+
+    // Per-connection TLS state, keyed by fd. The accept thread inserts on
+    // Accept(); the connection's owning thread looks it up for I/O and erases
     // on Close(). Guarded by ssl_mtx since accept and reader threads both touch
-    // the map (though any one SSL object is only ever used by its owner thread).
+    // the map (though any one entry is only ever used by its owner thread).
     std::mutex ssl_mtx;
-    std::unordered_map<int, ssl_st *> ssl_by_fd;
+    std::unordered_map<int, TlsConn> ssl_by_fd;
+
+    /**
+     * @brief One session-ticket key: the name the ticket carries, plus the
+     * AES-256 and HMAC-SHA256 keys that seal it
+     */
+    struct TicketKey {
+        unsigned char name[16];
+        unsigned char aes[32];
+        unsigned char hmac[32];
+    };
+
+    // Current ([0]) and previous ([1]) ticket keys, rotated every session
+    // lifetime. Tickets are sealed and opened on the reader threads.
+    std::mutex ticket_mtx;
+    TicketKey ticket_keys[2];
+    int ticket_key_count = 0;
+    std::chrono::steady_clock::time_point ticket_rotated;
+    std::chrono::seconds ticket_lifetime{300};
+
+    // Completed handshakes that resumed a session vs. did a full exchange.
+    std::atomic<uint64_t> session_hits{0};
+    std::atomic<uint64_t> session_misses{0};
+
+    /**
+     * @brief Opens one bound, listening, non-blocking socket
+     * @param reuse_port: share the port with sibling listeners (SO_REUSEPORT)
+     * @return The listening fd, or -1 on failure
+     */
+    int OpenListener(const sockaddr_in &addr, bool reuse_port);
+
+    /**
+     * @brief Logs a newly accepted connection and, in TLS mode, binds its SSL
+     * object
+     * @return false if the connection could not be set up (fd is closed)
+     */
+    bool Adopt(int fd, const sockaddr_in &client_addr);
 
     /**
      * @brief Builds the server SSL_CTX and loads the cert/key
@@ -69,9 +142,30 @@ class GuacamoleServer {
     int InitializeTls();
 
     /**
-     * @brief Looks up the SSL object bound to fd, or nullptr if none/plaintext
+     * @brief Looks up the TLS state bound to fd, or nullptr if none/plaintext
      */
-    ssl_st *SslFor(int fd);
+    TlsConn *ConnFor(int fd);
+
+    /**
+     * @brief Once the handshake has finished, counts whether it resumed a
+     * session and records (and logs) whether kTLS engaged for this connection.
+     * Cheap no-op after the first success.
+     */
+    void CheckHandshake(int fd, TlsConn &conn);
+
+    /**
+     * @brief Makes a fresh current ticket key when the current one is due (or
+     * missing), keeping the old one as previous. Caller holds ticket_mtx.
+     */
+    void RotateTicketKeys();
+
+    /**
+     * @brief OpenSSL ticket-key callback: seals new tickets with the current
+     * key, opens tickets made with the current or previous key
+     */
+    static int TicketKeyCallback(ssl_st *ssl, unsigned char *key_name,
+                                 unsigned char *iv, evp_cipher_ctx_st *cipher,
+                                 evp_mac_ctx_st *mac, int enc);
 
   public:
     // Receive() returns this when the TLS layer has no application data yet
@@ -82,14 +176,17 @@ class GuacamoleServer {
     GuacamoleServer(std::string host, int recv_port)
         : host(host), recv_port(recv_port) {}
 
+    // Most connections AcceptBatch() takes from one listener per call.
+    static constexpr size_t ACCEPT_BATCH = 64;
+
     /**
-     * @brief Closes the listening socket and frees the TLS context
+     * @brief Closes the listening sockets and frees the TLS context
      */
     ~GuacamoleServer();
 
     /**
-     * @brief Attempts to bind to the server address and listen on it, and (when
-     * TLS is enabled) build the server SSL_CTX
+     * @brief Attempts to bind to the server address and listen on it (once per
+     * accept shard), and (when TLS is enabled) build the server SSL_CTX
      * @return 0 on success, nonzero on failure
      */
     int Initialize();
@@ -100,10 +197,31 @@ class GuacamoleServer {
     bool TlsEnabled() const { return tls_on; }
 
     /**
-     * @brief Waits for a client to connect (blocking)
-     * @return The accepted client fd, or -1 on failure
+     * @brief TLS handshakes that resumed an earlier session (cache or ticket)
+     */
+    uint64_t SessionHits() const { return session_hits.load(); }
+
+    /**
+     * @brief TLS handshakes that needed the full certificate and key exchange
+     */
+    uint64_t SessionMisses() const { return session_misses.load(); }
+
+    /**
+     * @brief How many listeners Initialize() opened; each wants its own accept
+     * thread
+     */
+    size_t Shards() const { return listen_fds.size(); }
+
+    /**
+     * @brief Waits up to timeout_ms for connections on one shard's listener,
+     * then accepts every pending one, up to ACCEPT_BATCH
+     *
+     * Accepted fds are blocking (the per-connection I/O relies on that) and
+     * close-on-exec, and are appended to `out`.
+     * @return How many were accepted (0 on timeout), or -1 once the listener
+     *         is unusable
      */
-    int Accept();
+    int AcceptBatch(size_t shard, std::vector<int> &out, int timeout_ms);
 
     /**
      * @brief Waits up to timeout_ms for a client fd to become readable
@@ -133,6 +251,18 @@ class GuacamoleServer {
      */
     ssize_t Send(int fd, const char *buffer, size_t len);
 
+    /**
+     * @brief Sends several buffers to a client fd, in order, with as few writes
+     * as possible
+     *
+     * The gather-write counterpart of Send() for a drained ChannelMailbox: in
+     * plaintext mode the chunks go out through writev() (IOV_MAX at a time); in
+     * TLS mode they are coalesced into a reusable staging buffer and written as
+     * full-size (16 KB) records instead of one small record per chunk.
+     * @return Total bytes sent, or -1 on error
+     */
+    ssize_t SendChunks(int fd, const std::vector<std::string> &chunks);
+
     /**
      * @brief Half-closes a client fd, waking any blocking Receive on it
      */
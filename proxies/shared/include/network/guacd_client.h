@@ -20,9 +20,13 @@
 
 #pragma once
 
+#include <chrono>
+#include <mutex>
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/socket.h>
+#include <vector>
 
 /**
  * @brief A TCP client that can open multiple simultaneous connections
@@ -31,34 +35,57 @@
  * client instance can hold many concurrent connections (one per channel).
  * Receive/Send/Shutdown/Close all operate on a caller-supplied fd, so the same
  * instance can be used from multiple threads, one per connection.
+ *
+ * Connect() never blocks for longer than GUACD_CONNECT_TIMEOUT_MS: the connect
+ * is non-blocking and waited on with a deadline. The server's addresses are
+ * resolved once and reused for GUACD_RESOLVE_TTL_MS, so a dial costs no DNS
+ * round trip; a failed dial drops the cached answer so the next one resolves
+ * afresh. Connect() may be called from several threads at once.
  */
 class GuacdClient {
   private:
+    struct Address {
+        struct sockaddr_storage addr;
+        socklen_t len;
+    };
+
     std::string server_ip;
     int server_port;
 
+    std::mutex resolve_mtx;
+    std::vector<Address> resolved; // empty until the first successful lookup
+    std::chrono::steady_clock::time_point resolved_at;
+
+    /**
+     * @brief The server's addresses, from the cache while it is fresh
+     * @return false if the lookup failed
+     */
+    bool Resolve(std::vector<Address> &out);
+
+    /**
+     * @brief Forgets the cached addresses after a dial that reached none
+     */
+    void Invalidate();
+
   public:
     GuacdClient(std::string server_ip, int server_port)
         : server_ip(server_ip), server_port(server_port) {}
 
-    ~GuacdClient() = default;
+    GuacdClient(const GuacdClient &) = delete;
+    GuacdClient &operator=(const GuacdClient &) = delete;
 
-    // Returned by Receive() when the socket's receive timeout elapsed with no
-    // data — the connection is idle but alive — as opposed to 0 (peer closed)
-    // or -1 (error). Lets the reader run periodic idle work (keepalives).
-    static constexpr int RECV_TIMEOUT = -2;
+    ~GuacdClient() = default;
 
     /**
-     * @brief Opens a new connection to the configured server
+     * @brief Opens a new connection to the configured server, giving up once
+     *        the connect deadline passes
      * @return The connected fd, or -1 on failure
      */
     int Connect();
 
     /**
-     * @brief Receives traffic from a connection fd into buffer (blocking, but
-     *        with a receive timeout — see Connect)
-     * @return Bytes received, 0 if the server closed, RECV_TIMEOUT on an idle
-     *         timeout, -1 on error
+     * @brief Receives traffic from a connection fd into buffer (blocking)
+     * @return Bytes received, 0 if the server closed, -1 on error
      */
     int Receive(int fd, char buffer[], size_t len);
 
@@ -0,0 +1,113 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "bridge_transport.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief One bridge hop inside a single process: a bounded message queue
+ *
+ * Used when gdd-allinone runs all three stages in one process
+ * (BRIDGE_TRANSPORT=mem). Like the datagram hop it replaces, a full queue
+ * drops the new message rather than making the sender wait, so a stalled
+ * stage never blocks the one before it. The hop is found by port, the same
+ * number the stages would bind for UDP, so their configuration is unchanged.
+ */
+class MemHop {
+  public:
+    explicit MemHop(size_t capacity) : capacity(capacity) {}
+
+    /**
+     * @brief The process-wide hop for @p port, created on first use
+     * (capacity from BRIDGE_MEM_SLOTS, default 4096 messages)
+     */
+    static std::shared_ptr<MemHop> ForPort(int port);
+
+    /**
+     * @brief Queues a copy of the message
+     * @return false if the queue was full and the message was dropped
+     */
+    bool Push(const char *buffer, size_t len);
+
+    /**
+     * @brief Takes the oldest message, waiting at most
+     *        BridgeReceiver::RECEIVE_WAIT
+     * @return false on timeout or Interrupt()
+     */
+    bool Pop(std::string &out);
+
+    /** @brief Makes a waiting Pop() return false now */
+    void Interrupt();
+
+    /** @brief Messages dropped because the queue was full */
+    uint64_t Dropped() const;
+
+  private:
+    const size_t capacity;
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::string> messages;
+    uint64_t dropped = 0;
+    bool dropping = false; // in a run of drops, already logged
+    bool interrupted = false;
+};
+
+/**
+ * @brief Writes one bridge hop into an in-process MemHop
+ */
+class MemBridgeSender : public BridgeSender {
+  public:
+    explicit MemBridgeSender(int port) : port(port) {}
+
+    int Initialize() override;
+    ssize_t Send(const char *buffer, size_t len) override;
+
+  private:
+    int port;
+    std::shared_ptr<MemHop> hop;
+};
+
+/**
+ * @brief Reads one bridge hop from an in-process MemHop
+ *
+ * Receive() waits on the queue itself, so Fd() is -1.
+ */
+class MemBridgeReceiver : public BridgeReceiver {
+  public:
+    explicit MemBridgeReceiver(int port) : port(port) {}
+
+    int Initialize() override;
+    int Fd() const override { return -1; }
+    int Receive(char buffer[], size_t len) override;
+    void Interrupt() override;
+
+  private:
+    int port;
+    std::shared_ptr<MemHop> hop;
+    std::string message;
+};
@@ -0,0 +1,143 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "bridge_transport.h"
+#include "multiplexer.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief Layout of a bridge ring in shared memory
+ *
+ * A fixed number of slots, each holding one serialized BridgeMessage, written
+ * in turn by the one sender. The sender never looks at what the receiver has
+ * read: when it laps a slow receiver it just overwrites, and the receiver sees
+ * the lost messages as a gap, the same as datagrams dropped on a full socket.
+ * Each slot carries a sequence word (odd while being written, 2n+2 once it
+ * holds message n), so a message overwritten while being copied out is
+ * detected and dropped rather than delivered torn.
+ */
+struct ShmRingHeader {
+    static constexpr uint64_t MAGIC = 0x6764642d72696e67; // "gdd-ring"
+
+    uint64_t magic;
+    uint32_t slots;
+    uint32_t slot_size;
+    // Set last, once the fields above are filled in.
+    std::atomic<uint32_t> ready;
+    alignas(64) std::atomic<uint64_t> head; // messages written so far
+    // Low 32 bits of head, the futex word a waiting receiver sleeps on.
+    alignas(64) std::atomic<uint32_t> doorbell;
+};
+
+struct ShmRingSlot {
+    static constexpr size_t DATA_SIZE = Multiplexer::MAX_DATAGRAM_SIZE;
+
+    std::atomic<uint64_t> seq;
+    uint32_t len;
+    char data[DATA_SIZE];
+};
+
+/**
+ * @brief Path of the ring for the hop arriving on @p port
+ * (BRIDGE_SHM_DIR, default /dev/shm/gdd-bridge)
+ */
+std::string shm_ring_path(int port);
+
+/**
+ * @brief Writes one bridge hop into a shared-memory ring
+ *
+ * Creates a fresh ring file (replacing any earlier one) and maps it
+ * read-write. Send() is a copy into the next slot and a futex wake; there is
+ * no socket, no kernel network stack and no wait on the receiver. Sized by
+ * BRIDGE_SHM_SLOTS (default 4096 messages). The file is readable by this user
+ * only, or also by the BRIDGE_SHM_GID group, and its directory must not be
+ * writable by anyone else. Single producer: call Send() from one thread.
+ */
+class ShmRingSender : public BridgeSender {
+  public:
+    explicit ShmRingSender(int port) : path(shm_ring_path(port)) {}
+    ~ShmRingSender() override;
+
+    ShmRingSender(const ShmRingSender &) = delete;
+    ShmRingSender &operator=(const ShmRingSender &) = delete;
+
+    int Initialize() override;
+    ssize_t Send(const char *buffer, size_t len) override;
+
+  private:
+    std::string path;
+    void *map = nullptr;
+    size_t map_size = 0;
+    ShmRingHeader *header = nullptr;
+    ShmRingSlot *slots = nullptr;
+    uint64_t next = 0;
+};
+
+/**
+ * @brief Reads one bridge hop from a shared-memory ring
+ *
+ * Maps the ring read-only, so the one-way property holds in hardware: the
+ * receiver cannot write a single byte back toward the sender. It waits for
+ * new messages on the ring's futex word. The ring is attached lazily, so the
+ * receiver may start before its sender, and when idle it checks whether a
+ * restarted sender has put a new ring file in place. A ring not owned by
+ * BRIDGE_SHM_UID (default: this user), or that others could write to or
+ * read outside the BRIDGE_SHM_GID group, is refused. Single consumer.
+ */
+class ShmRingReceiver : public BridgeReceiver {
+  public:
+    explicit ShmRingReceiver(int port) : path(shm_ring_path(port)) {}
+    ~ShmRingReceiver() override;
+
+    ShmRingReceiver(const ShmRingReceiver &) = delete;
+    ShmRingReceiver &operator=(const ShmRingReceiver &) = delete;
+
+    int Initialize() override;
+    int Fd() const override { return -1; }
+    int Receive(char buffer[], size_t len) override;
+    void Interrupt() override;
+
+    /** @brief Messages lost to the sender lapping this receiver */
+    uint64_t Dropped() const { return dropped; }
+
+  private:
+    bool Attach(bool from_oldest);
+    void Detach();
+
+    std::string path;
+    void *map = nullptr;
+    size_t map_size = 0;
+    const ShmRingHeader *header = nullptr;
+    const ShmRingSlot *slots = nullptr;
+    ino_t inode = 0;   // of the mapped ring file
+    ino_t refused = 0; // last file refused, so it is only logged once
+    uint64_t next = 0;
+    uint64_t dropped = 0;
+    std::atomic<bool> interrupted{false};
+    // Bumped by Interrupt(); Receive() waits on it next to the doorbell.
+    std::atomic<uint32_t> interrupt_seq{0};
+    // The attached ring's doorbell, for Interrupt() on another thread.
+    std::atomic<const std::atomic<uint32_t> *> bell{nullptr};
+};
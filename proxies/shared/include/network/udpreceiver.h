@@ -20,11 +20,12 @@
 
 #pragma once
 
+#include "bridge_transport.h"
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <string>
 
-class UDPReceiver {
+class UDPReceiver : public BridgeReceiver {
   private:
     std::string host;
     int port;
@@ -36,17 +37,22 @@ class UDPReceiver {
     /**
      * @brief Closes the socket
      */
-    ~UDPReceiver();
+    ~UDPReceiver() override;
 
     /**
      * @brief Opens the socket to receive on
      * @return 0 on success, nonzero on failure
      */
-    int Initialize();
+    int Initialize() override;
+
+    /**
+     * @brief The socket, for callers that poll() it alongside other fds
+     */
+    int Fd() const override { return sock_fd; }
 
     /**
      * @brief Receive UDP messages in buffer
      * @return How many bytes were received
      */
-    int Receive(char buffer[], size_t len);
+    int Receive(char buffer[], size_t len) override;
 };
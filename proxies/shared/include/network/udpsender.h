@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "bridge_transport.h"
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <string>
@@ -27,7 +28,7 @@
 /**
  * @brief Simple UDP sender implementation
  */
-class UDPSender {
+class UDPSender : public BridgeSender {
   private:
     std::string host;
     int port;
@@ -40,17 +41,17 @@ class UDPSender {
     /**
      * @brief Closes the socket
      */
-    ~UDPSender();
+    ~UDPSender() override;
 
     /**
      * @brief Opens the socket to send to
      * @return 0 on success, nonzero on failure
      */
-    int Initialize();
+    int Initialize() override;
 
     /**
      * @brief Sends all bytes in buffer
      * @return How many bytes were sent
      */
-    ssize_t Send(const char *buffer, size_t len);
+    ssize_t Send(const char *buffer, size_t len) override;
 };
@@ -0,0 +1,123 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "opcode_parser_core.h"
+#include <cstddef>
+#include <tuple>
+
+/*
+ * @brief Base for one stage of an InstructionPipeline: the hooks it may
+ * declare, with pass-through defaults.
+ *
+ * An observer only watches (returns true) or is an excision policy: returning
+ * false from OnInstructionBegin/OnInstructionEnd denies the instruction, and the
+ * pipeline cuts it out of the buffer. Elements are spans valid only during the
+ * hook (see GuacElement). The hooks are not virtual: the pipeline knows each
+ * observer's type and calls (and can inline) them directly.
+ */
+class InstructionObserver {
+  public:
+    bool OnInstructionBegin(const GuacElement &instr) { return true; }
+    bool OnArgument(const GuacElement &arg) { return true; }
+    bool OnInstructionEnd() { return true; }
+};
+
+/*
+ * @brief Frames a stream once and drives several observers from that one pass.
+ *
+ * Each hook of the framer is fanned out to the observers in the order they are
+ * listed, so N filters on the same hop cost one FSM pass instead of N. An
+ * instruction is denied when any observer denies it; the framer then skips the
+ * rest of it, so observers do not see the remaining arguments of an instruction
+ * that will not leave this hop.
+ *
+ * Oversized elements are tolerated: a pipeline filters traffic, it does not
+ * gate it (the guard does).
+ */
+template <typename... Observers>
+class InstructionPipeline
+    : public OpcodeParserCore<InstructionPipeline<Observers...>> {
+  public:
+    /*
+     * @brief A pipeline over the given observers (not owned; must outlive it)
+     */
+    explicit InstructionPipeline(Observers &...observers)
+        : observers(observers...) {}
+
+    /*
+     * @brief Frames `data` for every observer and excises the instructions
+     * they denied, in place.
+     *
+     * Fails open: a chunk that cannot be framed (e.g. an excised instruction
+     * split across reads) is left untouched for the next hop to judge. The
+     * framer resyncs after the offending byte, so the observers still see the
+     * rest of the chunk and later chunks are handled again.
+     *
+     * @param data: buffer to filter in place
+     * @param len: its length; reduced by the excised bytes
+     * @return false when the chunk could not be framed and was left untouched
+     */
+    bool Run(char *data, size_t &len) {
+        if (this->Parse(data, len) != ParserState::STREAM_CORRUPTED) {
+            this->Excise(data, len); // a no-op when nothing was denied
+            return true;
+        }
+        // Leave the chunk as it is, but keep observing what follows the bad
+        // byte.
+        size_t off = this->CurrentIndex() + 1;
+        this->Reset();
+        while (off < len) {
+            if (this->Parse(data + off, len - off) !=
+                ParserState::STREAM_CORRUPTED)
+                break;
+            off += this->CurrentIndex() + 1;
+            this->Reset();
+        }
+        return false;
+    }
+
+  private:
+    friend class OpcodeParserCore<InstructionPipeline<Observers...>>;
+
+    // Every observer sees each hook, even after an earlier one denied the
+    // instruction (`&`, not `&&`), so each can reset its per-instruction state.
+    bool OnInstructionBegin(const GuacElement &instr) {
+        return std::apply(
+            [&](auto &...o) {
+                return (true & ... & o.OnInstructionBegin(instr));
+            },
+            observers);
+    }
+    bool OnArgument(const GuacElement &arg) {
+        return std::apply(
+            [&](auto &...o) { return (true & ... & o.OnArgument(arg)); },
+            observers);
+    }
+    bool OnInstructionEnd() {
+        return std::apply(
+            [](auto &...o) { return (true & ... & o.OnInstructionEnd()); },
+            observers);
+    }
+    bool ToleratesOversizedElements() { return true; }
+
+    std::tuple<Observers &...> observers;
+};
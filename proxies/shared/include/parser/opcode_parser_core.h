@@ -0,0 +1,752 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Bound on an element's declared length, in Unicode code points (the unit
+// Guacamole lengths are expressed in).
+#define MAX_ELEMENT_SIZE 8192
+
+// Bytes needed to buffer MAX_ELEMENT_SIZE code points of UTF-8 (at most 4 each).
+#define MAX_ELEMENT_BYTES (4 * MAX_ELEMENT_SIZE)
+
+/*
+ * @brief Every state of the opcode-parsing FSM.
+ *
+ * The single state captures where in an
+ * element the parser sits. Each byte advances exactly
+ * one state. READING_LENGTH for reading element length,
+ * READING_DATA is for reading data after the .-character
+ * (only if the length is valid). STREAM_CORRUPTED occurs
+ * when the parser received non-Guacamole data, or the Guacamole
+ * data had an invalid format (not <length>.<value><, or ;>)
+ * and DENIED_DATA occurs when an opcode or argument is disallowed.
+ * Disallowing an opcode is not functionality of the core parser, but
+ * left for GuardOpcodeParser (which does the filtering).
+ */
+enum class ParserState : uint8_t {
+    READING_LENGTH,   // reading the digits of an element's length prefix
+    READING_DATA,     // reading the value bytes
+    EXPECT_DELIM,     // expecting ',' or ';' to close the element
+    STREAM_CORRUPTED, // unparseable byte: the stream can no longer be trusted
+    DENIED_DATA       // a disallowed opcode or argument value
+};
+
+/*
+ * @brief An element as the hooks see it: `len` is its size in bytes (UTF-8),
+ * which equals its declared length only for ASCII content.
+ *
+ * A span, not a copy: `ptr` points into the buffer given to Parse() (or into
+ * the parser's staging buffer for an element split across calls), so it is
+ * only valid during the hook. A hook that needs the value later copies it.
+ */
+struct GuacElement {
+    uint32_t len;
+    const char *ptr;
+
+    std::string_view View() const { return std::string_view(ptr, len); }
+};
+
+/*
+ * @brief Characters an element value may contain (see ElementCharset()).
+ */
+enum class Charset {
+    ASCII, // bytes 0-127 only; anything else corrupts the stream
+    UTF8   // well-formed UTF-8; lengths count code points
+};
+
+/*
+ * @brief Everything the framer carries from one Parse() call to the next.
+ *
+ * Kept apart from the parser so that one parser can frame many streams in turn
+ * (see OpcodeParserCore::Frame()): gmguard keeps one of these per channel
+ * instead of a whole parser. An element split across calls is staged in a
+ * buffer borrowed for just that long (see AcquireStaging()), so the state
+ * itself stays a few dozen bytes.
+ */
+struct FrameState {
+    // Declared length (code points) of the value being parsed. 64-bit because a
+    // tolerated oversized element (see ToleratesOversizedElements) can be far
+    // larger than the buffer, and the true length is needed to know where the
+    // element ends.
+    long long current_length = -1;
+
+    // Number of value code points read so far (counts the whole element, even
+    // when only the first MAX_ELEMENT_SIZE are buffered).
+    long long current_read = 0;
+
+    // The first bytes of an element split across calls, or nullptr when none is
+    // staged.
+    char *staging = nullptr;
+
+    // Bytes of the current element's view (its first MAX_ELEMENT_SIZE code
+    // points).
+    uint32_t element_len = 0;
+
+    ParserState state = ParserState::READING_LENGTH;
+    bool reading_opcode = true;
+
+    // A multi-byte UTF-8 sequence split across bytes (or Parse() calls): the
+    // continuation bytes still expected, the valid range of the next one (it
+    // is narrower right after some leads, to reject overlongs and surrogates),
+    // and whether the sequence's bytes are being buffered.
+    uint8_t utf8_pending = 0;
+    uint8_t utf8_next_lo = 0x80;
+    uint8_t utf8_next_hi = 0xBF;
+    bool utf8_storing = false;
+
+    // SkipInstruction() is in effect until the current instruction's ';'.
+    bool skipping = false;
+    bool skip_ascii = false;
+};
+
+/*
+ * @brief Bulk scanners over element data, picked once per process for the
+ * widest SIMD the CPU supports (see opcode_parser.cpp).
+ */
+namespace element_scan {
+
+/*
+ * @brief Bytes and code points consumed by one bulk step over element data
+ */
+struct CharRun {
+    size_t bytes;
+    long long chars;
+};
+
+// Copies ASCII bytes from src to dst until the first non-ASCII byte and
+// returns their count; `dst` may be null to only validate.
+size_t copy_ascii(char *dst, const char *src, size_t n);
+
+// Up to max_chars ASCII bytes (one code point each).
+CharRun ascii_run(char *dst, const char *src, size_t n, long long max_chars);
+
+// Whole blocks of valid UTF-8 of at most max_chars code points.
+CharRun utf8_run(char *dst, const char *src, size_t n, long long max_chars);
+
+// Counts max_chars code points by their lead bytes, validating nothing.
+CharRun skip_chars(const char *src, size_t n, long long max_chars);
+
+/*
+ * @brief Decodes a UTF-8 lead byte: the continuation bytes it needs and the
+ * valid range of the first one (narrowed to reject overlongs, surrogates and
+ * code points above U+10FFFF).
+ * @return false if the byte cannot start a sequence
+ */
+inline bool utf8_lead(unsigned char b, uint8_t &need, uint8_t &lo,
+                      uint8_t &hi) {
+    lo = 0x80;
+    hi = 0xBF;
+    if (b >= 0xC2 && b <= 0xDF) {
+        need = 1;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+        need = 2;
+        if (b == 0xE0)
+            lo = 0xA0; // overlong
+        else if (b == 0xED)
+            hi = 0x9F; // surrogates
+    } else if (b >= 0xF0 && b <= 0xF4) {
+        need = 3;
+        if (b == 0xF0)
+            lo = 0x90; // overlong
+        else if (b == 0xF4)
+            hi = 0x8F; // above U+10FFFF
+    } else {
+        return false; // continuation, 0xC0/0xC1 overlong or 0xF5+
+    }
+    return true;
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+} // namespace element_scan
+
+/*
+ * @brief The Guacamole framer, with its hooks bound at compile time (CRTP).
+ *
+ * A parser derives as `class P : public OpcodeParserCore<P>` and declares the
+ * hooks it needs (below, with their defaults) as plain member functions; the
+ * core calls them on the derived type, so they are inlined into the FSM
+ * instead of dispatched through a vtable once per element or length digit.
+ * Hooks may be private if the parser befriends OpcodeParserCore<P>. A parser
+ * with out-of-line hooks instantiates its core once in its own translation
+ * unit (`template class OpcodeParserCore<P>;`, with an `extern template` next
+ * to the class), where the hook bodies are visible.
+ *
+ * OpcodeParser (opcode_parser.h) is the same core with virtual hooks.
+ */
+template <typename Derived> class OpcodeParserCore {
+  public:
+
+    ParserState GetState() { return derived().Frame().state; };
+
+    /*
+     * @brief Analyses Guacamole traffic and checks it is valid and allowed.
+     *
+     * Pure analysis: the buffer is never modified. When an instruction is
+     * disallowed the parser records the byte range it occupies (so the caller
+     * can drop it with Excise) and keeps analysing the rest. The return value is
+     * DENIED_DATA when at least one instruction was denied and the rest parsed
+     * cleanly; STREAM_CORRUPTED when the stream can no longer be trusted;
+     * otherwise the resting FSM state.
+     *
+     * @param data: buffer to parse (read-only)
+     * @param len: length of the payload
+     * @return the state of the parser after parsing
+     */
+    ParserState Parse(const char *data, size_t len);
+
+    /*
+     * @brief Removes the instructions the last Parse() denied from a buffer.
+     *
+     * The caller passes the same buffer/length it gave the matching Parse()
+     * call; the denied byte ranges are shifted out in place and `len` is reduced
+     * accordingly. This is the only mutation path — Parse() itself never writes
+     * to the buffer. A no-op when the last Parse() denied nothing.
+     *
+     * @param data: send buffer to compact in place
+     * @param len: length of the buffer; reduced by the excised bytes
+     */
+    void Excise(char *data, size_t &len);
+
+    /*
+     * @brief Resets the framing state to a clean instruction boundary.
+     *
+     * Clears the FSM, the in-flight element, and any recorded denied ranges so
+     * the next Parse() starts fresh — e.g. to recover (fail open) after a
+     * STREAM_CORRUPTED.
+     */
+    void Reset();
+
+  protected:
+    /*
+     * @brief Called whenever an instruction (opcode) is received by the parser
+     *
+     * The core is a neutral Guacamole framer and allows every opcode; the
+     * opcode allowlist is a guard policy and lives in `GuardOpcodeParser`. A
+     * parser declares its own to reject an instruction (the core then records
+     * its byte range for excision).
+     *
+     * @param instr: the struct containing the opcode
+     * @return Whether or not an instruction is allowed
+     */
+    bool OnInstructionBegin(const GuacElement &instr) { return true; }
+
+    /*
+     * @brief Policy for an element whose declared length exceeds the element
+     * buffer (MAX_ELEMENT_SIZE).
+     *
+     * The default treats an oversized element as untrustworthy — the guard's
+     * behaviour: STREAM_CORRUPTED. A parser that legitimately sees large
+     * elements — e.g. gcdbroker scanning guacd's drawing output — overrides this
+     * to return true; the parser then buffers only the first MAX_ELEMENT_SIZE
+     * bytes (so the hooks see a clamped element) and frames past the rest.
+     *
+     * @return true to tolerate (skip the surplus of) oversized elements, false
+     *         to corrupt the stream.
+     */
+    bool ToleratesOversizedElements() { return false; }
+
+    /*
+     * @brief Policy for the characters an element value may contain.
+     *
+     * Guacamole lengths count Unicode code points, so by default values are
+     * validated as UTF-8 and framed by code point: non-ASCII clipboard text,
+     * usernames or window titles frame correctly, and malformed UTF-8 (an
+     * overlong form, a surrogate, a stray continuation byte) corrupts the
+     * stream. A parser returns Charset::ASCII to reject every byte above 127
+     * instead. Consulted whenever element data reaches a non-ASCII byte.
+     */
+    Charset ElementCharset() const { return Charset::UTF8; }
+
+    /*
+     * @brief Called whenever an argument is received by the parser
+     * @param arg: the struct containing the argument
+     * @return Whether or not the argument is valid
+     */
+    bool OnArgument(const GuacElement &arg) { return true; }
+
+    /*
+     * @brief Called whenever the instruction (opcode) has finished parsing
+     *
+     * Not called for an instruction already denied by an earlier hook.
+     *
+     * @return false to deny the whole instruction, as OnInstructionBegin would
+     */
+    bool OnInstructionEnd() { return true; }
+
+    /*
+     * @brief Skip-ahead: the rest of the current instruction is of no interest.
+     *
+     * For observers that only care about some opcodes (e.g. SyncFaker on
+     * guacd's output). Called from OnInstructionBegin or OnArgument; the parser
+     * then frames past the instruction's remaining elements without validating,
+     * keeping or showing them — neither OnArgument nor OnInstructionEnd is
+     * called for it. Lengths count code points, so a skipped element is framed
+     * by counting its UTF-8 lead bytes, in SIMD blocks.
+     *
+     * With `ascii`, the caller vouches that the remaining elements are ASCII
+     * (e.g. base64 blob data): each declared length is then a byte count and
+     * the element is jumped over without being read, so its cost no longer
+     * depends on its size. The byte after it must be a delimiter, or the stream
+     * is corrupted.
+     */
+    void SkipInstruction(bool ascii = false) {
+        FrameState &f = derived().Frame();
+        f.skipping = true;
+        f.skip_ascii = ascii;
+    }
+
+    /*
+     * @brief Index, within the current Parse() buffer, of the byte being
+     * processed. Valid inside the OnInstructionBegin/End and OnArgument hooks,
+     * e.g. to find where the terminating delimiter of an instruction sits.
+     */
+    size_t CurrentIndex() const { return current_index; }
+
+    /*
+     * @brief The stream state Parse() resumes from and leaves behind.
+     *
+     * By default the parser's own. A parser that frames many streams in turn
+     * returns the one it is currently working on, and must not switch while a
+     * Parse() is running.
+     */
+    FrameState &Frame() { return own_frame; }
+
+    /*
+     * @brief Lends a MAX_ELEMENT_BYTES buffer to stage an element that is split
+     * across Parse() calls; it is handed back through ReleaseStaging() once the
+     * element is complete (or on Reset()).
+     *
+     * The default allocates one buffer on first use and lends it out each time.
+     * A parser with many streams lends from a shared pool instead, so only the
+     * streams that are mid-element hold one.
+     */
+    char *AcquireStaging() {
+        if (!own_staging)
+            own_staging.reset(new char[MAX_ELEMENT_BYTES]);
+        return own_staging.get();
+    }
+    void ReleaseStaging(char *staging) {}
+
+  private:
+    Derived &derived() { return static_cast<Derived &>(*this); }
+
+    /*
+     * @brief Slow path of READING_DATA: consumes element data from data[j] one
+     * code point (or validated run) at a time, once the ASCII fast path in
+     * Parse() has stopped on a non-ASCII byte or a split sequence.
+     * @return false on a byte that is not allowed; j is then its index
+     */
+    bool ReadElementData(const char *data, size_t len, size_t &j);
+
+    // Appends one byte to the current element's view: staged only when the
+    // element is split across calls, otherwise it already sits in `data`.
+    void Keep(FrameState &f, char c) {
+        if (!element_ptr)
+            f.staging[f.element_len] = c;
+        ++f.element_len;
+    }
+
+    // Hands a staged element's buffer back once the element is done with.
+    void DropStaging(FrameState &f) {
+        if (f.staging) {
+            derived().ReleaseStaging(f.staging);
+            f.staging = nullptr;
+        }
+    }
+
+    FrameState own_frame;
+    std::unique_ptr<char[]> own_staging;
+
+    // Index of the byte currently being processed in Parse()
+    size_t current_index = 0;
+
+    // Start of the current element's view in the caller's buffer while the
+    // element started in this Parse() call (nothing is copied); nullptr once a
+    // call has ended inside it and staged what it had in FrameState::staging.
+    const char *element_ptr = nullptr;
+
+    // Start index (within the current Parse() buffer) of the instruction
+    // currently being parsed, so its full range can be recorded when denied.
+    size_t opcode_start_idx = 0;
+
+    // Byte ranges [start, length) of the instructions the last Parse() denied,
+    // in ascending order. Populated by Parse(), consumed and cleared by Excise().
+    std::vector<std::pair<size_t, size_t>> denied_ranges;
+};
+
+template <typename Derived>
+ParserState OpcodeParserCore<Derived>::Parse(const char *data, size_t len) {
+    FrameState &f = derived().Frame();
+
+    // Ranges recorded here belong to this call's buffer only, and so does an
+    // element span.
+    denied_ranges.clear();
+    element_ptr = nullptr;
+
+    // `denying`: inside a disallowed instruction whose bytes are being skipped
+    // until its ';', then recorded for excision. 
+    bool denying = false;
+    
+    // `opcode_in_this_call`: the instruction currently being parsed started in
+    // this call, so opcode_start_idx is a valid index into `data` (a 
+    // prerequisite for cutting it out).
+    bool opcode_in_this_call = false;
+
+    // Each byte drives exactly one state. Runs of length digits and of element
+    // data are consumed in bulk within their state, leaving `i` on the last
+    // byte of the run.
+    for (size_t i = 0; i < len; ++i) {
+        current_index = i;
+        char c = data[i];
+
+        switch (f.state) {
+        case ParserState::READING_LENGTH:
+            // If character is a digit
+            if (element_scan::is_digit(c)) {
+                if (f.current_length == -1) {
+                    f.current_length = 0;
+                    // First digit of a new element. If it is the opcode, record
+                    // where this instruction starts in the buffer.
+                    if (f.reading_opcode) {
+                        opcode_start_idx = i;
+                        opcode_in_this_call = true;
+                    }
+                }
+                // Consume the whole run of digits here rather than one loop
+                // turn (and state dispatch) per digit.
+                for (;;) {
+                    // add the digit to the current length (as an integer!)
+                    f.current_length = f.current_length * 10 + (data[i] - '0');
+
+                    // Observed length exceeds the buffer. By default that is an
+                    // untrustworthy stream (the guard); a parser that tolerates
+                    // large elements keeps framing and just buffers the first
+                    // MAX_ELEMENT_SIZE code points for the hooks.
+                    if (f.current_length > MAX_ELEMENT_SIZE &&
+                        !derived().ToleratesOversizedElements()) {
+                        current_index = i;
+                        f.state = ParserState::STREAM_CORRUPTED;
+                        return f.state;
+                    }
+                    if (i + 1 == len || !element_scan::is_digit(data[i + 1]))
+                        break;
+                    ++i;
+                }
+                current_index = i;
+            } else if (c == '.') {
+                // The '.' closes the length: decide the next branch from it
+                // (folds in the diagram's READING_DOT).
+                if (f.current_length == -1) {
+                    // No length calculated before the dot
+                    f.state = ParserState::STREAM_CORRUPTED;
+                    return f.state;
+                }
+                f.current_read = 0;
+                f.element_len = 0;
+                element_ptr = data + i + 1;
+                if (f.current_length == 0)
+                    f.state = ParserState::EXPECT_DELIM;
+                else
+                    f.state = ParserState::READING_DATA;
+            } else {
+                // This is not a digit or length-terminating character
+                f.state = ParserState::STREAM_CORRUPTED;
+                return f.state;
+            }
+            break;
+
+        case ParserState::READING_DATA: {
+            if (f.skipping) {
+                // Skip-ahead (SkipInstruction()): frame past the element without
+                // validating, keeping or showing it.
+                size_t j;
+                if (f.skip_ascii) {
+                    // Declared length = bytes: jump, don't read.
+                    long long n = std::min<long long>(
+                        f.current_length - f.current_read,
+                        static_cast<long long>(len - i));
+                    f.current_read += n;
+                    j = i + static_cast<size_t>(n);
+                    if (f.current_read == f.current_length)
+                        f.state = ParserState::EXPECT_DELIM;
+                } else {
+                    element_scan::CharRun run = element_scan::skip_chars(
+                        data + i, len - i, f.current_length - f.current_read);
+                    f.current_read += run.chars;
+                    j = i + run.bytes;
+                    if (j < len) // stopped on the byte after the element
+                        f.state = ParserState::EXPECT_DELIM;
+                }
+                i = j - 1; // the loop's ++i steps past the run
+                current_index = i;
+                break;
+            }
+
+            // Bulk path: the element's remaining length is known, so take as
+            // much of it as this buffer holds in one go. Lengths count code
+            // points; an ASCII run (nearly all traffic) is one code point per
+            // byte and is handled here, anything else goes through
+            // ReadElementData(). The hooks see only the first MAX_ELEMENT_SIZE
+            // code points; the surplus of a tolerated oversized element is
+            // validated and counted (to find its end) but not kept.
+            //
+            // An element that starts in this call is left where it is: its bytes
+            // are only validated, and the hooks get a span into `data`. Only an
+            // element split across calls is staged in element_buffer.
+            size_t j = i;
+            if (f.utf8_pending == 0) {
+                size_t run = static_cast<size_t>(
+                    std::min<long long>(f.current_length - f.current_read,
+                                        static_cast<long long>(len - i)));
+                bool storing = f.current_read < MAX_ELEMENT_SIZE;
+                size_t take =
+                    storing ? std::min<size_t>(
+                                  run, static_cast<size_t>(MAX_ELEMENT_SIZE -
+                                                           f.current_read))
+                            : run;
+                size_t copied = element_scan::copy_ascii(
+                    storing && !element_ptr
+                        ? f.staging + f.element_len
+                        : nullptr,
+                    data + i, take);
+                if (storing)
+                    f.element_len += static_cast<uint32_t>(copied);
+                f.current_read += static_cast<long long>(copied);
+                j += copied;
+            }
+            if (f.current_read != f.current_length || f.utf8_pending != 0) {
+                if (!ReadElementData(data, len, j)) {
+                    current_index = j; // the offending byte
+                    f.state = ParserState::STREAM_CORRUPTED;
+                    return f.state;
+                }
+            }
+            i = j - 1; // the loop's ++i steps past the run
+            current_index = i;
+
+            // current_read has advanced to the observed length (and the last
+            // code point is complete)
+            if (f.current_read == f.current_length && f.utf8_pending == 0)
+                f.state = ParserState::EXPECT_DELIM;
+            break;
+        }
+
+        case ParserState::EXPECT_DELIM: {
+            // c must be the ',' or ';' that closes the element just read
+            // (folds in the diagram's HANDLING_ELEMENT). While
+            // `denying`, validation is skipped — we only parse far enough to
+            // find the instruction's ';' so its whole range can be recorded.
+            if (c != ',' && c != ';') {
+                // This is not a valid delimiter
+                f.state = ParserState::STREAM_CORRUPTED;
+                return f.state;
+            }
+
+            if (!denying && !f.skipping) {
+                // For a tolerated oversized element only the first
+                // MAX_ELEMENT_SIZE code points were kept, so the hook sees a
+                // clamped view.
+                GuacElement elem{f.element_len,
+                                 element_ptr ? element_ptr : f.staging};
+                bool allowed = f.reading_opcode
+                                   ? derived().OnInstructionBegin(elem)
+                                   : derived().OnArgument(elem);
+                DropStaging(f);
+                if (!allowed) {
+                    // Deny the whole instruction — but only if it started in
+                    // this call. If its head arrived in an earlier datagram it
+                    // was already forwarded, so we cannot recover and the stream
+                    // is corrupted.
+                    if (!opcode_in_this_call) {
+                        f.state = ParserState::STREAM_CORRUPTED;
+                        return f.state;
+                    }
+                    denying = true;
+                    f.reading_opcode = false; // skip the remainder as data
+                } else if (f.reading_opcode) {
+                    f.reading_opcode = false;
+                }
+            }
+
+            if (c == ';') {
+                // End of instruction.
+                if (!denying && !f.skipping && !derived().OnInstructionEnd()) {
+                    // Rejected as a whole only now (e.g. too few arguments).
+                    // Like any denial it must have started in this call.
+                    if (!opcode_in_this_call) {
+                        f.state = ParserState::STREAM_CORRUPTED;
+                        return f.state;
+                    }
+                    denying = true;
+                }
+                if (denying) {
+                    // Record its full byte range so the caller can excise it.
+                    // Parse() never mutates data.
+                    denied_ranges.emplace_back(opcode_start_idx,
+                                               i - opcode_start_idx + 1);
+                    denying = false;
+                }
+                f.skipping = false;
+                f.reading_opcode = true;
+            }
+            // Comma or semicolon: another element/instruction follows
+            f.current_length = -1;
+            f.state = ParserState::READING_LENGTH;
+            break;
+        }
+
+        case ParserState::STREAM_CORRUPTED:
+        case ParserState::DENIED_DATA:
+            // Terminal for this call; nothing more is parsed.
+            return f.state;
+        }
+    }
+
+    // A denied instruction that never reached its ';' cannot be cut cleanly
+    // across datagrams (its head would already be forwarded): corrupt the stream.
+    if (denying) {
+        f.state = ParserState::STREAM_CORRUPTED;
+        return f.state;
+    }
+
+    // An element still open at the end of this buffer continues in the next
+    // call (or waits there for its delimiter): stage what this call held of it,
+    // since `data` is gone by then. A skipped element keeps nothing, and an
+    // empty one awaiting its delimiter needs no buffer.
+    if (element_ptr && !f.skipping &&
+        (f.state == ParserState::READING_DATA ||
+         (f.state == ParserState::EXPECT_DELIM && f.element_len > 0))) {
+        f.staging = derived().AcquireStaging();
+        std::memcpy(f.staging, element_ptr, f.element_len);
+        element_ptr = nullptr;
+    }
+
+    // The FrameState persists across calls, so a Parse() that ends mid-element
+    // resumes correctly. A clean boundary rests at READING_LENGTH with
+    // current_length == -1. Report DENIED_DATA when content was denied but the
+    // rest parsed cleanly, so the caller calls Excise(); the frame's `state`
+    // still holds the true resting state for the next call.
+    if (!denied_ranges.empty())
+        return ParserState::DENIED_DATA;
+    return f.state;
+}
+
+template <typename Derived>
+void OpcodeParserCore<Derived>::Excise(char *data, size_t &len) {
+    if (denied_ranges.empty())
+        return;
+
+    // Single compaction pass: copy the kept bytes between the denied ranges
+    // (which are ascending and non-overlapping) down over the gaps.
+    size_t write = 0;
+    size_t read = 0;
+    for (const auto &range : denied_ranges) {
+        size_t keep = range.first - read; // bytes before this denied range
+        if (write != read)
+            std::memmove(data + write, data + read, keep);
+        write += keep;
+        read = range.first + range.second; // skip past the denied range
+    }
+    if (write != read)
+        std::memmove(data + write, data + read, len - read);
+    len = write + (len - read);
+
+    denied_ranges.clear();
+}
+
+template <typename Derived>
+bool OpcodeParserCore<Derived>::ReadElementData(const char *data, size_t len,
+                                                size_t &j) {
+    FrameState &f = derived().Frame();
+    while (j < len) {
+        if (f.utf8_pending > 0) {
+            // Continuation byte of a multi-byte sequence.
+            unsigned char b = static_cast<unsigned char>(data[j]);
+            if (b < f.utf8_next_lo || b > f.utf8_next_hi)
+                return false;
+            if (f.utf8_storing)
+                Keep(f, data[j]);
+            f.utf8_next_lo = 0x80;
+            f.utf8_next_hi = 0xBF;
+            --f.utf8_pending;
+            ++j;
+            continue;
+        }
+        long long remaining = f.current_length - f.current_read;
+        if (remaining == 0)
+            break;
+
+        bool storing = f.current_read < MAX_ELEMENT_SIZE;
+        long long limit =
+            storing ? std::min<long long>(remaining,
+                                          MAX_ELEMENT_SIZE - f.current_read)
+                    : remaining;
+        char *dst = storing && !element_ptr
+                        ? f.staging + f.element_len
+                        : nullptr;
+        element_scan::CharRun run =
+            element_scan::ascii_run(dst, data + j, len - j, limit);
+        if (run.bytes == 0 && derived().ElementCharset() == Charset::UTF8)
+            run = element_scan::utf8_run(dst, data + j, len - j, limit);
+        if (run.bytes > 0) {
+            j += run.bytes;
+            f.current_read += run.chars;
+            if (storing)
+                f.element_len += static_cast<uint32_t>(run.bytes);
+            continue;
+        }
+
+        // data[j] is not ASCII: only a valid UTF-8 lead may follow.
+        uint8_t need;
+        if (derived().ElementCharset() != Charset::UTF8 ||
+            !element_scan::utf8_lead(static_cast<unsigned char>(data[j]), need,
+                                     f.utf8_next_lo, f.utf8_next_hi))
+            return false;
+        f.utf8_pending = need;
+        f.utf8_storing = storing;
+        if (storing)
+            Keep(f, data[j]);
+        ++f.current_read;
+        ++j;
+    }
+    return true;
+}
+
+template <typename Derived>
+void OpcodeParserCore<Derived>::Reset() {
+    FrameState &f = derived().Frame();
+    DropStaging(f);
+    f = FrameState();
+    current_index = 0;
+    element_ptr = nullptr;
+    opcode_start_idx = 0;
+    denied_ranges.clear();
+}
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string_view>
 
 /**
  * @brief Shared clipboard-cap constants.
@@ -35,4 +36,19 @@ namespace clipboard {
 constexpr uint32_t MAX_INPUT_BYTES = 50;
 // Payload arrives base64-encoded (~33% larger), so this is the on-wire cap.
 constexpr uint32_t MAX_BYTES = static_cast<uint32_t>(MAX_INPUT_BYTES * 1.33f);
+
+// The opcodes of a clipboard stream, as the guard and gmlbroker track them.
+enum class StreamOpcode : uint8_t { OTHER, CLIPBOARD, BLOB, END };
+
+// Classifies an opcode once at the start of an instruction, so its arguments
+// can be handled without keeping a copy of the opcode.
+inline StreamOpcode stream_opcode(std::string_view opcode) {
+    if (opcode == "blob")
+        return StreamOpcode::BLOB;
+    if (opcode == "clipboard")
+        return StreamOpcode::CLIPBOARD;
+    if (opcode == "end")
+        return StreamOpcode::END;
+    return StreamOpcode::OTHER;
+}
 } // namespace clipboard
@@ -0,0 +1,124 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Epoch-based reclamation for objects published through atomic pointers.
+ *
+ * Lets a few long-lived hot-path threads (e.g. the return-path router) read a
+ * shared pointer without taking a lock, while a teardown thread unpublishes and
+ * frees the object once no reader can still hold it.
+ *
+ * Each reader thread registers once and gets its own counter. It brackets every
+ * use of a published pointer with a Guard: the counter is odd inside the Guard
+ * and even outside, so a reader blocked elsewhere (e.g. waiting on its queue)
+ * never holds up reclamation. A writer first unpublishes the pointer (stores
+ * nullptr), then calls Synchronize(), which returns once every reader that was
+ * inside a Guard at that moment has left it; after that the object can be freed.
+ *
+ * All counter and pointer accesses are sequentially consistent on purpose: the
+ * reader's "enter, then load the pointer" and the writer's "unpublish, then read
+ * the counters" must not be reordered against each other.
+ */
+class EpochDomain {
+  public:
+    // Upper bound on registered reader threads; each costs one cache line.
+    static constexpr int MAX_READERS = 64;
+
+    EpochDomain() {
+        for (auto &slot : readers)
+            slot.epoch.store(0);
+    }
+
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    /**
+     * @brief Registers a reader thread
+     *
+     * Readers are a fixed set of long-lived threads known at startup, so
+     * running out of slots is a configuration bug: it aborts rather than hand
+     * back a slot no Guard could use.
+     * @return The reader's slot, to pass to Guard
+     */
+    int Register() {
+        int slot = registered.fetch_add(1);
+        if (slot >= MAX_READERS) {
+            std::cerr << "EpochDomain: more than " << MAX_READERS
+                      << " reader threads registered" << std::endl;
+            std::abort();
+        }
+        return slot;
+    }
+
+    /**
+     * @brief RAII read-side critical section for one registered reader.
+     *
+     * Pointers loaded from the protected slots stay valid until the Guard is
+     * destroyed. Guards of the same reader must not nest. @p slot is one
+     * Register() returned.
+     */
+    class Guard {
+      public:
+        Guard(EpochDomain &domain, int slot)
+            : epoch(domain.readers[slot].epoch) {
+            epoch.fetch_add(1); // odd: inside
+        }
+        ~Guard() { epoch.fetch_add(1); } // even: quiescent
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+      private:
+        std::atomic<uint64_t> &epoch;
+    };
+
+    /**
+     * @brief Waits until every reader that was inside a Guard when this was
+     * called has left it. Call after unpublishing, before freeing.
+     */
+    void Synchronize() {
+        int count = registered.load();
+        if (count > MAX_READERS)
+            count = MAX_READERS;
+        for (int i = 0; i < count; ++i) {
+            uint64_t seen = readers[i].epoch.load();
+            if ((seen & 1) == 0)
+                continue; // quiescent
+            // Inside a critical section: wait for it to move on. Any later
+            // section started after our unpublish and cannot see the object.
+            while (readers[i].epoch.load() == seen)
+                std::this_thread::yield();
+        }
+    }
+
+  private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch;
+    };
+    ReaderSlot readers[MAX_READERS];
+    std::atomic<int> registered{0};
+};
@@ -0,0 +1,97 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief A lock-free latency histogram with power-of-two microsecond buckets.
+ *
+ * Bucket b counts samples in [2^(b-1), 2^b) µs (bucket 0 is "under 1 µs"), so
+ * 32 buckets span up to about 36 minutes at a relative resolution of 2x, which
+ * is plenty to tell a 1 ms step from a 1 s stall. Record() is a couple of
+ * relaxed atomic adds, safe from any thread; readers see a close-enough
+ * snapshot.
+ */
+class LatencyHistogram {
+  public:
+    static constexpr int BUCKETS = 32;
+
+    /**
+     * @brief Adds one sample
+     */
+    void Record(uint64_t micros) {
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && micros >= (1ULL << bucket))
+            ++bucket;
+        counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (micros > seen &&
+               !max.compare_exchange_weak(seen, micros,
+                                          std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count() const { return total.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Upper bound (µs) of the bucket holding the given quantile
+     * @param q: the quantile, in (0, 1]
+     */
+    uint64_t Quantile(double q) const {
+        uint64_t n = Count();
+        if (n == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(n));
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+            seen += counts[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return 1ULL << bucket;
+        }
+        return Max();
+    }
+
+    uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief For a log line: "n=12 p50<=2048us p90<=4096us p99<=8192us
+     * max=5120us"
+     */
+    std::string Summary() const {
+        return "n=" + std::to_string(Count()) +
+               " p50<=" + std::to_string(Quantile(0.50)) + "us" +
+               " p90<=" + std::to_string(Quantile(0.90)) + "us" +
+               " p99<=" + std::to_string(Quantile(0.99)) + "us" +
+               " max=" + std::to_string(Max()) + "us";
+    }
+
+  private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max{0};
+};
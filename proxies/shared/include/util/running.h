@@ -25,6 +25,8 @@
 /*
  * @brief Process-wide run flag, cleared by the SIGINT handler.
  *
- * Defined in main.cpp; every handler loop polls it to know when to stop.
+ * Defined in running.cpp; every handler loop polls it to know when to stop.
+ * When several stages share a process (gdd-allinone) they share the flag, so
+ * one signal stops them all.
  */
 extern std::atomic<bool> running;
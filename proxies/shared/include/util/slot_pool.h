@@ -0,0 +1,111 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/**
+ * @brief A free list of fixed-size objects lent out and handed back.
+ *
+ * For state that only some of many owners need at a time (e.g. gmguard's
+ * per-channel staging buffers, held only while an element is split across
+ * datagrams): a slot is allocated the first time the pool runs dry and reused
+ * from then on, so up to `keep` slots the pool never allocates on the
+ * steady-state path. A returned slot keeps its old contents.
+ *
+ * A slot handed back while the pool holds more than `keep` is freed, so a
+ * burst (say, every channel left mid-element by a hostile peer) does not pin
+ * its peak for good once it is over.
+ *
+ * Not thread-safe: one pool per thread that uses it.
+ */
+template <typename T> class SlotPool {
+  public:
+    explicit SlotPool(size_t keep = SIZE_MAX) : keep(keep) {}
+    ~SlotPool() {
+        for (Slot *slot : slots)
+            Destroy(slot);
+    }
+    SlotPool(const SlotPool &) = delete;
+    SlotPool &operator=(const SlotPool &) = delete;
+
+    /**
+     * @brief Lends out a slot
+     */
+    T *Acquire() {
+        if (free.empty()) {
+            Slot *slot = new Slot;
+            new (slot->storage) T;
+            slot->index = slots.size();
+            slots.push_back(slot);
+            return slot->get();
+        }
+        Slot *slot = free.back();
+        free.pop_back();
+        return slot->get();
+    }
+
+    /**
+     * @brief Hands a slot from Acquire() back
+     */
+    void Release(T *object) {
+        // `storage` sits at a fixed offset in the standard-layout Slot.
+        Slot *slot = reinterpret_cast<Slot *>(
+            reinterpret_cast<unsigned char *>(object) - offsetof(Slot, storage));
+        if (slots.size() <= keep) {
+            free.push_back(slot);
+            return;
+        }
+        // Over the high-water mark: drop it, moving the last slot into its
+        // place so the rest keep their indexes.
+        Slot *last = slots.back();
+        last->index = slot->index;
+        slots[slot->index] = last;
+        slots.pop_back();
+        Destroy(slot);
+    }
+
+    // Slots currently lent out.
+    size_t InUse() const { return slots.size() - free.size(); }
+
+    // Slots allocated, lent out or idle.
+    size_t Held() const { return slots.size(); }
+
+  private:
+    struct Slot {
+        size_t index; // in `slots`
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    static void Destroy(Slot *slot) {
+        slot->get()->~T();
+        delete slot;
+    }
+
+    const size_t keep;
+    std::vector<Slot *> slots; // every slot, lent out or idle
+    std::vector<Slot *> free;
+};
@@ -0,0 +1,188 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+
+/**
+ * @brief How a socket is tuned: for latency, for throughput, or not at all.
+ *
+ *   default      kernel defaults; the behaviour before profiles existed
+ *   interactive  TCP_NODELAY (no Nagle hold-back of a small write behind an
+ *                unacknowledged one), TCP_QUICKACK at setup, a 128 KB
+ *                TCP_NOTSENT_LOWAT so stale output does not pile up in the
+ *                kernel ahead of fresh output, DSCP AF41, and SO_BUSY_POLL
+ *                when SOCKET_BUSY_POLL_US is set
+ *   bulk         Nagle left on so small writes coalesce, DSCP CS1 (below
+ *                best effort)
+ *
+ * TCP-only options are skipped on UDP sockets. TCP_QUICKACK is not sticky: the
+ * kernel returns to delayed ACKs on its own, so it only speeds up the start of
+ * a connection.
+ */
+enum class SocketProfile : uint8_t { DEFAULT, INTERACTIVE, BULK };
+
+/**
+ * @brief The sockets a broker or the guard opens, each with its own profile
+ */
+enum class SocketRole : uint8_t {
+    WEB,    // gmlbroker: connections accepted from the Guacamole web server
+    GUACD,  // gcdbroker: connections dialed to guacd
+    BRIDGE, // the UDP sockets on the diode bridge
+    COUNT
+};
+
+/**
+ * @brief Parses a profile name (case-insensitive)
+ * @return false if the name is not a profile
+ */
+inline bool parse_socket_profile(const char *name, SocketProfile &out) {
+    std::string v(name);
+    std::transform(v.begin(), v.end(), v.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (v == "default")
+        out = SocketProfile::DEFAULT;
+    else if (v == "interactive")
+        out = SocketProfile::INTERACTIVE;
+    else if (v == "bulk")
+        out = SocketProfile::BULK;
+    else
+        return false;
+    return true;
+}
+
+inline const char *socket_profile_name(SocketProfile profile) {
+    switch (profile) {
+    case SocketProfile::INTERACTIVE:
+        return "interactive";
+    case SocketProfile::BULK:
+        return "bulk";
+    default:
+        return "default";
+    }
+}
+
+/**
+ * @brief The profile configured for a role.
+ *
+ * Every role defaults to default, so nothing changes until a profile is
+ * chosen. interactive suits SOCKET_PROFILE_WEB and SOCKET_PROFILE_GUACD: both
+ * TCP legs carry keystrokes one way and paints the other, in small writes.
+ */
+inline SocketProfile socket_profile_for(SocketRole role) {
+    static const char *const vars[] = {"SOCKET_PROFILE_WEB",
+                                       "SOCKET_PROFILE_GUACD",
+                                       "SOCKET_PROFILE_BRIDGE"};
+    SocketProfile profile = SocketProfile::DEFAULT;
+    const char *env = std::getenv(vars[static_cast<int>(role)]);
+    if (env && !parse_socket_profile(env, profile))
+        std::cerr << vars[static_cast<int>(role)] << ": unknown profile '"
+                  << env << "', using " << socket_profile_name(profile)
+                  << std::endl;
+    return profile;
+}
+
+/**
+ * @brief Microseconds a receive may busy-poll the device queue (SO_BUSY_POLL)
+ * before sleeping, for interactive sockets; 0 (the default) leaves it off.
+ * Values above net.core.busy_read need CAP_NET_ADMIN.
+ */
+inline int socket_busy_poll_us() {
+    const char *env = std::getenv("SOCKET_BUSY_POLL_US");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 0;
+}
+
+/**
+ * @brief Applies a profile to a socket.
+ * @return false if an option was refused; the socket stays usable, just less
+ *         tuned
+ */
+inline bool apply_socket_profile(int fd, SocketProfile profile) {
+    if (profile == SocketProfile::DEFAULT)
+        return true;
+
+    int type = 0;
+    socklen_t tlen = sizeof(type);
+    ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &tlen);
+    bool tcp = type == SOCK_STREAM;
+
+    bool ok = true;
+    auto set = [&](int level, int name, int value) {
+        if (::setsockopt(fd, level, name, &value, sizeof(value)) < 0)
+            ok = false;
+    };
+
+    // DSCP sits in the top six bits of the TOS byte.
+    constexpr int DSCP_AF41 = 34, DSCP_CS1 = 8;
+    if (profile == SocketProfile::INTERACTIVE) {
+        if (tcp) {
+            set(IPPROTO_TCP, TCP_NODELAY, 1);
+            set(IPPROTO_TCP, TCP_QUICKACK, 1);
+            set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, 128 * 1024);
+        }
+        set(IPPROTO_IP, IP_TOS, DSCP_AF41 << 2);
+        int busy = socket_busy_poll_us();
+        if (busy > 0)
+            set(SOL_SOCKET, SO_BUSY_POLL, busy);
+    } else {
+        if (tcp)
+            set(IPPROTO_TCP, TCP_NODELAY, 0);
+        set(IPPROTO_IP, IP_TOS, DSCP_CS1 << 2);
+    }
+    return ok;
+}
+
+/**
+ * @brief Applies the role's configured profile to a socket.
+ *
+ * The one place sockets are tuned. The configuration is read once; the
+ * role's profile is logged the first time it is applied, and so is the first
+ * refused option (e.g. busy-poll without CAP_NET_ADMIN), rather than once per
+ * connection.
+ */
+inline void apply_socket_profile(int fd, SocketRole role) {
+    static const SocketProfile profiles[] = {
+        socket_profile_for(SocketRole::WEB),
+        socket_profile_for(SocketRole::GUACD),
+        socket_profile_for(SocketRole::BRIDGE)};
+    static const char *const names[] = {"web", "guacd", "bridge"};
+    static std::atomic<bool> logged[static_cast<int>(SocketRole::COUNT)];
+    static std::atomic<bool> warned[static_cast<int>(SocketRole::COUNT)];
+    int r = static_cast<int>(role);
+
+    bool ok = apply_socket_profile(fd, profiles[r]);
+    if (!ok && !warned[r].exchange(true))
+        perror("socket profile: setsockopt");
+    if (!logged[r].exchange(true))
+        std::cout << "socket profile: " << names[r] << " sockets use "
+                  << socket_profile_name(profiles[r]) << std::endl;
+}
@@ -0,0 +1,155 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One thread that runs every per-channel timer of a process.
+ *
+ * Channel threads used to do their periodic work (waiting-screen syncs, guacd
+ * keepalives) by waking on their own poll/recv timeouts, so every idle session
+ * cost a wakeup per interval. They now block without a timeout and Arm() a
+ * timer here instead; its callback pushes the work to them (a mailbox post, a
+ * queued message) only when it is actually due.
+ *
+ * The timers sit in a hierarchical wheel: LEVELS wheels of SLOTS buckets, each
+ * level's bucket spanning a whole turn of the level below. A timer goes into
+ * the lowest level whose turn covers its delay and moves down a level each
+ * time its bucket comes around, so Arm(), Rearm() and Cancel() are O(1) list
+ * operations whatever the number of timers. A bitmap of occupied buckets per
+ * level lets the thread sleep straight to the next bucket holding a timer, so
+ * an idle process does not tick at all.
+ *
+ * Callbacks run on the wheel's thread and must be short and non-blocking; they
+ * may call back into the wheel (e.g. to cancel themselves).
+ */
+class TimerWheel {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    /** @brief Identifies an armed timer; 0 is never a valid id. */
+    using TimerId = uint64_t;
+
+    static constexpr size_t LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+
+    /**
+     * @param tick Timer resolution; delays are rounded up to whole ticks
+     */
+    explicit TimerWheel(
+        std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+    /**
+     * @brief Stops the thread; timers still armed are dropped without running
+     */
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * @brief Runs @p callback once @p delay has passed, then every @p period
+     *        if that is non-zero
+     * @return The timer's id, for Rearm() and Cancel()
+     */
+    TimerId Arm(
+        std::chrono::milliseconds delay, Callback callback,
+        std::chrono::milliseconds period = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Moves an armed timer to fire @p delay from now, then on its
+     *        period
+     * @return False if the timer already fired for good or was cancelled
+     */
+    bool Rearm(TimerId id, std::chrono::milliseconds delay);
+
+    /**
+     * @brief Disarms a timer
+     *
+     * When this returns the callback is not running and will not run again, so
+     * whatever it captures may be destroyed. (Called from the callback itself,
+     * it only stops further runs.)
+     * @return False if the timer already fired for good or was cancelled
+     */
+    bool Cancel(TimerId id);
+
+    /** @brief Number of timers currently armed (for tests and stats) */
+    size_t Armed();
+
+  private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    enum class State : uint8_t { FREE, ARMED, FIRING, DEAD };
+
+    struct Timer {
+        Callback callback;
+        uint64_t expires = 0; // tick at which it fires
+        uint64_t period = 0;  // in ticks; 0 for a one-shot timer
+        uint32_t generation = 1;
+        uint32_t prev = NIL, next = NIL;
+        uint8_t level = 0, slot = 0;
+        State state = State::FREE;
+    };
+
+    void Run();
+    uint64_t TicksFor(std::chrono::milliseconds delay) const;
+    uint64_t TickNow() const;
+    Timer *Lookup(TimerId id, uint32_t &index);
+    void Place(uint32_t index);
+    void Unlink(uint32_t index);
+    void Release(uint32_t index);
+    void Schedule(uint32_t index, uint64_t expires);
+    void Advance(uint64_t target, std::vector<uint32_t> &due);
+    void Expire(std::vector<uint32_t> &due,
+                std::unique_lock<std::mutex> &lock);
+    uint64_t NextEvent() const;
+
+    const std::chrono::milliseconds tick;
+    const Clock::time_point start;
+
+    std::mutex mtx;
+    std::condition_variable cv;      // wakes the thread early (Arm, stop)
+    std::condition_variable settled; // a callback finished (for Cancel)
+    bool stopping = false;
+
+    std::deque<Timer> timers; // deque: growth never moves a running callback
+    std::vector<uint32_t> free_list;
+    std::array<std::array<uint32_t, SLOTS>, LEVELS> buckets;
+    std::array<uint64_t, LEVELS> occupied{}; // bit per non-empty bucket
+    size_t armed = 0;
+    uint64_t now_tick = 0;        // last tick the thread processed
+    uint64_t wake_tick = UINT64_MAX; // tick the thread is sleeping until
+    uint32_t firing = NIL;        // timer whose callback is running
+    std::thread::id thread_id;
+
+    std::thread worker;
+};
@@ -59,3 +59,50 @@ inline std::string tls_key_path() {
     const char *env = std::getenv("GMLBROKER_TLS_KEY");
     return env ? std::string(env) : std::string("/etc/gmlbroker/tls/key.pem");
 }
+
+/**
+ * @brief Opt-in kernel TLS offload for the gmlbroker <-> web-server leg.
+ *
+ * Only meaningful with GMLBROKER_TLS on. Set GMLBROKER_KTLS=1 (or on/true/yes)
+ * to ask OpenSSL to hand the negotiated record keys to the kernel after the
+ * handshake, so records are encrypted in the kernel and return traffic can be
+ * written with plain send()/writev(). Needs an OpenSSL built with kTLS and the
+ * host's `tls` kernel module; if either is missing the connection silently
+ * stays on user-space TLS (each connection logs which one it got).
+ */
+inline bool ktls_enabled() {
+    const char *env = std::getenv("GMLBROKER_KTLS");
+    if (!env)
+        return false;
+    std::string v(env);
+    std::transform(v.begin(), v.end(), v.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return v == "1" || v == "on" || v == "true" || v == "yes";
+}
+
+/**
+ * @brief Bound on gmlbroker's in-memory TLS session cache (entries).
+ *
+ * The web server opens a fresh TLS connection per tunnel; resuming a cached
+ * session skips the certificate and key exchange. Override with
+ * GMLBROKER_TLS_SESSION_CACHE; 0 turns the server-side cache off (session
+ * tickets still work).
+ */
+inline long tls_session_cache_size() {
+    const char *env = std::getenv("GMLBROKER_TLS_SESSION_CACHE");
+    long v = env ? std::atol(env) : -1;
+    return v >= 0 ? v : 1024;
+}
+
+/**
+ * @brief Lifetime (seconds) of a resumable TLS session.
+ *
+ * Also the rotation interval of the session-ticket keys: a ticket sealed with
+ * the previous key is still accepted (and re-issued under the current one), so
+ * no ticket outlives two intervals. Override with GMLBROKER_TLS_SESSION_LIFETIME.
+ */
+inline long tls_session_lifetime_s() {
+    const char *env = std::getenv("GMLBROKER_TLS_SESSION_LIFETIME");
+    long v = env ? std::atol(env) : 0;
+    return v > 0 ? v : 300;
+}
@@ -0,0 +1,54 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../include/network/bridge_transport.h"
+#include "../../include/network/mem_bridge.h"
+#include "../../include/network/shm_ring.h"
+#include "../../include/network/udpreceiver.h"
+#include "../../include/network/udpsender.h"
+#include <cstdlib>
+#include <cstring>
+
+bool bridge_uses_shm() {
+    const char *env = std::getenv("BRIDGE_TRANSPORT");
+    return env && std::strcmp(env, "shm") == 0;
+}
+
+bool bridge_in_process() {
+    const char *env = std::getenv("BRIDGE_TRANSPORT");
+    return env && std::strcmp(env, "mem") == 0;
+}
+
+std::unique_ptr<BridgeSender> MakeBridgeSender(const std::string &host,
+                                               int port) {
+    if (bridge_uses_shm())
+        return std::make_unique<ShmRingSender>(port);
+    if (bridge_in_process())
+        return std::make_unique<MemBridgeSender>(port);
+    return std::make_unique<UDPSender>(host, port);
+}
+
+std::unique_ptr<BridgeReceiver> MakeBridgeReceiver(int port) {
+    if (bridge_uses_shm())
+        return std::make_unique<ShmRingReceiver>(port);
+    if (bridge_in_process())
+        return std::make_unique<MemBridgeReceiver>(port);
+    return std::make_unique<UDPReceiver>(port);
+}
@@ -19,22 +19,136 @@
  */
 
 #include "../../include/network/guacamole_server.h"
+#include "../../include/util/sockprofile.h"
 #include "../../include/util/tls.h"
 #include <arpa/inet.h>
 #include <cerrno>
+#include <climits>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <netinet/tcp.h>
 #include <poll.h>
 #include <sys/socket.h>
-#include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <openssl/core_names.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/rand.h>
 #include <openssl/ssl.h>
 
+namespace {
+// Largest plaintext a single TLS record can carry. SendChunks() fills records up
+// to this size so a drain of many small bridge payloads costs one record (and
+// one MAC/encrypt pass plus header) per 16 KB instead of one per chunk.
+constexpr size_t TLS_RECORD_MAX = 16384;
+
+// Connections the kernel queues for accept() before it starts dropping SYNs.
+// The kernel caps it at net.core.somaxconn.
+int listen_backlog() {
+    const char *env = std::getenv("GMLBROKER_LISTEN_BACKLOG");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 1024;
+}
+
+// Listeners sharing the port through SO_REUSEPORT, each with its own accept
+// thread. 1 (the default) is a single plain listener.
+int accept_shards() {
+    const char *env = std::getenv("GMLBROKER_ACCEPT_SHARDS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 1 ? v : 1;
+}
+
+// Seconds the kernel holds a new connection back until its first bytes arrive
+// (TCP_DEFER_ACCEPT); 0 (the default) accepts on the handshake as before. The
+// web server always speaks first (`select`, or a TLS ClientHello), so a
+// connection is never held back the whole time unless it is idle anyway.
+int defer_accept_s() {
+    const char *env = std::getenv("GMLBROKER_DEFER_ACCEPT");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 0;
+}
+
+/*
+ * @brief Writes all of buffer to a plain (or kTLS) socket, retrying on EINTR
+ */
+ssize_t send_all(int fd, const char *buffer, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        ssize_t sent = ::send(fd, buffer + total, len - total, 0);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return -1;
+        }
+
+        total += sent;
+    }
+
+    return total;
+}
+
+/*
+ * @brief Writes chunks, in order, to a plain (or kTLS) socket with writev()
+ */
+ssize_t writev_all(int fd, const std::vector<std::string> &chunks) {
+    // One writev() per IOV_MAX chunks. A short write leaves `first`
+    // and `skip` pointing at the first unsent byte, so the next writev resumes
+    // there without copying.
+    struct iovec iov[IOV_MAX];
+    size_t first = 0; // index of the first chunk not fully sent
+    size_t skip = 0;  // bytes of chunks[first] already sent
+    size_t total = 0;
+    while (first < chunks.size()) {
+        if (chunks[first].size() == skip) {
+            ++first; // empty chunk, or fully sent
+            skip = 0;
+            continue;
+        }
+        int count = 0;
+        for (size_t i = first; i < chunks.size() && count < IOV_MAX; ++i) {
+            size_t off = (i == first) ? skip : 0;
+            if (chunks[i].size() == off)
+                continue; // empty chunk
+            iov[count].iov_base = const_cast<char *>(chunks[i].data() + off);
+            iov[count].iov_len = chunks[i].size() - off;
+            ++count;
+        }
+        ssize_t sent = ::writev(fd, iov, count);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("writev");
+            return -1;
+        }
+        total += static_cast<size_t>(sent);
+
+        // Advance past what the kernel took.
+        size_t left = static_cast<size_t>(sent);
+        while (left > 0 && first < chunks.size()) {
+            size_t remain = chunks[first].size() - skip;
+            if (left < remain) {
+                skip += left;
+                break;
+            }
+            left -= remain;
+            ++first;
+            skip = 0;
+        }
+    }
+
+    return static_cast<ssize_t>(total);
+}
+
+} // namespace
+
 GuacamoleServer::~GuacamoleServer() {
-    if (listen_fd >= 0) {
+    for (int listen_fd : listen_fds) {
         ::shutdown(listen_fd, SHUT_RDWR);
         ::close(listen_fd);
     }
@@ -42,17 +156,131 @@ GuacamoleServer::~GuacamoleServer() {
         SSL_CTX_free(ssl_ctx);
 }
 
-ssl_st *GuacamoleServer::SslFor(int fd) {
+GuacamoleServer::TlsConn *GuacamoleServer::ConnFor(int fd) {
     std::lock_guard<std::mutex> lock(ssl_mtx);
     auto it = ssl_by_fd.find(fd);
-    return it == ssl_by_fd.end() ? nullptr : it->second;
+    // unordered_map never moves its nodes, so the pointer stays valid for the
+    // owning thread until it Close()s the fd.
+    return it == ssl_by_fd.end() ? nullptr : &it->second;
+}
+
+void GuacamoleServer::CheckHandshake(int fd, TlsConn &conn) {
+    if (conn.handshake_done || !SSL_is_init_finished(conn.ssl))
+        return;
+    conn.handshake_done = true;
+
+    if (SSL_session_reused(conn.ssl)) {
+        uint64_t hits = ++session_hits;
+        std::cout << "TLS: fd " << fd << " resumed session (hits " << hits
+                  << ", misses " << session_misses.load() << ")" << std::endl;
+    } else {
+        uint64_t misses = ++session_misses;
+        std::cout << "TLS: fd " << fd << " full handshake (hits "
+                  << session_hits.load() << ", misses " << misses << ")"
+                  << std::endl;
+    }
+
+    if (!ktls_on)
+        return;
+    bool ktls_recv = false;
+#ifdef SSL_OP_ENABLE_KTLS
+    conn.ktls_send = BIO_get_ktls_send(SSL_get_wbio(conn.ssl)) != 0;
+    ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(conn.ssl)) != 0;
+#endif
+    if (conn.ktls_send || ktls_recv) {
+        std::cout << "TLS: fd " << fd << " kTLS engaged (send "
+                  << (conn.ktls_send ? "on" : "off") << ", receive "
+                  << (ktls_recv ? "on" : "off") << ", "
+                  << SSL_get_cipher_name(conn.ssl) << ")" << std::endl;
+    } else {
+        std::cout << "TLS: fd " << fd
+                  << " kTLS not engaged, using user-space TLS ("
+                  << SSL_get_version(conn.ssl) << " "
+                  << SSL_get_cipher_name(conn.ssl) << ")" << std::endl;
+    }
+}
+
+void GuacamoleServer::RotateTicketKeys() {
+    auto now = std::chrono::steady_clock::now();
+    if (ticket_key_count > 0 && now - ticket_rotated < ticket_lifetime)
+        return;
+    TicketKey fresh;
+    if (RAND_bytes(fresh.name, sizeof(fresh.name)) != 1 ||
+        RAND_bytes(fresh.aes, sizeof(fresh.aes)) != 1 ||
+        RAND_bytes(fresh.hmac, sizeof(fresh.hmac)) != 1) {
+        // Keep sealing with the old key rather than with a weak one; retried
+        // on the next ticket.
+        std::cerr << "TLS: RAND_bytes failed, ticket key not rotated"
+                  << std::endl;
+        return;
+    }
+    ticket_keys[1] = ticket_keys[0];
+    ticket_keys[0] = fresh;
+    ticket_key_count = ticket_key_count == 0 ? 1 : 2;
+    ticket_rotated = now;
+}
+
+int GuacamoleServer::TicketKeyCallback(ssl_st *ssl, unsigned char *key_name,
+                                       unsigned char *iv,
+                                       evp_cipher_ctx_st *cipher,
+                                       evp_mac_ctx_st *mac, int enc) {
+    auto *self = static_cast<GuacamoleServer *>(
+        SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+
+    TicketKey key;
+    bool renew = false;
+    {
+        std::lock_guard<std::mutex> lock(self->ticket_mtx);
+        self->RotateTicketKeys();
+        if (self->ticket_key_count == 0)
+            return enc ? -1 : 0;
+        if (enc) {
+            key = self->ticket_keys[0];
+        } else {
+            int found = -1;
+            for (int i = 0; i < self->ticket_key_count; ++i)
+                if (std::memcmp(key_name, self->ticket_keys[i].name,
+                                sizeof(key.name)) == 0)
+                    found = i;
+            if (found < 0)
+                return 0; // unknown or expired key: fall back to a full handshake
+            key = self->ticket_keys[found];
+            renew = found != 0; // re-seal under the current key
+        }
+    }
+
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac,
+                                          sizeof(key.hmac)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()};
+
+    if (enc) {
+        std::memcpy(key_name, key.name, sizeof(key.name));
+        if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+            EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes,
+                               iv) != 1 ||
+            EVP_MAC_CTX_set_params(mac, params) != 1)
+            return -1;
+        return 1;
+    }
+    if (EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes, iv) !=
+            1 ||
+        EVP_MAC_CTX_set_params(mac, params) != 1)
+        return -1;
+    // TLS 1.3 clients use a ticket once, so always re-issue on resumption
+    // (OpenSSL only sends a new one on a resumed 1.3 session when asked to).
+    if (SSL_version(ssl) >= TLS1_3_VERSION)
+        renew = true;
+    return renew ? 2 : 1;
 }
 
 bool GuacamoleServer::HasPending(int fd) {
     if (!tls_on)
         return false;
-    SSL *ssl = SslFor(fd);
-    return ssl && SSL_pending(ssl) > 0;
+    TlsConn *conn = ConnFor(fd);
+    return conn && SSL_pending(conn->ssl) > 0;
 }
 
 int GuacamoleServer::InitializeTls() {
@@ -95,13 +323,91 @@ int GuacamoleServer::InitializeTls() {
         return -1;
     }
 
+    // Session resumption. The web server reconnects for every tunnel, so let
+    // repeat clients skip the certificate and key exchange: a bounded
+    // server-side cache (TLS 1.2 session ids) plus session tickets under keys
+    // we rotate ourselves rather than OpenSSL's fixed per-process key.
+    const long cache_size = tls_session_cache_size();
+    ticket_lifetime = std::chrono::seconds(tls_session_lifetime_s());
+    SSL_CTX_set_app_data(ssl_ctx, this);
+    static const unsigned char sid_ctx[] = "gmlbroker";
+    SSL_CTX_set_session_id_context(ssl_ctx, sid_ctx, sizeof(sid_ctx) - 1);
+    SSL_CTX_set_session_cache_mode(
+        ssl_ctx, cache_size > 0 ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+    SSL_CTX_sess_set_cache_size(ssl_ctx, cache_size);
+    SSL_CTX_set_timeout(ssl_ctx, ticket_lifetime.count());
+    {
+        std::lock_guard<std::mutex> lock(ticket_mtx);
+        RotateTicketKeys();
+    }
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_ctx, TicketKeyCallback);
+    std::cout << "TLS: session resumption on (cache " << cache_size
+              << " entries, lifetime/ticket key rotation "
+              << ticket_lifetime.count() << " s)" << std::endl;
+
+    // Optional kTLS: OpenSSL installs the record keys into the socket after the
+    // handshake when the kernel supports the negotiated cipher. The configured
+    // suites are left alone: a connection that negotiates one the kernel can't
+    // take just stays on user-space TLS, and CheckHandshake() logs which.
+    ktls_on = ktls_enabled();
+    if (ktls_on) {
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_CTX_set_options(ssl_ctx, SSL_OP_ENABLE_KTLS);
+        std::cout << "TLS: kernel TLS offload requested" << std::endl;
+#else
+        std::cerr << "TLS: this OpenSSL has no kTLS support, "
+                     "continuing with user-space TLS"
+                  << std::endl;
+        ktls_on = false;
+#endif
+    }
+
     std::cout << "TLS enabled: loaded certificate " << cert << " and key " << key
               << std::endl;
     return 0;
 }
 
+int GuacamoleServer::OpenListener(const sockaddr_in &addr, bool reuse_port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // Reuse address if it is already in use or not properly cleaned up
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reuse_port &&
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        ::close(fd);
+        return -1;
+    }
+
+    // Bind and listen to the given port
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) <
+        0) {
+        perror("bind");
+        ::close(fd);
+        return -1;
+    }
+
+    if (::listen(fd, listen_backlog()) < 0) {
+        perror("listen");
+        ::close(fd);
+        return -1;
+    }
+
+    int defer = defer_accept_s();
+    if (defer > 0 && ::setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer,
+                                  sizeof(defer)) < 0)
+        perror("setsockopt(TCP_DEFER_ACCEPT)"); // accept on the handshake
+
+    return fd;
+}
+
 int GuacamoleServer::Initialize() {
-    struct addrinfo hints{}, *results, *rp;
+    struct addrinfo hints{}, *results;
     std::memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;      // IPv4
     hints.ai_socktype = SOCK_STREAM; // TCP
@@ -112,24 +418,14 @@ int GuacamoleServer::Initialize() {
         return -1;
     }
 
-    int fd = -1;
-    
-    // Loop through list until a valid socket is found
-    for (rp = results; rp != nullptr; rp = rp->ai_next) {
-        fd = ::socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (fd >= 0)
-            break;
-    }
-
-    // Copy the resolved address out of the addrinfo list *before* freeing it:
-    // `rp` points into `results`, so any read of `rp->ai_addr` after
-    // freeaddrinfo() would be a use-after-free.
+    // Copy the resolved address out of the addrinfo list *before* freeing it,
+    // so nothing reads `results` after freeaddrinfo().
     sockaddr_in addr;
     std::memset(&addr, 0, sizeof(addr));
-    bool resolved = rp != nullptr;
+    bool resolved = results != nullptr;
     if (resolved) {
         struct sockaddr_in *addr_in =
-            reinterpret_cast<struct sockaddr_in *>(rp->ai_addr);
+            reinterpret_cast<struct sockaddr_in *>(results->ai_addr);
         addr.sin_family = addr_in->sin_family;
         addr.sin_port = addr_in->sin_port;
         addr.sin_addr = addr_in->sin_addr;
@@ -139,42 +435,23 @@ int GuacamoleServer::Initialize() {
 
     if (!resolved) {
         std::cerr << "Could not resolve hostname or address: " << host << std::endl;
-        if (fd >= 0)
-            ::close(fd);
         return -1;
     }
 
-    // Reuse the socket opened in the resolve loop above rather than opening a
-    // second one (which would leak the first fd).
-    listen_fd = fd;
-
-    // Reuse address if it is already in use or not properly cleaned up
-    int one = 1;
-    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
-
-    // Bind and listen to the given port
-    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
-        0) {
-        perror("bind");
-        if (listen_fd >= 0)
-            ::close(listen_fd);
-        return 1;
-    }
-
-    if (::listen(listen_fd, 16) < 0) {
-        perror("listen");
-        if (listen_fd >= 0)
-            ::close(listen_fd);
-        return 1;
+    // One listener per accept shard. The listeners are non-blocking: the
+    // accept loop waits in poll() with a timeout, so it notices a shutdown
+    // request (the `running` flag) instead of blocking forever; SIGINT may be
+    // delivered to a different thread, so EINTR can't be relied on.
+    int shards = accept_shards();
+    for (int i = 0; i < shards; ++i) {
+        int fd = OpenListener(addr, shards > 1);
+        if (fd < 0)
+            return 1;
+        listen_fds.push_back(fd);
     }
-
-    // Time out a blocked accept periodically so the accept loop can notice a
-    // shutdown request (the `running` flag) instead of blocking forever; SIGINT
-    // may be delivered to a different thread, so EINTR can't be relied on.
-    struct timeval tv{};
-    tv.tv_sec = 0;
-    tv.tv_usec = 200000; // 200 ms
-    ::setsockopt(listen_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (shards > 1)
+        std::cout << "Accepting on " << shards << " SO_REUSEPORT listeners"
+                  << std::endl;
 
     // Maintainer toggle: stand up the TLS context only when explicitly enabled.
     // A configured-but-broken TLS setup must abort startup rather than silently
@@ -194,22 +471,51 @@ int GuacamoleServer::Initialize() {
     return 0;
 }
 
-int GuacamoleServer::Accept() {
-    sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    int fd = ::accept(listen_fd, reinterpret_cast<sockaddr *>(&client_addr),
-                      &client_len);
-    if (fd < 0) {
-        // EINVAL: listen socket was shut down. EAGAIN/EWOULDBLOCK: accept timed
-        // out (no pending connection). EINTR: interrupted. All benign — the
-        // caller re-checks `running` and either retries or stops.
-        if (errno != EINVAL && errno != EAGAIN && errno != EWOULDBLOCK &&
-            errno != EINTR)
-            perror("accept");
-        return -1;
+int GuacamoleServer::AcceptBatch(size_t shard, std::vector<int> &out,
+                                 int timeout_ms) {
+    int listen_fd = listen_fds[shard];
+    struct pollfd pfd{};
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    int ready = ::poll(&pfd, 1, timeout_ms);
+    if (ready < 0)
+        return errno == EINTR ? 0 : -1;
+    if (ready == 0)
+        return 0;
+    if (pfd.revents & (POLLERR | POLLNVAL))
+        return -1; // listen socket was shut down
+
+    // Drain the backlog: one wake-up serves the whole burst.
+    int accepted = 0;
+    while (static_cast<size_t>(accepted) < ACCEPT_BATCH) {
+        sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        // Not SOCK_NONBLOCK: the listener is non-blocking, but each connection
+        // is served by blocking send()s and all-or-nothing SSL_write()s.
+        int fd = ::accept4(listen_fd,
+                           reinterpret_cast<sockaddr *>(&client_addr),
+                           &client_len, SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN/EWOULDBLOCK: backlog drained. EINTR: interrupted.
+            // ECONNABORTED: the client gave up while queued. EINVAL: the
+            // listen socket was shut down. All benign — the caller re-checks
+            // `running` and either retries or stops.
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINVAL)
+                perror("accept4");
+            break;
+        }
+        if (!Adopt(fd, client_addr))
+            continue;
+        apply_socket_profile(fd, SocketRole::WEB);
+        out.push_back(fd);
+        ++accepted;
     }
+    return accepted;
+}
 
+bool GuacamoleServer::Adopt(int fd, const sockaddr_in &client_addr) {
     char ip_str[INET_ADDRSTRLEN];
     ::inet_ntop(AF_INET, &client_addr.sin_addr, ip_str, sizeof(ip_str));
     std::cout << "Client connected from " << ip_str << ":"
@@ -225,15 +531,15 @@ int GuacamoleServer::Accept() {
             std::cerr << "TLS: SSL_new failed for fd " << fd << std::endl;
             ERR_print_errors_fp(stderr);
             ::close(fd);
-            return -1;
+            return false;
         }
         SSL_set_fd(ssl, fd);
         SSL_set_accept_state(ssl);
         std::lock_guard<std::mutex> lock(ssl_mtx);
-        ssl_by_fd[fd] = ssl;
+        ssl_by_fd[fd] = TlsConn{ssl};
     }
 
-    return fd;
+    return true;
 }
 
 int GuacamoleServer::WaitReadable(int fd, int timeout_ms) {
@@ -253,10 +559,12 @@ int GuacamoleServer::WaitReadable(int fd, int timeout_ms) {
 
 int GuacamoleServer::Receive(int fd, char *buffer, size_t len) {
     if (tls_on) {
-        SSL *ssl = SslFor(fd);
-        if (!ssl)
+        TlsConn *conn = ConnFor(fd);
+        if (!conn)
             return -1;
+        SSL *ssl = conn->ssl;
         int n = SSL_read(ssl, buffer, static_cast<int>(len - 1));
+        CheckHandshake(fd, *conn);
         if (n > 0) {
             buffer[n] = '\0'; // make it a C-string for printing
             return n;
@@ -300,9 +608,13 @@ ssize_t GuacamoleServer::Send(int fd, const char *buffer, size_t len) {
     if (tls_on) {
         if (len == 0)
             return 0;
-        SSL *ssl = SslFor(fd);
-        if (!ssl)
+        TlsConn *conn = ConnFor(fd);
+        if (!conn)
             return -1;
+        CheckHandshake(fd, *conn);
+        if (conn->ktls_send)
+            return send_all(fd, buffer, len); // the kernel frames the records
+        SSL *ssl = conn->ssl;
         // The fd is blocking and partial writes aren't enabled, so SSL_write
         // either writes everything or fails. (Renegotiation, which could ask to
         // read mid-write, doesn't occur in TLS 1.2/1.3 here.)
@@ -312,20 +624,69 @@ ssize_t GuacamoleServer::Send(int fd, const char *buffer, size_t len) {
         return n;
     }
 
-    size_t total = 0;
-    while (total < len) {
-        ssize_t sent = ::send(fd, buffer + total, len - total, 0);
-        if (sent < 0) {
-            if (errno == EINTR)
-                continue;
-            perror("send");
+    return send_all(fd, buffer, len);
+}
+
+ssize_t GuacamoleServer::SendChunks(int fd,
+                                    const std::vector<std::string> &chunks) {
+    if (fd < 0) {
+        std::cerr << "Error: cannot send to an invalid fd\n";
+        return -1;
+    }
+
+    if (tls_on) {
+        TlsConn *conn = ConnFor(fd);
+        if (!conn)
             return -1;
+        CheckHandshake(fd, *conn);
+        // With kTLS the kernel cuts the records itself, so the chunks can go
+        // out through the same writev() as plaintext.
+        if (conn->ktls_send)
+            return writev_all(fd, chunks);
+        SSL *ssl = conn->ssl;
+
+        // Each connection is served by exactly one reader thread, so a
+        // thread-local staging buffer is effectively per connection and keeps
+        // its capacity across drains (no allocation on the steady-state path).
+        thread_local std::string staging;
+        staging.clear();
+        staging.reserve(TLS_RECORD_MAX);
+
+        size_t total = 0;
+        auto flush = [&](const char *data, size_t len) {
+            if (len == 0)
+                return true;
+            // Blocking fd, no partial writes: all-or-nothing (see Send).
+            if (SSL_write(ssl, data, static_cast<int>(len)) <= 0)
+                return false;
+            total += len;
+            return true;
+        };
+
+        for (const std::string &chunk : chunks) {
+            if (staging.size() + chunk.size() <= TLS_RECORD_MAX) {
+                staging.append(chunk);
+                continue;
+            }
+            if (!flush(staging.data(), staging.size()))
+                return -1;
+            staging.clear();
+            // A chunk that fills a record by itself gains nothing from copying;
+            // hand it to OpenSSL directly and let it cut the records.
+            if (chunk.size() >= TLS_RECORD_MAX) {
+                if (!flush(chunk.data(), chunk.size()))
+                    return -1;
+            } else {
+                staging.append(chunk);
+            }
         }
-
-        total += sent;
+        if (!flush(staging.data(), staging.size()))
+            return -1;
+        staging.clear();
+        return static_cast<ssize_t>(total);
     }
 
-    return total;
+    return writev_all(fd, chunks);
 }
 
 void GuacamoleServer::Shutdown(int fd) {
@@ -343,7 +704,7 @@ void GuacamoleServer::Close(int fd) {
             std::lock_guard<std::mutex> lock(ssl_mtx);
             auto it = ssl_by_fd.find(fd);
             if (it != ssl_by_fd.end()) {
-                ssl = it->second;
+                ssl = it->second.ssl;
                 ssl_by_fd.erase(it);
             }
         }
@@ -19,13 +19,16 @@
  */
 
 #include "../../include/network/guacd_client.h"
+#include "../../include/util/sockprofile.h"
 #include <arpa/inet.h>
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -44,48 +47,145 @@ int guacd_send_timeout_ms() {
     return v > 0 ? v : 2000;
 }
 
-// How long Receive() blocks before reporting an idle timeout, so the reader can
-// re-send a keepalive to guacd. The browser's own periodic keepalive is swallowed
-// on the forward path, so without this an idle session would trip guacd's
-// "user not responding" timeout (~15 s). Must stay comfortably under it.
-int guacd_recv_timeout_ms() {
-    const char *env = std::getenv("GUACD_KEEPALIVE_MS");
+// How long one dial may take, across every resolved address, before it is
+// given up. An unreachable guacd (dropped SYNs) would otherwise hold a dialer
+// for the kernel's full SYN retry budget, over two minutes.
+int guacd_connect_timeout_ms() {
+    const char *env = std::getenv("GUACD_CONNECT_TIMEOUT_MS");
     int v = env ? std::atoi(env) : 0;
-    return v > 0 ? v : 3000;
+    return v > 0 ? v : 5000;
+}
+
+// How long a resolved guacd address is reused before it is looked up again.
+int guacd_resolve_ttl_ms() {
+    const char *env = std::getenv("GUACD_RESOLVE_TTL_MS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? v : 30000;
+}
+
+/*
+ * @brief Connects fd to addr, waiting no later than deadline
+ * @return 0 once connected, -1 on failure or timeout (errno set)
+ */
+int connect_until(int fd, const struct sockaddr *addr, socklen_t len,
+                  std::chrono::steady_clock::time_point deadline) {
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return -1;
+
+    int rc = ::connect(fd, addr, len);
+    if (rc < 0 && errno == EINPROGRESS) {
+        rc = -1;
+        while (true) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                errno = ETIMEDOUT;
+                break;
+            }
+            struct pollfd pfd{};
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            int ready = ::poll(&pfd, 1, static_cast<int>(left.count()));
+            if (ready < 0 && errno == EINTR)
+                continue;
+            if (ready < 0)
+                break;
+            if (ready == 0)
+                continue; // re-check the deadline
+            int err = 0;
+            socklen_t elen = sizeof(err);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &elen) < 0)
+                break;
+            if (err != 0) {
+                errno = err;
+                break;
+            }
+            rc = 0;
+            break;
+        }
+    }
+    if (rc < 0)
+        return -1;
+
+    // Back to blocking: the send/receive timeouts below govern it from here.
+    return ::fcntl(fd, F_SETFL, flags);
 }
 } // namespace
 
-int GuacdClient::Connect() {
+bool GuacdClient::Resolve(std::vector<Address> &out) {
+    auto now = std::chrono::steady_clock::now();
+    auto ttl = std::chrono::milliseconds(guacd_resolve_ttl_ms());
+    {
+        std::lock_guard<std::mutex> lock(resolve_mtx);
+        if (!resolved.empty() && now - resolved_at < ttl) {
+            out = resolved;
+            return true;
+        }
+    }
+
+    // Look up outside the lock: a slow resolver delays only this dial, and
+    // dials racing an expired entry each resolve once (the last one wins).
     struct addrinfo hints, *res, *p;
     std::memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM; // TCP
 
     std::string port_str = std::to_string(server_port);
-
-    // Get socket for address
     int status =
         getaddrinfo(server_ip.c_str(), port_str.c_str(), &hints, &res);
     if (status != 0) {
         std::cerr << "getaddrinfo error: " << gai_strerror(status) << std::endl;
-        return -1;
+        return false;
     }
 
-    // Loop through address infos until a valid one is found
-    int fd = -1;
+    out.clear();
     for (p = res; p != nullptr; p = p->ai_next) {
-        fd = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        Address a{};
+        std::memcpy(&a.addr, p->ai_addr, p->ai_addrlen);
+        a.len = p->ai_addrlen;
+        out.push_back(a);
+    }
+    freeaddrinfo(res);
+
+    std::lock_guard<std::mutex> lock(resolve_mtx);
+    resolved = out;
+    resolved_at = now;
+    return !out.empty();
+}
+
+void GuacdClient::Invalidate() {
+    std::lock_guard<std::mutex> lock(resolve_mtx);
+    resolved.clear();
+}
+
+int GuacdClient::Connect() {
+    std::vector<Address> addrs;
+    if (!Resolve(addrs))
+        return -1;
+
+    // One deadline for the whole dial, however many addresses it tries.
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(guacd_connect_timeout_ms());
+
+    // Loop through the addresses until one connects
+    int fd = -1;
+    for (const Address &a : addrs) {
+        fd = ::socket(a.addr.ss_family, SOCK_STREAM, 0);
         if (fd == -1)
             continue;
 
-        if (::connect(fd, p->ai_addr, p->ai_addrlen) == 0)
+        const struct sockaddr *addr =
+            reinterpret_cast<const struct sockaddr *>(&a.addr);
+        if (connect_until(fd, addr, a.len, deadline) == 0)
             break; // success
 
         perror("connect");
         ::close(fd);
         fd = -1;
     }
-    freeaddrinfo(res);
+    if (fd < 0)
+        Invalidate(); // guacd may have moved: resolve again on the next dial
 
     if (fd >= 0) {
         // Bound how long a write to this guacd connection may block, so a
@@ -97,14 +197,7 @@ int GuacdClient::Connect() {
         stv.tv_usec = (sms % 1000) * 1000;
         ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &stv, sizeof(stv));
 
-        // Receive timeout so the reader wakes periodically (when guacd is idle)
-        // to re-send a keepalive — otherwise an idle session is silent toward
-        // guacd and trips its "user not responding" timeout.
-        int rms = guacd_recv_timeout_ms();
-        struct timeval rtv{};
-        rtv.tv_sec = rms / 1000;
-        rtv.tv_usec = (rms % 1000) * 1000;
-        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rtv, sizeof(rtv));
+        apply_socket_profile(fd, SocketRole::GUACD);
     }
 
     return fd;
@@ -114,9 +207,6 @@ int GuacdClient::Receive(int fd, char *buffer, size_t len) {
     ssize_t received = ::recv(fd, buffer, len - 1, 0);
 
     if (received < 0) {
-        // Receive timeout: idle, but the connection is alive.
-        if (errno == EAGAIN || errno == EWOULDBLOCK)
-            return RECV_TIMEOUT;
         perror("recv");
         return -1;
     }
@@ -0,0 +1,403 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../include/network/shm_ring.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+// Messages a ring holds before the sender laps its receiver.
+uint32_t shm_ring_slots() {
+    const char *env = std::getenv("BRIDGE_SHM_SLOTS");
+    int v = env ? std::atoi(env) : 0;
+    return v > 0 ? static_cast<uint32_t>(v) : 4096;
+}
+
+constexpr long RECEIVE_WAIT_NS =
+    std::chrono::nanoseconds(BridgeReceiver::RECEIVE_WAIT).count();
+
+std::string shm_ring_dir() {
+    const char *env = std::getenv("BRIDGE_SHM_DIR");
+    return env && *env ? env : "/dev/shm/gdd-bridge";
+}
+
+// Group allowed to read the rings (BRIDGE_SHM_GID), or -1: owner only.
+gid_t shm_ring_gid() {
+    const char *env = std::getenv("BRIDGE_SHM_GID");
+    return env && *env ? static_cast<gid_t>(std::atoi(env))
+                       : static_cast<gid_t>(-1);
+}
+
+// User the senders run as (BRIDGE_SHM_UID), by default the same as ours.
+uid_t shm_ring_sender_uid() {
+    const char *env = std::getenv("BRIDGE_SHM_UID");
+    return env && *env ? static_cast<uid_t>(std::atoi(env)) : ::geteuid();
+}
+
+// Creates the ring directory if needed and checks that only this user (or
+// root) can put files in it, so nobody else can plant a ring in our place.
+bool prepare_ring_dir(const std::string &dir, gid_t gid) {
+    bool shared = gid != static_cast<gid_t>(-1);
+    if (::mkdir(dir.c_str(), shared ? 0750 : 0700) == 0) {
+        if (shared && ::chown(dir.c_str(), static_cast<uid_t>(-1), gid) != 0) {
+            perror("chown");
+            return false;
+        }
+    } else if (errno != EEXIST) {
+        perror("mkdir");
+        return false;
+    }
+
+    struct stat st{};
+    if (::lstat(dir.c_str(), &st) != 0) {
+        perror("lstat");
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || (st.st_uid != ::geteuid() && st.st_uid != 0) ||
+        (st.st_mode & S_IWOTH) ||
+        ((st.st_mode & S_IWGRP) && (!shared || st.st_gid != gid))) {
+        std::cerr << "ShmRingSender: " << dir
+                  << " must be a directory owned by this user or root that "
+                     "no one else can write to"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t ring_bytes(uint32_t slots) {
+    return sizeof(ShmRingHeader) + size_t(slots) * sizeof(ShmRingSlot);
+}
+
+// The ring file is shared between processes, so these are not
+// FUTEX_PRIVATE_FLAG operations.
+void futex_wake(const std::atomic<uint32_t> *word) {
+    ::syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void futex_wait(const std::atomic<uint32_t> *word, uint32_t expected,
+                long timeout_ns) {
+    struct timespec ts{};
+    ts.tv_sec = timeout_ns / 1000000000L;
+    ts.tv_nsec = timeout_ns % 1000000000L;
+    ::syscall(SYS_futex, word, FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+// The receiver's own interrupt word is process-local.
+void futex_wake_private(std::atomic<uint32_t> *word) {
+    ::syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr,
+              0);
+}
+
+// Waits until the doorbell or the interrupt word moves off its expected value
+// (or the timeout passes), with no window between checking either and
+// sleeping. Returns false where the kernel lacks futex_waitv (before 5.16).
+bool futex_wait_either(const std::atomic<uint32_t> *bell, uint32_t bell_val,
+                       const std::atomic<uint32_t> *intr, uint32_t intr_val,
+                       long timeout_ns) {
+#ifdef SYS_futex_waitv
+    static std::atomic<bool> unsupported{false};
+    if (unsupported.load(std::memory_order_relaxed))
+        return false;
+
+    struct futex_waitv waiters[2]{};
+    waiters[0].val = bell_val;
+    waiters[0].uaddr = reinterpret_cast<uintptr_t>(bell);
+    waiters[0].flags = FUTEX_32;
+    waiters[1].val = intr_val;
+    waiters[1].uaddr = reinterpret_cast<uintptr_t>(intr);
+    waiters[1].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+
+    // futex_waitv only takes an absolute deadline.
+    struct timespec deadline{};
+    ::clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += timeout_ns;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    if (::syscall(SYS_futex_waitv, waiters, 2, 0, &deadline,
+                  CLOCK_MONOTONIC) == -1 &&
+        errno == ENOSYS) {
+        unsupported.store(true, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+#else
+    (void)bell;
+    (void)bell_val;
+    (void)intr;
+    (void)intr_val;
+    (void)timeout_ns;
+    return false;
+#endif
+}
+} // namespace
+
+std::string shm_ring_path(int port) {
+    return shm_ring_dir() + "/gdd-bridge-" + std::to_string(port);
+}
+
+ShmRingSender::~ShmRingSender() {
+    if (map)
+        ::munmap(map, map_size);
+}
+
+int ShmRingSender::Initialize() {
+    gid_t gid = shm_ring_gid();
+    if (!prepare_ring_dir(shm_ring_dir(), gid))
+        return 1;
+
+    // Start from a new file rather than resetting the old one under a receiver
+    // that still has it mapped; the receiver moves over when it sees the swap.
+    // The rings carry credentials and screen data, so only this user, or the
+    // BRIDGE_SHM_GID group, may read them.
+    ::unlink(path.c_str());
+    int fd = ::open(path.c_str(),
+                    O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    if (gid != static_cast<gid_t>(-1) &&
+        (::fchown(fd, static_cast<uid_t>(-1), gid) != 0 ||
+         ::fchmod(fd, 0640) != 0)) {
+        perror("fchown");
+        ::close(fd);
+        return 1;
+    }
+    uint32_t count = shm_ring_slots();
+    map_size = ring_bytes(count);
+    if (::ftruncate(fd, static_cast<off_t>(map_size)) != 0) {
+        perror("ftruncate");
+        ::close(fd);
+        return 1;
+    }
+    map = ::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        map = nullptr;
+        return 1;
+    }
+
+    header = static_cast<ShmRingHeader *>(map);
+    slots = reinterpret_cast<ShmRingSlot *>(static_cast<char *>(map) +
+                                            sizeof(ShmRingHeader));
+    // The new file is zero-filled: head, doorbell and every slot's sequence
+    // start at 0. Publish the layout last.
+    header->magic = ShmRingHeader::MAGIC;
+    header->slots = count;
+    header->slot_size = sizeof(ShmRingSlot);
+    header->ready.store(1, std::memory_order_release);
+
+    std::cout << "ShmRingSender: writing " << path << " (" << count
+              << " slots)" << std::endl;
+    return 0;
+}
+
+ssize_t ShmRingSender::Send(const char *buffer, size_t len) {
+    if (len > ShmRingSlot::DATA_SIZE) {
+        errno = EMSGSIZE;
+        perror("ShmRingSender");
+        return -1;
+    }
+    ShmRingSlot &slot = slots[next % header->slots];
+    slot.seq.store(2 * next + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot.data, buffer, len);
+    slot.len = static_cast<uint32_t>(len);
+    slot.seq.store(2 * next + 2, std::memory_order_release);
+
+    ++next;
+    header->head.store(next, std::memory_order_release);
+    header->doorbell.store(static_cast<uint32_t>(next),
+                           std::memory_order_release);
+    futex_wake(&header->doorbell);
+    return static_cast<ssize_t>(len);
+}
+
+ShmRingReceiver::~ShmRingReceiver() { Detach(); }
+
+int ShmRingReceiver::Initialize() {
+    if (!Attach(false))
+        std::cout << "ShmRingReceiver: waiting for a sender on " << path
+                  << std::endl;
+    return 0;
+}
+
+bool ShmRingReceiver::Attach(bool from_oldest) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    // Only read a ring the sender wrote: a file planted by another user could
+    // feed us messages that never passed the stage before, or be truncated
+    // under our mapping. Only its owner can write or resize a ring that no one
+    // else can write to.
+    gid_t gid = shm_ring_gid();
+    bool group_ok = gid != static_cast<gid_t>(-1) && st.st_gid == gid;
+    if (!S_ISREG(st.st_mode) || st.st_uid != shm_ring_sender_uid() ||
+        (st.st_mode & (S_IWGRP | S_IRWXO)) ||
+        ((st.st_mode & S_IRGRP) && !group_ok)) {
+        if (st.st_ino != refused) {
+            refused = st.st_ino;
+            std::cerr << "ShmRingReceiver: refusing " << path
+                      << ": not a private ring of the expected sender"
+                      << std::endl;
+        }
+        ::close(fd);
+        return false;
+    }
+    if (static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *m = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+        return false;
+
+    auto *h = static_cast<const ShmRingHeader *>(m);
+    if (!h->ready.load(std::memory_order_acquire) ||
+        h->magic != ShmRingHeader::MAGIC || h->slots == 0 ||
+        h->slot_size != sizeof(ShmRingSlot) || ring_bytes(h->slots) > size) {
+        ::munmap(m, size); // not (yet) a ring we can read
+        return false;
+    }
+
+    map = m;
+    map_size = size;
+    header = h;
+    slots = reinterpret_cast<const ShmRingSlot *>(static_cast<const char *>(m) +
+                                                  sizeof(ShmRingHeader));
+    inode = st.st_ino;
+    // Joining a running sender starts at its newest message. A ring that
+    // appeared while this receiver was waiting holds nothing it has seen, so
+    // it starts at the oldest message still there.
+    uint64_t head = h->head.load(std::memory_order_acquire);
+    if (!from_oldest)
+        next = head;
+    else
+        next = head > h->slots ? head - h->slots : 0;
+    bell.store(&h->doorbell);
+    std::cout << "ShmRingReceiver: reading " << path << " (" << h->slots
+              << " slots)" << std::endl;
+    return true;
+}
+
+void ShmRingReceiver::Detach() {
+    bell.store(nullptr);
+    if (map)
+        ::munmap(map, map_size);
+    map = nullptr;
+    header = nullptr;
+    slots = nullptr;
+}
+
+void ShmRingReceiver::Interrupt() {
+    interrupted.store(true);
+    // Receive() read interrupt_seq before checking the flag, so this bump is
+    // seen even if the flag was checked just before it was set.
+    interrupt_seq.fetch_add(1);
+    futex_wake_private(&interrupt_seq);
+    // Without futex_waitv Receive() sleeps on the doorbell alone. A futex call
+    // on a ring unmapped meanwhile just fails with EFAULT.
+    if (const std::atomic<uint32_t> *b = bell.load())
+        futex_wake(b);
+}
+
+int ShmRingReceiver::Receive(char *buffer, size_t len) {
+    if (!header && !Attach(true)) {
+        // No sender yet: poll for one at the usual receive timeout.
+        struct timespec ts{0, RECEIVE_WAIT_NS};
+        ::nanosleep(&ts, nullptr);
+        return 0;
+    }
+
+    bool waited = false;
+    while (true) {
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        if (next == head) {
+            uint32_t seq = interrupt_seq.load();
+            if (interrupted.exchange(false))
+                return 0;
+            if (waited) {
+                // Idle for a whole wait: a restarted sender writes a new file,
+                // so move over to it if the path no longer names ours.
+                struct stat st{};
+                if (::stat(path.c_str(), &st) == 0 && st.st_ino != inode)
+                    Detach();
+                return 0;
+            }
+            if (!futex_wait_either(&header->doorbell,
+                                   static_cast<uint32_t>(head), &interrupt_seq,
+                                   seq, RECEIVE_WAIT_NS))
+                // An Interrupt() landing between the check above and this
+                // wait is then only noticed when the wait times out.
+                futex_wait(&header->doorbell, static_cast<uint32_t>(head),
+                           RECEIVE_WAIT_NS);
+            waited = true;
+            continue;
+        }
+
+        if (head - next > header->slots) {
+            uint64_t lost = head - next - header->slots;
+            dropped += lost;
+            next += lost;
+            std::cerr << "ShmRingReceiver: fell behind, lost " << lost
+                      << " messages" << std::endl;
+        }
+
+        const ShmRingSlot &slot = slots[next % header->slots];
+        uint64_t want = 2 * next + 2;
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == want) {
+            size_t n = std::min<size_t>(slot.len, len - 1);
+            std::memcpy(buffer, slot.data, n);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == want) {
+                ++next;
+                buffer[n] = '\0'; // make it a C-string for printing
+                return static_cast<int>(n);
+            }
+        }
+        // Overwritten before (or while) we read it: lost like a datagram.
+        ++dropped;
+        ++next;
+    }
+}
@@ -20,8 +20,10 @@
 
 #include "../../include/network/udpreceiver.h"
 #include "../../include/util/sockbuf.h"
+#include "../../include/util/sockprofile.h"
 #include <arpa/inet.h>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -44,6 +46,7 @@ int UDPReceiver::Initialize() {
     // Enlarge the receive buffer so traffic bursts don't overflow it and drop
     // datagrams (the bridge has no retransmit).
     set_bridge_sockbuf(sock_fd, SO_RCVBUF, "UDPReceiver SO_RCVBUF");
+    apply_socket_profile(sock_fd, SocketRole::BRIDGE);
 
     sockaddr_in addr;
     std::memset(&addr, 0, sizeof(addr));
@@ -65,7 +68,7 @@ int UDPReceiver::Initialize() {
     // this one.
     struct timeval tv{};
     tv.tv_sec = 0;
-    tv.tv_usec = 200000; // 200 ms
+    tv.tv_usec = std::chrono::microseconds(RECEIVE_WAIT).count();
     ::setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
     return 0;
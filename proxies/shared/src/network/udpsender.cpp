@@ -20,6 +20,7 @@
 
 #include "../../include/network/udpsender.h"
 #include "../../include/util/sockbuf.h"
+#include "../../include/util/sockprofile.h"
 #include <arpa/inet.h>
 #include <cerrno>
 #include <cstring>
@@ -85,6 +86,7 @@ int UDPSender::Initialize() {
     // failed sendto silently drops the datagram, and the bridge has no
     // retransmit).
     set_bridge_sockbuf(sock_fd, SO_SNDBUF, "UDPSender SO_SNDBUF");
+    apply_socket_profile(sock_fd, SocketRole::BRIDGE);
 
     return 0;
 }
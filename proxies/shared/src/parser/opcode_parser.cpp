@@ -19,213 +19,401 @@
  */
 
 #include "../../include/parser/opcode_parser.h"
+#include <algorithm>
 #include <cstring>
 #include <string.h>
 
-ParserState OpcodeParser::Parse(const char *data, size_t len) {
-    // Ranges recorded here belong to this call's buffer only.
-    denied_ranges.clear();
-
-    // `denying`: inside a disallowed instruction whose bytes are being skipped
-    // until its ';', then recorded for excision. 
-    bool denying = false;
-    
-    // `opcode_in_this_call`: the instruction currently being parsed started in
-    // this call, so opcode_start_idx is a valid index into `data` (a 
-    // prerequisite for cutting it out).
-    bool opcode_in_this_call = false;
-
-    // Each byte drives exactly one state
-    for (size_t i = 0; i < len; ++i) {
-        current_index = i;
-        char c = data[i];
-
-        switch (state) {
-        case ParserState::READING_LENGTH:
-            // If character is a digit
-            if (c >= '0' && c <= '9') {
-                if (current_length == -1) {
-                    current_length = 0;
-                    // First digit of a new element. If it is the opcode, record
-                    // where this instruction starts in the buffer.
-                    if (reading_opcode) {
-                        opcode_start_idx = i;
-                        opcode_in_this_call = true;
-                    }
-                }
-                // add the digit to the current length (as an integer!)
-                current_length = current_length * 10 + (c - '0');
-
-                // Observed length exceeds the buffer. By default that is an
-                // untrustworthy stream (the guard); a parser that tolerates large
-                // elements keeps framing and just buffers the first
-                // MAX_ELEMENT_SIZE bytes for the hooks.
-                if (current_length > MAX_ELEMENT_SIZE &&
-                    !ToleratesOversizedElements()) {
-                    state = ParserState::STREAM_CORRUPTED;
-                    return state;
-                }
-            } else if (c == '.') {
-                // The '.' closes the length: decide the next branch from it
-                // (folds in the diagram's READING_DOT).
-                if (current_length == -1) {
-                    // No length calculated before the dot
-                    state = ParserState::STREAM_CORRUPTED;
-                    return state;
-                }
-                current_read = 0;
-                if (current_length == 0)
-                    state = ParserState::EXPECT_DELIM;
-                else
-                    state = ParserState::READING_DATA;
-            } else {
-                // This is not a digit or length-terminating character
-                state = ParserState::STREAM_CORRUPTED;
-                return state;
-            }
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+using element_scan::CharRun;
+
+/*
+ * @brief Copies ASCII bytes from src to dst until the first non-ASCII byte.
+ *
+ * The bulk path of READING_DATA: validates and buffers a whole run of element
+ * bytes at once instead of one FSM step per byte. Returns the number of bytes
+ * before the first byte > 127 (n if there is none). `dst` may be null to only
+ * validate (the unbuffered surplus of a tolerated oversized element). This
+ * portable version checks 8 bytes per step (SWAR) and finishes the tail byte by
+ * byte; the SIMD variants below fall back to it for their tails.
+ */
+size_t copy_ascii_scalar(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, src + i, 8);
+        if (word & 0x8080808080808080ULL)
+            break; // locate it below
+        if (dst)
+            std::memcpy(dst + i, &word, 8);
+    }
+    for (; i < n; ++i) {
+        if (static_cast<unsigned char>(src[i]) > 127)
             break;
+        if (dst)
+            dst[i] = src[i];
+    }
+    return i;
+}
 
-        case ParserState::READING_DATA:
-            // Buffer only the first MAX_ELEMENT_SIZE bytes; the surplus of a
-            // tolerated oversized element is framed but not stored (and not
-            // ASCII-checked, since the hooks never see it).
-            if (current_read < MAX_ELEMENT_SIZE) {
-                // byte MUST be ascii value
-                // [ISSUE] MS: This is untrue. The Guacamole wire protocol defines element lengths as number of Unicode characters.
-            //             Here you count bytes. The consequence is that any good multi-byte UTF-8 (non-ASCII clibboard text, usernames,
-            //             file names, etc.) fail and this function marks it as stream_corrupted.
-            //             Another observation is that the count is in bytes, a length prefix that is correct in characters and with a
-            //             multibyte (UTF-8) content will break synchronisation of the parser. But this is not seen, while
-            //             your >127 if statement will fail first. I think this is possibly also a problem with RDP sessions.
-                if (static_cast<unsigned char>(c) > 127) {
-                    state = ParserState::STREAM_CORRUPTED;
-                    return state;
-                }
-                element_buffer[current_read] = c;
-            }
-            ++current_read;
-
-            // current_read has advanced to the observed length
-            if (current_read == current_length)
-                state = ParserState::EXPECT_DELIM;
+#if defined(__x86_64__) || defined(__i386__)
+// SSE2 is part of the x86-64 baseline, so this variant needs no dispatch.
+size_t copy_ascii_sse2(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        if (_mm_movemask_epi8(v)) // a byte with its top bit set
             break;
+        if (dst)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    return i + copy_ascii_scalar(dst ? dst + i : nullptr, src + i, n - i);
+}
 
-        case ParserState::EXPECT_DELIM: {
-            // c must be the ',' or ';' that closes the element now sitting in
-            // element_buffer (folds in the diagram's HANDLING_ELEMENT). While
-            // `denying`, validation is skipped — we only parse far enough to
-            // find the instruction's ';' so its whole range can be recorded.
-            if (c != ',' && c != ';') {
-                // This is not a valid delimiter
-                state = ParserState::STREAM_CORRUPTED;
-                return state;
-            }
-
-            if (!denying) {
-                // For a tolerated oversized element only the first
-                // MAX_ELEMENT_SIZE bytes were buffered, so the hook sees a
-                // clamped view.
-                uint32_t elem_len =
-                    current_length > MAX_ELEMENT_SIZE
-                        ? static_cast<uint32_t>(MAX_ELEMENT_SIZE)
-                        : static_cast<uint32_t>(current_length);
-                GuacElement elem{elem_len, element_buffer};
-                bool allowed = reading_opcode ? OnInstructionBegin(elem)
-                                              : OnArgument(elem);
-                if (!allowed) {
-                    // Deny the whole instruction — but only if it started in
-                    // this call. If its head arrived in an earlier datagram it
-                    // was already forwarded, so we cannot recover and the stream
-                    // is corrupted.
-                    if (!opcode_in_this_call) {
-                        state = ParserState::STREAM_CORRUPTED;
-                        return state;
-                    }
-                    denying = true;
-                    reading_opcode = false; // skip the remainder as data
-                } else if (reading_opcode) {
-                    reading_opcode = false;
-                }
-            }
-
-            if (c == ';') {
-                // End of instruction.
-                if (denying) {
-                    // Record its full byte range so the caller can excise it.
-                    // Parse() never mutates data.
-                    denied_ranges.emplace_back(opcode_start_idx,
-                                               i - opcode_start_idx + 1);
-                    denying = false;
-                } else {
-                    OnInstructionEnd();
-                }
-                reading_opcode = true;
-            }
-            // Comma or semicolon: another element/instruction follows
-            current_length = -1;
-            state = ParserState::READING_LENGTH;
+__attribute__((target("avx2"))) size_t copy_ascii_avx2(char *dst,
+                                                        const char *src,
+                                                        size_t n) {
+    size_t i = 0;
+    if (!dst) {
+        // Validate only (an element framed in place): a tighter loop, as the
+        // compiler does not unswitch the dst test at -O2.
+        for (; i + 32 <= n; i += 32) {
+            __m256i v =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            if (_mm256_movemask_epi8(v))
+                break;
+        }
+        return i + copy_ascii_sse2(nullptr, src + i, n - i);
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        if (_mm256_movemask_epi8(v))
             break;
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    }
+    return i + copy_ascii_sse2(dst + i, src + i, n - i);
+}
+
+/*
+ * @brief Whether a 32-byte block is well-formed, complete UTF-8 on its own.
+ *
+ * The lookup-table validator of Keiser & Lemire ("Validating UTF-8 in less
+ * than one instruction per byte"): three nibble lookups classify every
+ * (previous byte, byte) pair into error bits, and the 3rd/4th bytes of long
+ * sequences are checked for being continuations. The block is taken to start
+ * on a code-point boundary (previous bytes zero), and a sequence cut off by
+ * the block's end counts as a failure, so accepted blocks never leave state
+ * behind.
+ */
+__attribute__((target("avx2"))) bool utf8_block_valid_avx2(__m256i input) {
+    constexpr int8_t TOO_SHORT = 1 << 0;  // 11______ 0_______
+    constexpr int8_t TOO_LONG = 1 << 1;   // 0_______ 10______
+    constexpr int8_t OVERLONG_3 = 1 << 2; // 11100000 100_____
+    constexpr int8_t TOO_LARGE = 1 << 3;  // 11110100 1001____
+    constexpr int8_t SURROGATE = 1 << 4;  // 11101101 101_____
+    constexpr int8_t OVERLONG_2 = 1 << 5; // 1100000_ 10______
+    constexpr int8_t TOO_LARGE_1000 = 1 << 6; // 11110100 1000____
+    constexpr int8_t OVERLONG_4 = 1 << 6;     // 11110000 1000____
+    constexpr int8_t TWO_CONTS = static_cast<int8_t>(1 << 7); // 10______ 10______
+    constexpr int8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    const __m256i byte_1_high_table = _mm256_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        // second lane: same table
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m256i byte_1_low_table = _mm256_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY,
+        CARRY, CARRY | TOO_LARGE, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        // second lane: same table
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY,
+        CARRY, CARRY | TOO_LARGE, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m256i byte_2_high_table = _mm256_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+            OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        // second lane: same table
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+            OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    // prev1..prev3: the block shifted right by 1..3 bytes, zeros shifted in.
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i carried = _mm256_permute2x128_si256(zero, input, 0x21);
+    const __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+    const __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+    const __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high_table,
+                                _mm256_and_si256(_mm256_srli_epi16(prev1, 4),
+                                                 nibble)),
+            _mm256_shuffle_epi8(byte_1_low_table,
+                                _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high_table,
+                            _mm256_and_si256(_mm256_srli_epi16(input, 4),
+                                             nibble)));
+
+    // Bytes two or three after a 3- or 4-byte lead must be continuations.
+    const __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80));
+    const __m256i fourth =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i must_continue = _mm256_and_si256(
+        _mm256_or_si256(third, fourth),
+        _mm256_set1_epi8(static_cast<char>(0x80)));
+    __m256i error = _mm256_xor_si256(must_continue, special);
+
+    // A lead among the last three bytes whose sequence runs past the block.
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xF0 - 1),
+        static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    error = _mm256_or_si256(error, _mm256_subs_epu8(input, incomplete_max));
+
+    return _mm256_testz_si256(error, error);
+}
+
+/*
+ * @brief UTF-8 bulk step: whole 32-byte blocks that validate and carry no
+ * more than max_chars code points, then an ASCII tail.
+ *
+ * Code points are counted as non-continuation bytes (signed byte > -65). Stops
+ * in front of the first block that is invalid, ends mid-sequence or would
+ * overrun the element; the caller decodes from there one code point at a time.
+ */
+__attribute__((target("avx2"))) CharRun utf8_run_avx2(char *dst,
+                                                       const char *src,
+                                                       size_t n,
+                                                       long long max_chars) {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    size_t i = 0;
+    long long chars = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        long long leads = 32;
+        if (_mm256_movemask_epi8(v)) {
+            if (!utf8_block_valid_avx2(v))
+                break;
+            leads = __builtin_popcount(static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, last_continuation))));
         }
+        if (chars + leads > max_chars)
+            break;
+        if (dst)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+        chars += leads;
+    }
+    size_t tail = std::min<size_t>(n - i, static_cast<size_t>(max_chars - chars));
+    size_t ascii = copy_ascii_sse2(dst ? dst + i : nullptr, src + i, tail);
+    return {i + ascii, chars + static_cast<long long>(ascii)};
+}
+#elif defined(__aarch64__)
+// NEON is mandatory on AArch64.
+size_t copy_ascii_neon(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+        if (vmaxvq_u8(v) & 0x80)
+            break;
+        if (dst)
+            vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), v);
+    }
+    return i + copy_ascii_scalar(dst ? dst + i : nullptr, src + i, n - i);
+}
+#endif
+
+using CopyAsciiFn = size_t (*)(char *, const char *, size_t);
+using Utf8RunFn = CharRun (*)(char *, const char *, size_t, long long);
 
-        case ParserState::STREAM_CORRUPTED:
-        case ParserState::DENIED_DATA:
-            // Terminal for this call; nothing more is parsed.
-            return state;
+/*
+ * @brief Picks the widest copy_ascii variant this CPU supports (once)
+ */
+CopyAsciiFn select_copy_ascii() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return copy_ascii_avx2;
+    return copy_ascii_sse2;
+#elif defined(__aarch64__)
+    return copy_ascii_neon;
+#else
+    return copy_ascii_scalar;
+#endif
+}
+
+/*
+ * @brief Picks the UTF-8 bulk step: the block validator where AVX2 exists,
+ * otherwise the ASCII step (multi-byte sequences then take the scalar decoder)
+ */
+Utf8RunFn select_utf8_run() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return utf8_run_avx2;
+#endif
+    return element_scan::ascii_run;
+}
+
+/*
+ * @brief Skip-ahead step over element data: counts code points as UTF-8 lead
+ * (non-continuation) bytes without validating anything.
+ *
+ * Stops on the first lead byte once max_chars code points have been counted —
+ * the byte after the element — or at n. So the continuation bytes of the last
+ * code point are consumed with it, even when they arrive in a later call.
+ */
+CharRun skip_chars_scalar(const char *src, size_t n, long long max_chars) {
+    size_t i = 0;
+    long long chars = 0;
+    for (; i < n; ++i) {
+        if (static_cast<signed char>(src[i]) > -65) { // not 10xxxxxx
+            if (chars == max_chars)
+                break;
+            ++chars;
         }
     }
+    return {i, chars};
+}
 
-    // A denied instruction that never reached its ';' cannot be cut cleanly
-    // across datagrams (its head would already be forwarded): corrupt the stream.
-    if (denying) {
-        state = ParserState::STREAM_CORRUPTED;
-        return state;
+#if defined(__x86_64__) || defined(__i386__)
+CharRun skip_chars_sse2(const char *src, size_t n, long long max_chars) {
+    const __m128i last_continuation = _mm_set1_epi8(-65);
+    size_t i = 0;
+    long long chars = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        long long leads = __builtin_popcount(static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(v, last_continuation))));
+        if (chars + leads > max_chars)
+            break; // the element ends in this block
+        chars += leads;
     }
+    CharRun tail = skip_chars_scalar(src + i, n - i, max_chars - chars);
+    return {i + tail.bytes, chars + tail.chars};
+}
 
-    // current_length, current_read and element_buffer persist across calls, so a
-    // Parse() that ends mid-element resumes correctly. A clean boundary rests at
-    // READING_LENGTH with current_length == -1. Report DENIED_DATA when content
-    // was denied but the rest parsed cleanly, so the caller calls Excise(); the
-    // member `state` still holds the true resting state for the next call.
-    if (!denied_ranges.empty())
-        return ParserState::DENIED_DATA;
-    return state;
-}
-
-void OpcodeParser::Excise(char *data, size_t &len) {
-    if (denied_ranges.empty())
-        return;
-
-    // Single compaction pass: copy the kept bytes between the denied ranges
-    // (which are ascending and non-overlapping) down over the gaps.
-    size_t write = 0;
-    size_t read = 0;
-    for (const auto &range : denied_ranges) {
-        size_t keep = range.first - read; // bytes before this denied range
-        if (write != read)
-            std::memmove(data + write, data + read, keep);
-        write += keep;
-        read = range.first + range.second; // skip past the denied range
+__attribute__((target("avx2"))) CharRun
+skip_chars_avx2(const char *src, size_t n, long long max_chars) {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    size_t i = 0;
+    long long chars = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        long long leads = __builtin_popcount(static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, last_continuation))));
+        if (chars + leads > max_chars)
+            break;
+        chars += leads;
     }
-    if (write != read)
-        std::memmove(data + write, data + read, len - read);
-    len = write + (len - read);
+    CharRun tail = skip_chars_sse2(src + i, n - i, max_chars - chars);
+    return {i + tail.bytes, chars + tail.chars};
+}
+#elif defined(__aarch64__)
+CharRun skip_chars_neon(const char *src, size_t n, long long max_chars) {
+    const int8x16_t last_continuation = vdupq_n_s8(-65);
+    size_t i = 0;
+    long long chars = 0;
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t v = vld1q_s8(reinterpret_cast<const int8_t *>(src + i));
+        long long leads =
+            vaddvq_u8(vshrq_n_u8(vcgtq_s8(v, last_continuation), 7));
+        if (chars + leads > max_chars)
+            break;
+        chars += leads;
+    }
+    CharRun tail = skip_chars_scalar(src + i, n - i, max_chars - chars);
+    return {i + tail.bytes, chars + tail.chars};
+}
+#endif
+
+using SkipCharsFn = CharRun (*)(const char *, size_t, long long);
 
-    denied_ranges.clear();
+SkipCharsFn select_skip_chars() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return skip_chars_avx2;
+    return skip_chars_sse2;
+#elif defined(__aarch64__)
+    return skip_chars_neon;
+#else
+    return skip_chars_scalar;
+#endif
 }
 
-void OpcodeParser::Reset() {
-    state = ParserState::READING_LENGTH;
-    current_index = 0;
-    current_length = -1;
-    current_read = 0;
-    reading_opcode = true;
-    opcode_start_idx = 0;
-    denied_ranges.clear();
+} // namespace
+
+namespace element_scan {
+
+size_t copy_ascii(char *dst, const char *src, size_t n) {
+    static const CopyAsciiFn impl = select_copy_ascii();
+    return impl(dst, src, n);
 }
 
+/*
+ * @brief ASCII bulk step: up to max_chars ASCII bytes (one code point each)
+ */
+CharRun ascii_run(char *dst, const char *src, size_t n, long long max_chars) {
+    size_t take = std::min<size_t>(n, static_cast<size_t>(max_chars));
+    size_t ascii = copy_ascii(dst, src, take);
+    return {ascii, static_cast<long long>(ascii)};
+}
+
+CharRun utf8_run(char *dst, const char *src, size_t n, long long max_chars) {
+    static const Utf8RunFn impl = select_utf8_run();
+    return impl(dst, src, n, max_chars);
+}
+
+CharRun skip_chars(const char *src, size_t n, long long max_chars) {
+    static const SkipCharsFn impl = select_skip_chars();
+    return impl(src, n, max_chars);
+}
+
+} // namespace element_scan
+
 bool OpcodeParser::OnInstructionBegin(const GuacElement &opcode) {
     // Neutral framer: allow every opcode. The opcode allowlist is a guard policy
     // and lives in GuardOpcodeParser::OnInstructionBegin.
     (void)opcode;
     return true;
 }
+
+template class OpcodeParserCore<OpcodeParser>;
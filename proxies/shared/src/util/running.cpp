@@ -18,13 +18,6 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-#pragma once
+#include "../../include/util/running.h"
 
-#include <atomic>
-
-/*
- * @brief Process-wide run flag, cleared by the SIGINT handler.
- *
- * Defined in main.cpp; every handler loop polls it to know when to stop.
- */
-extern std::atomic<bool> running;
+std::atomic<bool> running = true;
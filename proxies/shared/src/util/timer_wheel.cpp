@@ -0,0 +1,305 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../../include/util/timer_wheel.h"
+#include <algorithm>
+
+namespace {
+// Rotates right, so that bucket @p by of an occupancy word becomes bit 0.
+uint64_t rotate_right(uint64_t bits, unsigned by) {
+    by &= 63;
+    return by ? (bits >> by) | (bits << (64 - by)) : bits;
+}
+} // namespace
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick)
+    : tick(std::max(tick, std::chrono::milliseconds(1))),
+      start(Clock::now()) {
+    for (auto &level : buckets)
+        level.fill(NIL);
+    worker = std::thread(&TimerWheel::Run, this);
+}
+
+TimerWheel::~TimerWheel() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+}
+
+TimerWheel::TimerId TimerWheel::Arm(std::chrono::milliseconds delay,
+                                    Callback callback,
+                                    std::chrono::milliseconds period) {
+    std::lock_guard<std::mutex> lock(mtx);
+    uint32_t index;
+    if (!free_list.empty()) {
+        index = free_list.back();
+        free_list.pop_back();
+    } else {
+        index = static_cast<uint32_t>(timers.size());
+        timers.emplace_back();
+    }
+    Timer &t = timers[index];
+    t.callback = std::move(callback);
+    t.period = period.count() > 0 ? TicksFor(period) : 0;
+    t.state = State::ARMED;
+    ++armed;
+    Schedule(index, std::max(now_tick, TickNow()) + TicksFor(delay));
+    if (t.expires < wake_tick)
+        cv.notify_one();
+    return (static_cast<uint64_t>(t.generation) << 32) | index;
+}
+
+bool TimerWheel::Rearm(TimerId id, std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(mtx);
+    uint32_t index;
+    Timer *t = Lookup(id, index);
+    if (!t)
+        return false;
+    if (t->state == State::ARMED)
+        Unlink(index);
+    // A FIRING timer is either queued to run (it now will not) or running;
+    // either way it is armed again from here.
+    t->state = State::ARMED;
+    Schedule(index, std::max(now_tick, TickNow()) + TicksFor(delay));
+    if (t->expires < wake_tick)
+        cv.notify_one();
+    return true;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    std::unique_lock<std::mutex> lock(mtx);
+    uint32_t index;
+    Timer *t = Lookup(id, index);
+    if (!t)
+        return false;
+    if (firing == index) {
+        // Running right now: Expire() frees it once the callback returns. Wait
+        // for that unless this is the callback cancelling itself. A Rearm()
+        // meanwhile has linked it into a bucket again; take it out, or the
+        // freed slot would still fire.
+        if (t->state == State::ARMED)
+            Unlink(index);
+        t->state = State::DEAD;
+        --armed;
+        if (std::this_thread::get_id() != thread_id)
+            settled.wait(lock, [this, index] { return firing != index; });
+        return true;
+    }
+    if (t->state == State::ARMED)
+        Unlink(index);
+    Release(index);
+    return true;
+}
+
+size_t TimerWheel::Armed() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return armed;
+}
+
+uint64_t TimerWheel::TicksFor(std::chrono::milliseconds delay) const {
+    if (delay.count() <= 0)
+        return 1;
+    return static_cast<uint64_t>((delay.count() + tick.count() - 1) /
+                                 tick.count());
+}
+
+uint64_t TimerWheel::TickNow() const {
+    return static_cast<uint64_t>((Clock::now() - start) / tick);
+}
+
+TimerWheel::Timer *TimerWheel::Lookup(TimerId id, uint32_t &index) {
+    index = static_cast<uint32_t>(id);
+    if (index >= timers.size())
+        return nullptr;
+    Timer &t = timers[index];
+    if (t.generation != static_cast<uint32_t>(id >> 32) ||
+        t.state == State::FREE || t.state == State::DEAD)
+        return nullptr;
+    return &t;
+}
+
+void TimerWheel::Schedule(uint32_t index, uint64_t expires) {
+    timers[index].expires = std::max(expires, now_tick + 1);
+    Place(index);
+}
+
+void TimerWheel::Place(uint32_t index) {
+    Timer &t = timers[index];
+    uint64_t delta = t.expires > now_tick ? t.expires - now_tick : 0;
+
+    // The lowest level whose turn still reaches the expiry. Beyond the top
+    // level's turn the timer waits in its last bucket and is placed again
+    // when that comes around.
+    size_t level = 0;
+    while (level + 1 < LEVELS && delta >> (SLOT_BITS * (level + 1)))
+        ++level;
+    uint64_t at = t.expires;
+    uint64_t span = uint64_t(1) << (SLOT_BITS * LEVELS);
+    if (delta >= span)
+        at = now_tick + span - 1;
+    size_t slot = (at >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+    t.level = static_cast<uint8_t>(level);
+    t.slot = static_cast<uint8_t>(slot);
+    t.prev = NIL;
+    t.next = buckets[level][slot];
+    if (t.next != NIL)
+        timers[t.next].prev = index;
+    buckets[level][slot] = index;
+    occupied[level] |= uint64_t(1) << slot;
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Timer &t = timers[index];
+    if (t.prev != NIL)
+        timers[t.prev].next = t.next;
+    else
+        buckets[t.level][t.slot] = t.next;
+    if (t.next != NIL)
+        timers[t.next].prev = t.prev;
+    if (buckets[t.level][t.slot] == NIL)
+        occupied[t.level] &= ~(uint64_t(1) << t.slot);
+    t.prev = t.next = NIL;
+}
+
+void TimerWheel::Release(uint32_t index) {
+    Timer &t = timers[index];
+    if (t.state != State::DEAD)
+        --armed;
+    t.callback = nullptr;
+    t.state = State::FREE;
+    if (++t.generation == 0)
+        t.generation = 1;
+    free_list.push_back(index);
+}
+
+uint64_t TimerWheel::NextEvent() const {
+    // Level 0 buckets fire on their own tick; higher-level buckets matter only
+    // when the level below wraps onto them and they are spread out again.
+    uint64_t next = UINT64_MAX;
+    for (size_t level = 0; level < LEVELS; ++level) {
+        if (!occupied[level])
+            continue;
+        unsigned shift = static_cast<unsigned>(SLOT_BITS * level);
+        uint64_t turn = now_tick >> shift;
+        unsigned cur = static_cast<unsigned>(turn & (SLOTS - 1));
+        uint64_t ahead = rotate_right(occupied[level], cur + 1);
+        uint64_t steps = static_cast<uint64_t>(__builtin_ctzll(ahead)) + 1;
+        next = std::min(next, (turn + steps) << shift);
+    }
+    return next;
+}
+
+void TimerWheel::Advance(uint64_t target, std::vector<uint32_t> &due) {
+    while (now_tick < target) {
+        // Nothing happens on the ticks in between: skip straight over them.
+        uint64_t next = NextEvent();
+        if (next > target) {
+            now_tick = target;
+            return;
+        }
+        now_tick = next;
+
+        for (size_t level = 1; level < LEVELS; ++level) {
+            unsigned shift = static_cast<unsigned>(SLOT_BITS * level);
+            if (now_tick & ((uint64_t(1) << shift) - 1))
+                break;
+            size_t slot = (now_tick >> shift) & (SLOTS - 1);
+            uint32_t index = buckets[level][slot];
+            buckets[level][slot] = NIL;
+            occupied[level] &= ~(uint64_t(1) << slot);
+            while (index != NIL) {
+                uint32_t next_index = timers[index].next;
+                Place(index);
+                index = next_index;
+            }
+        }
+
+        size_t slot = now_tick & (SLOTS - 1);
+        uint32_t index = buckets[0][slot];
+        buckets[0][slot] = NIL;
+        occupied[0] &= ~(uint64_t(1) << slot);
+        while (index != NIL) {
+            Timer &t = timers[index];
+            uint32_t next_index = t.next;
+            t.prev = t.next = NIL;
+            t.state = State::FIRING;
+            due.push_back(index);
+            index = next_index;
+        }
+    }
+}
+
+void TimerWheel::Expire(std::vector<uint32_t> &due,
+                        std::unique_lock<std::mutex> &lock) {
+    for (uint32_t index : due) {
+        Timer &t = timers[index];
+        if (t.state != State::FIRING)
+            continue; // cancelled or re-armed while queued
+
+        // Run without the lock so the callback (and everyone else) can arm and
+        // cancel. Cancel() from another thread waits on `settled` meanwhile,
+        // and a deque never moves `t`, so the callback stays in place.
+        firing = index;
+        lock.unlock();
+        t.callback();
+        lock.lock();
+        firing = NIL;
+        settled.notify_all();
+
+        if (t.state == State::DEAD) {
+            Release(index);
+        } else if (t.state == State::FIRING) {
+            if (t.period) {
+                t.state = State::ARMED;
+                Schedule(index, std::max(now_tick, TickNow()) + t.period);
+            } else {
+                Release(index);
+            }
+        }
+    }
+    due.clear();
+}
+
+void TimerWheel::Run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    thread_id = std::this_thread::get_id();
+    std::vector<uint32_t> due;
+    while (!stopping) {
+        Advance(TickNow(), due);
+        if (!due.empty()) {
+            Expire(due, lock);
+            continue;
+        }
+
+        // Sleep until the next bucket with a timer comes around, or for good
+        // while nothing is armed; Arm() wakes us for anything sooner.
+        wake_tick = NextEvent();
+        if (wake_tick == UINT64_MAX)
+            cv.wait(lock);
+        else
+            cv.wait_until(lock,
+                          start + tick * static_cast<int64_t>(wake_tick));
+        wake_tick = UINT64_MAX;
+    }
+}
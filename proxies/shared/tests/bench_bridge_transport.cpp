@@ -0,0 +1,147 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/network/bridge_transport.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+/*
+ * Bridge hop harness for UDP loopback versus the shared-memory ring and the
+ * in-process queue; run it with `meson test --benchmark`.
+ *
+ * Bounces a message between two threads over a pair of bridge hops (there and
+ * back, as a request and its echo) and reports the mean round trip, then
+ * streams one way and reports the rate the receiver keeps up with.
+ * BRIDGE_BENCH_OPS sets the round trips per run (default 20000).
+ */
+
+namespace {
+
+constexpr int PORT = 42000;
+constexpr size_t MESSAGE_SIZE = 512; // a typical display instruction
+
+struct Hop {
+    std::unique_ptr<BridgeSender> sender;
+    std::unique_ptr<BridgeReceiver> receiver;
+};
+
+Hop make_hop(int port) {
+    Hop hop{MakeBridgeSender("127.0.0.1", port), MakeBridgeReceiver(port)};
+    assert(hop.receiver->Initialize() == 0);
+    assert(hop.sender->Initialize() == 0);
+    return hop;
+}
+
+int receive(BridgeReceiver &receiver, char *buf, size_t len) {
+    int n;
+    while ((n = receiver.Receive(buf, len)) == 0) {
+    }
+    return n;
+}
+
+double round_trip_us(size_t ops) {
+    Hop there = make_hop(PORT);
+    Hop back = make_hop(PORT + 1);
+
+    std::thread echo([&]() {
+        char buf[MESSAGE_SIZE + 1];
+        for (size_t i = 0; i < ops; ++i) {
+            int n = receive(*there.receiver, buf, sizeof(buf));
+            back.sender->Send(buf, static_cast<size_t>(n));
+        }
+    });
+
+    char msg[MESSAGE_SIZE];
+    std::memset(msg, 'x', sizeof(msg));
+    char buf[MESSAGE_SIZE + 1];
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        there.sender->Send(msg, sizeof(msg));
+        assert(receive(*back.receiver, buf, sizeof(buf)) ==
+               static_cast<int>(MESSAGE_SIZE));
+    }
+    std::chrono::duration<double, std::micro> took =
+        std::chrono::steady_clock::now() - start;
+    echo.join();
+    return took.count() / ops;
+}
+
+// Messages per second a receiver takes in while the sender writes flat out;
+// the rest are dropped, as they would be on the bridge.
+double stream_rate(size_t ops) {
+    Hop hop = make_hop(PORT + 2);
+    std::atomic<bool> done{false};
+    size_t received = 0;
+    std::thread reader([&]() {
+        char buf[MESSAGE_SIZE + 1];
+        while (!done.load())
+            if (hop.receiver->Receive(buf, sizeof(buf)) > 0)
+                ++received;
+    });
+
+    char msg[MESSAGE_SIZE];
+    std::memset(msg, 'x', sizeof(msg));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i)
+        hop.sender->Send(msg, sizeof(msg));
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+    done = true;
+    hop.receiver->Interrupt();
+    reader.join();
+    std::cout << "  stream: " << received << "/" << ops << " received"
+              << std::endl;
+    return ops / took.count();
+}
+
+} // namespace
+
+int main() {
+    const char *env = std::getenv("BRIDGE_BENCH_OPS");
+    int v = env ? std::atoi(env) : 0;
+    size_t ops = v > 0 ? static_cast<size_t>(v) : 20000;
+
+    char dir[] = "/tmp/gdd-shm-XXXXXX";
+    assert(::mkdtemp(dir) != nullptr);
+    setenv("BRIDGE_SHM_DIR", dir, 1);
+
+    for (const char *transport : {"udp", "shm", "mem"}) {
+        setenv("BRIDGE_TRANSPORT", transport, 1);
+        std::cout << transport << ":" << std::endl;
+        double rtt = round_trip_us(ops);
+        double rate = stream_rate(ops * 10);
+        std::cout << "  round trip " << rtt << " us, sent " << rate
+                  << " messages/s" << std::endl;
+    }
+
+    for (int port = PORT; port <= PORT + 2; ++port)
+        ::unlink((std::string(dir) + "/gdd-bridge-" + std::to_string(port))
+                     .c_str());
+    ::rmdir(dir);
+    return 0;
+}
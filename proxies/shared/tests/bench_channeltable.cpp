@@ -0,0 +1,121 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/network/channeltable.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/*
+ * Channel churn harness for the channel table; run it with
+ * `meson test --benchmark`.
+ *
+ * Fills the table to a given occupancy, then repeatedly closes a random live
+ * channel and allocates a new one, as a busy broker's accept and reader
+ * threads do. Reports the mean cost of one close + allocate for the bitmap
+ * allocator and, for comparison, for a slot-by-slot scan from the same
+ * round-robin cursor. CHANNEL_BENCH_OPS sets the churn per run (default
+ * 200000).
+ */
+
+namespace {
+
+// The scan the bitmap allocator replaced: probe slots from the cursor on.
+class ScanTable {
+  public:
+    ScanTable() : fds(new std::atomic<int>[ChannelTable::CHANNELS]) {
+        for (size_t i = 0; i < ChannelTable::CHANNELS; ++i)
+            fds[i] = -1;
+    }
+
+    std::optional<uint16_t> Allocate(int fd) {
+        for (size_t i = 0; i < ChannelTable::CHANNELS; ++i) {
+            uint16_t channel = static_cast<uint16_t>(cursor + i);
+            int expected = -1;
+            if (fds[channel].compare_exchange_strong(expected, fd)) {
+                cursor = static_cast<uint16_t>(channel + 1);
+                return channel;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<int> Remove(uint16_t channel) {
+        int fd = fds[channel].exchange(-1);
+        if (fd < 0)
+            return std::nullopt;
+        return fd;
+    }
+
+  private:
+    std::unique_ptr<std::atomic<int>[]> fds;
+    uint16_t cursor = 0;
+};
+
+template <typename Table> double churn_ns(Table &table, size_t live,
+                                          size_t ops) {
+    std::vector<uint16_t> open;
+    open.reserve(live);
+    for (size_t i = 0; i < live; ++i)
+        open.push_back(*table.Allocate(3));
+
+    std::mt19937 rng(1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        size_t victim = rng() % open.size();
+        assert(table.Remove(open[victim]));
+        std::optional<uint16_t> channel = table.Allocate(3);
+        assert(channel);
+        open[victim] = *channel;
+    }
+    std::chrono::duration<double, std::nano> took =
+        std::chrono::steady_clock::now() - start;
+    return took.count() / ops;
+}
+
+} // namespace
+
+int main() {
+    const char *env = std::getenv("CHANNEL_BENCH_OPS");
+    int v = env ? std::atoi(env) : 0;
+    size_t ops = v > 0 ? static_cast<size_t>(v) : 200000;
+
+    for (double occupancy : {0.5, 0.99, 0.999}) {
+        size_t live = static_cast<size_t>(ChannelTable::CHANNELS * occupancy);
+        // No quarantine, so the comparison with the scan is like for like.
+        ChannelTable bitmap(0ms);
+        ScanTable scan;
+        double bitmap_ns = churn_ns(bitmap, live, ops);
+        // The scan is slow enough near full to cap its run.
+        double scan_ns = churn_ns(scan, live, ops / 10);
+        std::cout << "occupancy " << occupancy * 100 << "% (" << live
+                  << " live): bitmap " << bitmap_ns << " ns, scan " << scan_ns
+                  << " ns per close + allocate" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/util/latency_histogram.h"
+#include "../include/util/sockprofile.h"
+#include <arpa/inet.h>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+/*
+ * Keystroke-to-paint latency harness for the socket profiles; run it with
+ * `meson test --benchmark`.
+ *
+ * Models the two TCP legs of the pipeline on loopback: a web server sends a
+ * key press and, a moment later, its release; a relay (the brokers) forwards
+ * each as its own write, the way a bridge message is written to guacd; a
+ * guacd stand-in paints (replies) once it has the release, and the relay
+ * writes the paint back. The press is still unacknowledged when the release
+ * is written, which is exactly what Nagle holds back. The profile under test
+ * is applied to the relay's two sockets, as the brokers would; the web server
+ * and guacd ends are always interactive, so only the relay differs. Reports
+ * release-to-paint latency per profile over PROFILE_BENCH_KEYS keys (default
+ * 200).
+ */
+
+namespace {
+
+int listen_loopback(int &port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    assert(::listen(fd, 1) == 0);
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+int dial_loopback(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+           0);
+    return fd;
+}
+
+// Copies every read from one socket to another as one write, until EOF.
+void pump(int from, int to) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::recv(from, buf, sizeof(buf), 0)) > 0)
+        ::send(to, buf, n, MSG_NOSIGNAL);
+    ::shutdown(to, SHUT_WR);
+}
+
+void run(SocketProfile profile, int keys) {
+    // guacd stand-in: paints once per release ('R').
+    int guacd_port;
+    int guacd_listen = listen_loopback(guacd_port);
+    std::thread guacd([guacd_listen]() {
+        int fd = ::accept(guacd_listen, nullptr, nullptr);
+        apply_socket_profile(fd, SocketProfile::INTERACTIVE);
+        char c;
+        const char paint[] = "3.img,1.0;4.sync,1.0;";
+        while (::recv(fd, &c, 1, 0) == 1)
+            if (c == 'R')
+                ::send(fd, paint, sizeof(paint) - 1, MSG_NOSIGNAL);
+        ::close(fd);
+    });
+
+    // The relay, with the profile on both of its sockets.
+    int relay_port;
+    int relay_listen = listen_loopback(relay_port);
+    int web = dial_loopback(relay_port);
+    apply_socket_profile(web, SocketProfile::INTERACTIVE);
+    int relay_web = ::accept(relay_listen, nullptr, nullptr);
+    int relay_guacd = dial_loopback(guacd_port);
+    apply_socket_profile(relay_web, profile);
+    apply_socket_profile(relay_guacd, profile);
+    std::thread forward(pump, relay_web, relay_guacd);
+    std::thread back(pump, relay_guacd, relay_web);
+
+    LatencyHistogram latency;
+    char paint[64];
+    for (int i = 0; i < keys; ++i) {
+        ::send(web, "P", 1, 0);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        auto released = std::chrono::steady_clock::now();
+        ::send(web, "R", 1, 0);
+        ssize_t n = ::recv(web, paint, sizeof(paint), 0);
+        assert(n > 0);
+        latency.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - released)
+                           .count());
+        // Keystrokes are human-paced, not back to back.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    ::shutdown(web, SHUT_WR);
+    forward.join();
+    back.join();
+    guacd.join();
+    for (int fd : {web, relay_web, relay_guacd, relay_listen, guacd_listen})
+        ::close(fd);
+
+    std::cout << "profile " << socket_profile_name(profile)
+              << ": release-to-paint " << latency.Summary() << std::endl;
+}
+
+} // namespace
+
+int main() {
+    const char *env = std::getenv("PROFILE_BENCH_KEYS");
+    int keys = env && std::atoi(env) > 0 ? std::atoi(env) : 200;
+    run(SocketProfile::DEFAULT, keys);
+    run(SocketProfile::INTERACTIVE, keys);
+    run(SocketProfile::BULK, keys);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/network/channeltable.h"
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+/**
+ * @brief Channels are handed out round-robin; a removed one is not the next
+ * one handed out even with no quarantine
+ */
+void test_round_robin() {
+    ChannelTable table(0ms);
+    assert(table.Allocate(10) == 0);
+    assert(table.Allocate(11) == 1);
+    assert(table.Allocate(12) == 2);
+    assert(table.Get(1) == 11);
+
+    assert(table.Remove(1) == 11);
+    assert(!table.Remove(1));
+    assert(!table.Get(1));
+    assert(table.Allocate(13) == 3);
+}
+
+/**
+ * @brief A full table refuses to allocate until a channel is removed, and then
+ * finds that one wherever the cursor is
+ */
+void test_full() {
+    ChannelTable table(0ms);
+    for (size_t i = 0; i < ChannelTable::CHANNELS; ++i)
+        assert(table.Allocate(100) == static_cast<uint16_t>(i));
+    assert(!table.Allocate(100));
+
+    assert(table.Remove(40000));
+    assert(table.Allocate(7) == 40000);
+    assert(!table.Allocate(7));
+
+    assert(table.Remove(5));
+    assert(table.Allocate(8) == 5); // found by wrapping past the end
+}
+
+/**
+ * @brief A removed channel is held back until its quarantine is over
+ */
+void test_quarantine() {
+    ChannelTable table(50ms);
+    for (size_t i = 0; i < ChannelTable::CHANNELS; ++i)
+        assert(table.Allocate(100));
+    assert(table.Remove(123));
+    assert(!table.Allocate(9));
+
+    std::this_thread::sleep_for(80ms);
+    assert(table.Allocate(9) == 123);
+}
+
+/**
+ * @brief Peer-chosen channels are taken out of circulation for Allocate, and
+ * may reuse an id the local side still has quarantined
+ */
+void test_insert() {
+    ChannelTable table(10s);
+    assert(table.Insert(0, 20));
+    assert(!table.Insert(0, 21));
+    assert(table.Allocate(22) == 1);
+
+    assert(table.Remove(0));
+    assert(table.Insert(0, 23));
+    assert(table.Get(0) == 23);
+
+    ChannelAllocator allocator(10s);
+    assert(allocator.Claim(3));
+    allocator.Release(3);
+    assert(allocator.Quarantined() == 1);
+    allocator.Release(3); // not held: ignored
+    assert(allocator.Quarantined() == 1);
+}
+
+/**
+ * @brief An id Claim()ed during its quarantine and released again waits out
+ * the new quarantine, not the rest of the first one
+ */
+void test_claim_quarantined() {
+    ChannelAllocator allocator(200ms);
+    for (size_t i = 0; i < ChannelAllocator::IDS; ++i)
+        assert(allocator.Acquire());
+    allocator.Release(7);
+
+    std::this_thread::sleep_for(100ms);
+    assert(allocator.Claim(7));
+    allocator.Release(7);
+    assert(allocator.Quarantined() == 2);
+
+    std::this_thread::sleep_for(150ms); // the first hold is over
+    assert(!allocator.Acquire());
+    assert(allocator.Quarantined() == 1);
+
+    std::this_thread::sleep_for(100ms);
+    assert(allocator.Acquire() == 7);
+}
+
+/**
+ * @brief Unit tests for the channel table's allocator
+ */
+int main() {
+    test_round_robin();
+
+    test_full();
+
+    test_quarantine();
+
+    test_insert();
+
+    test_claim_quarantined();
+
+    return 0;
+}
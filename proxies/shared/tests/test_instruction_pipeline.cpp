@@ -0,0 +1,143 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/parser/instruction_pipeline.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Records every hook it sees as "opcode(arg,arg)" and denies one opcode
+ */
+class Recorder : public InstructionObserver {
+  public:
+    explicit Recorder(std::string deny = "") : deny(std::move(deny)) {}
+
+    bool OnInstructionBegin(const GuacElement &instr) {
+        seen.emplace_back(instr.View());
+        seen.back() += '(';
+        return instr.View() != deny;
+    }
+    bool OnArgument(const GuacElement &arg) {
+        if (seen.back().back() != '(')
+            seen.back() += ',';
+        seen.back().append(arg.View());
+        return true;
+    }
+    bool OnInstructionEnd() {
+        seen.back() += ')';
+        return true;
+    }
+
+    std::vector<std::string> seen;
+
+  private:
+    std::string deny;
+};
+
+// Run one chunk through the pipeline and return what is left of it.
+template <typename Pipeline>
+static std::string run(Pipeline &p, const std::string &s,
+                       bool expect_framed = true) {
+    std::string buf = s;
+    size_t len = buf.size();
+    assert(p.Run(buf.data(), len) == expect_framed);
+    return std::string(buf.data(), len);
+}
+
+/**
+ * @brief Every observer sees every instruction of the one pass, in order
+ */
+void test_fan_out() {
+    Recorder a, b;
+    InstructionPipeline<Recorder, Recorder> p(a, b);
+    const std::string in = "3.key,3.109,1.1;5.mouse,1.1,1.2,1.0;";
+    assert(run(p, in) == in);
+    std::vector<std::string> want = {"key(109,1)", "mouse(1,2,0)"};
+    assert(a.seen == want);
+    assert(b.seen == want);
+}
+
+/**
+ * @brief An instruction any observer denies is excised; the others still see
+ * its opcode but not the rest of it
+ */
+void test_excision() {
+    Recorder watcher, policy("nop");
+    InstructionPipeline<Recorder, Recorder> p(watcher, policy);
+    assert(run(p, "3.key,1.1,1.1;3.nop;4.sync,1.5;") == "3.key,1.1,1.1;4.sync,1.5;");
+    std::vector<std::string> want = {"key(1,1)", "nop(", "sync(5)"};
+    assert(watcher.seen == want);
+
+    // A policy ahead of the watcher: the watcher still sees the opcode.
+    Recorder first("sync"), second;
+    InstructionPipeline<Recorder, Recorder> q(first, second);
+    assert(run(q, "4.sync,1.5,1.6;3.key,1.1,1.1;") == "3.key,1.1,1.1;");
+    assert(second.seen[0] == "sync(");
+    assert(second.seen[1] == "key(1,1)");
+}
+
+/**
+ * @brief Instructions split across chunks are framed across them
+ */
+void test_split_chunks() {
+    Recorder r("nop");
+    InstructionPipeline<Recorder> p(r);
+    assert(run(p, "5.mouse,1.1,") == "5.mouse,1.1,");
+    assert(run(p, "1.2,1.0;3.nop;") == "1.2,1.0;");
+    assert(r.seen[0] == "mouse(1,2,0)");
+}
+
+/**
+ * @brief Fail open: an unframeable chunk is left untouched, and the pipeline
+ * resyncs after the bad byte so the rest is still observed
+ */
+void test_fail_open() {
+    Recorder r("nop");
+    InstructionPipeline<Recorder> p(r);
+    const std::string in = "x3.nop;3.key,1.1,1.1;";
+    assert(run(p, in, false) == in); // not excised either
+    assert(r.seen.size() == 2 && r.seen[1] == "key(1,1)");
+    // Later chunks are filtered again.
+    assert(run(p, "3.nop;") == "");
+}
+
+/**
+ * @brief Large elements are framed past, not treated as corruption
+ */
+void test_oversized() {
+    Recorder r;
+    InstructionPipeline<Recorder> p(r);
+    std::string big(20000, 'a');
+    std::string in = "4.blob,1.0," + std::to_string(big.size()) + "." + big + ";";
+    assert(run(p, in) == in);
+    assert(r.seen.size() == 1);
+}
+
+int main() {
+    test_fan_out();
+    test_excision();
+    test_split_chunks();
+    test_fail_open();
+    test_oversized();
+    std::cout << "all InstructionPipeline tests passed" << std::endl;
+    return 0;
+}
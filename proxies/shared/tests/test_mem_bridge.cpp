@@ -0,0 +1,125 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/network/mem_bridge.h"
+#include "../include/network/multiplexer.h"
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string receive(MemBridgeReceiver &receiver) {
+    char buf[Multiplexer::MAX_DATAGRAM_SIZE + 1];
+    int n = receiver.Receive(buf, sizeof(buf));
+    assert(n >= 0);
+    return std::string(buf, static_cast<size_t>(n));
+}
+
+void send(MemBridgeSender &sender, const std::string &msg) {
+    assert(sender.Send(msg.data(), msg.size()) ==
+           static_cast<ssize_t>(msg.size()));
+}
+
+} // namespace
+
+/**
+ * @brief Messages arrive whole and in order; an idle hop times out empty
+ */
+void test_order() {
+    MemBridgeSender sender(43000);
+    assert(sender.Initialize() == 0);
+    MemBridgeReceiver receiver(43000);
+    assert(receiver.Initialize() == 0);
+
+    for (int i = 0; i < 100; ++i)
+        send(sender, "4.sync," + std::to_string(i) + ";");
+    for (int i = 0; i < 100; ++i)
+        assert(receive(receiver) == "4.sync," + std::to_string(i) + ";");
+    assert(receive(receiver).empty());
+
+    // Oversized messages are refused, as a datagram would be.
+    std::string big(Multiplexer::MAX_DATAGRAM_SIZE + 1, 'x');
+    assert(sender.Send(big.data(), big.size()) == -1);
+
+    // Hops are told apart by port.
+    MemBridgeReceiver other(43001);
+    assert(other.Initialize() == 0);
+    send(sender, "3.nop;");
+    assert(receive(other).empty());
+    assert(receive(receiver) == "3.nop;");
+}
+
+/**
+ * @brief A full hop drops new messages instead of blocking the sender
+ */
+void test_full() {
+    setenv("BRIDGE_MEM_SLOTS", "8", 1);
+    MemBridgeSender sender(43002);
+    assert(sender.Initialize() == 0);
+    MemBridgeReceiver receiver(43002);
+    assert(receiver.Initialize() == 0);
+
+    for (int i = 0; i < 20; ++i)
+        send(sender, std::to_string(i));
+    assert(MemHop::ForPort(43002)->Dropped() == 12);
+    for (int i = 0; i < 8; ++i)
+        assert(receive(receiver) == std::to_string(i));
+    assert(receive(receiver).empty());
+
+    // Space again once drained.
+    send(sender, "20");
+    assert(receive(receiver) == "20");
+    unsetenv("BRIDGE_MEM_SLOTS");
+}
+
+/**
+ * @brief Interrupt() wakes a waiting Receive() well before its timeout
+ */
+void test_interrupt() {
+    MemBridgeReceiver receiver(43003);
+    assert(receiver.Initialize() == 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread waker([&receiver]() {
+        std::this_thread::sleep_for(20ms);
+        receiver.Interrupt();
+    });
+    assert(receive(receiver).empty());
+    waker.join();
+    assert(std::chrono::steady_clock::now() - start < 150ms);
+}
+
+/**
+ * @brief Unit tests for the in-process bridge transport
+ */
+int main() {
+    test_order();
+
+    test_full();
+
+    test_interrupt();
+
+    return 0;
+}
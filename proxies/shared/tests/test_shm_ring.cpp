@@ -0,0 +1,248 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/network/shm_ring.h"
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr int PORT = 41000;
+
+std::string receive(ShmRingReceiver &receiver) {
+    char buf[ShmRingSlot::DATA_SIZE + 1];
+    int n = receiver.Receive(buf, sizeof(buf));
+    assert(n >= 0);
+    return std::string(buf, static_cast<size_t>(n));
+}
+
+// Without futex_waitv (before Linux 5.16) Receive() notices an Interrupt()
+// racing its wait only when that wait runs out.
+bool have_futex_waitv() {
+#ifdef SYS_futex_waitv
+    return ::syscall(SYS_futex_waitv, nullptr, 0, 0, nullptr, 0) == -1 &&
+           errno != ENOSYS;
+#else
+    return false;
+#endif
+}
+
+void send(ShmRingSender &sender, const std::string &msg) {
+    assert(sender.Send(msg.data(), msg.size()) ==
+           static_cast<ssize_t>(msg.size()));
+}
+
+} // namespace
+
+/**
+ * @brief Messages arrive whole and in order; an idle ring times out empty
+ */
+void test_order() {
+    ShmRingSender sender(PORT);
+    assert(sender.Initialize() == 0);
+    ShmRingReceiver receiver(PORT);
+    assert(receiver.Initialize() == 0);
+
+    for (int i = 0; i < 100; ++i)
+        send(sender, "4.sync," + std::to_string(i) + ";");
+    for (int i = 0; i < 100; ++i)
+        assert(receive(receiver) == "4.sync," + std::to_string(i) + ";");
+    assert(receive(receiver).empty());
+    assert(receiver.Dropped() == 0);
+
+    // Oversized messages are refused, as a datagram would be.
+    std::string big(ShmRingSlot::DATA_SIZE + 1, 'x');
+    assert(sender.Send(big.data(), big.size()) == -1);
+}
+
+/**
+ * @brief A receiver that falls more than a ring behind loses the oldest
+ * messages and carries on with the newest
+ */
+void test_lap() {
+    setenv("BRIDGE_SHM_SLOTS", "8", 1);
+    ShmRingSender sender(PORT);
+    assert(sender.Initialize() == 0);
+    ShmRingReceiver receiver(PORT);
+    assert(receiver.Initialize() == 0);
+
+    for (int i = 0; i < 20; ++i)
+        send(sender, std::to_string(i));
+    for (int i = 12; i < 20; ++i)
+        assert(receive(receiver) == std::to_string(i));
+    assert(receiver.Dropped() == 12);
+    unsetenv("BRIDGE_SHM_SLOTS");
+}
+
+/**
+ * @brief Interrupt() ends a waiting Receive() early
+ */
+void test_interrupt() {
+    ShmRingSender sender(PORT);
+    assert(sender.Initialize() == 0);
+    ShmRingReceiver receiver(PORT);
+    assert(receiver.Initialize() == 0);
+
+    std::thread waker([&receiver]() {
+        std::this_thread::sleep_for(20ms);
+        receiver.Interrupt();
+    });
+    auto start = std::chrono::steady_clock::now();
+    assert(receive(receiver).empty());
+    assert(std::chrono::steady_clock::now() - start <
+           BridgeReceiver::RECEIVE_WAIT);
+    waker.join();
+
+    // A message wakes it as well.
+    std::thread writer([&sender]() {
+        std::this_thread::sleep_for(20ms);
+        send(sender, "hello");
+    });
+    assert(receive(receiver) == "hello");
+    writer.join();
+}
+
+/**
+ * @brief An Interrupt() racing the start of Receive()'s wait is never lost
+ */
+void test_interrupt_race() {
+    ShmRingSender sender(PORT);
+    assert(sender.Initialize() == 0);
+    ShmRingReceiver receiver(PORT);
+    assert(receiver.Initialize() == 0);
+
+    // A lost Interrupt() costs a whole wait; without futex_waitv that is
+    // expected, but it must still be noticed after one wait.
+    auto limit = have_futex_waitv() ? BridgeReceiver::RECEIVE_WAIT
+                                    : 2 * BridgeReceiver::RECEIVE_WAIT;
+
+    // Sweep the Interrupt() across the few microseconds between Receive()'s
+    // check of the flag and its sleep.
+    std::atomic<bool> go{false};
+    for (int i = 0; i < 200; ++i) {
+        std::thread waker([&receiver, &go, i]() {
+            while (!go.load())
+                ;
+            for (volatile int spin = 0; spin < i * 10; ++spin)
+                ;
+            receiver.Interrupt();
+        });
+        auto start = std::chrono::steady_clock::now();
+        go.store(true);
+        assert(receive(receiver).empty());
+        assert(std::chrono::steady_clock::now() - start < limit);
+        waker.join();
+        go.store(false);
+    }
+}
+
+/**
+ * @brief A receiver started before its sender, and kept across a sender
+ * restart, follows it to the new ring
+ */
+void test_restart() {
+    ShmRingReceiver receiver(PORT + 1);
+    assert(receiver.Initialize() == 0);
+    assert(receive(receiver).empty()); // no sender yet
+
+    {
+        ShmRingSender sender(PORT + 1);
+        assert(sender.Initialize() == 0);
+        send(sender, "first"); // before the receiver has attached
+        assert(receive(receiver) == "first");
+    }
+
+    ShmRingSender restarted(PORT + 1);
+    assert(restarted.Initialize() == 0);
+    assert(receive(receiver).empty()); // idle: notices the new file
+    send(restarted, "second");
+    assert(receive(receiver) == "second");
+}
+
+/**
+ * @brief Rings are private to the sender, and a receiver refuses a ring that
+ * others could have written; a sender refuses a directory others can write to
+ */
+void test_permissions(const char *dir) {
+    {
+        ShmRingSender sender(PORT + 2);
+        assert(sender.Initialize() == 0);
+        struct stat st{};
+        assert(::stat(shm_ring_path(PORT + 2).c_str(), &st) == 0);
+        assert((st.st_mode & 0777) == 0600);
+    }
+
+    // A planted ring, here one that anyone may write to, is never read.
+    ShmRingReceiver receiver(PORT + 2);
+    assert(::chmod(shm_ring_path(PORT + 2).c_str(), 0666) == 0);
+    assert(receiver.Initialize() == 0);
+    assert(receive(receiver).empty());
+    // Group-readable without BRIDGE_SHM_GID is refused as well.
+    assert(::chmod(shm_ring_path(PORT + 2).c_str(), 0640) == 0);
+    assert(receive(receiver).empty());
+
+    // A ring directory anyone can write to, like /dev/shm itself.
+    assert(::chmod(dir, 0777) == 0);
+    ShmRingSender sender(PORT + 2);
+    assert(sender.Initialize() != 0);
+    assert(::chmod(dir, 0700) == 0);
+    assert(sender.Initialize() == 0);
+    send(sender, "private");
+    assert(receive(receiver) == "private");
+}
+
+/**
+ * @brief Unit tests for the shared-memory ring bridge transport
+ */
+int main() {
+    char dir[] = "/tmp/gdd-shm-XXXXXX";
+    assert(::mkdtemp(dir) != nullptr);
+    setenv("BRIDGE_SHM_DIR", dir, 1);
+
+    test_order();
+
+    test_lap();
+
+    test_interrupt();
+
+    test_interrupt_race();
+
+    test_restart();
+
+    test_permissions(dir);
+
+    ::unlink(shm_ring_path(PORT).c_str());
+    ::unlink(shm_ring_path(PORT + 1).c_str());
+    ::unlink(shm_ring_path(PORT + 2).c_str());
+    ::rmdir(dir);
+    return 0;
+}
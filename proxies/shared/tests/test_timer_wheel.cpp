@@ -0,0 +1,213 @@
+/*
+ * Guacamole Data Diode - Secure remote access using the Guacamole remote access using data-diodes.
+ * Copyright (C) 2020-2026  Maurice Snoeren, Simon de Cock
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "../include/util/timer_wheel.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// Polls @p done for up to two seconds.
+template <typename Pred> bool wait_for(Pred done) {
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief One-shot timers fire once, in expiry order, no earlier than asked —
+ * including ones that start on a higher level and are moved down
+ */
+void test_order() {
+    using Clock = std::chrono::steady_clock;
+    TimerWheel wheel(1ms);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> delay(1, 400);
+
+    // Arming all of them takes a while (more so on a busy machine), so each
+    // timer's expiry is bracketed by the clock just before and after its own
+    // Arm(), rounded out by a tick either way.
+    struct Expiry {
+        Clock::time_point earliest, latest;
+    };
+    struct Fired {
+        int timer;
+        Clock::time_point at;
+    };
+    const int count = 200;
+    std::vector<Expiry> expiry(count);
+    std::mutex mtx;
+    std::vector<Fired> fired;
+    for (int i = 0; i < count; ++i) {
+        auto ms = std::chrono::milliseconds(delay(rng));
+        Clock::time_point before = Clock::now();
+        wheel.Arm(ms, [&, i]() {
+            std::lock_guard<std::mutex> lock(mtx);
+            fired.push_back({i, Clock::now()});
+        });
+        expiry[i] = {before + ms - 1ms, Clock::now() + ms + 1ms};
+    }
+    assert(wait_for([&]() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return fired.size() == count;
+    }));
+
+    for (size_t i = 0; i < fired.size(); ++i) {
+        const Expiry &e = expiry[fired[i].timer];
+        assert(fired[i].at >= e.earliest);
+        // Fired after the one before it, so it cannot have been due first.
+        if (i > 0)
+            assert(e.latest >= expiry[fired[i - 1].timer].earliest);
+    }
+    assert(wheel.Armed() == 0);
+}
+
+/**
+ * @brief A cancelled timer never fires, and its id goes stale
+ */
+void test_cancel() {
+    TimerWheel wheel(1ms);
+    std::atomic<int> runs{0};
+    TimerWheel::TimerId id = wheel.Arm(30ms, [&]() { ++runs; });
+    assert(id != 0 && wheel.Armed() == 1);
+    assert(wheel.Cancel(id));
+    assert(!wheel.Cancel(id));
+    assert(!wheel.Rearm(id, 10ms));
+    std::this_thread::sleep_for(60ms);
+    assert(runs == 0 && wheel.Armed() == 0);
+
+    // A reused slot gets a new id; the old one cannot touch it.
+    TimerWheel::TimerId reused = wheel.Arm(10ms, [&]() { ++runs; });
+    assert(reused != id);
+    assert(!wheel.Cancel(id));
+    assert(wait_for([&]() { return runs == 1; }));
+}
+
+/**
+ * @brief A periodic timer keeps firing until cancelled, and Rearm() pushes
+ * its next run out
+ */
+void test_periodic() {
+    TimerWheel wheel(1ms);
+    std::atomic<int> runs{0};
+    TimerWheel::TimerId id = wheel.Arm(5ms, [&]() { ++runs; }, 5ms);
+    assert(wait_for([&]() { return runs >= 3; }));
+
+    // Pushed out well past the period: nothing fires in the meantime.
+    assert(wheel.Rearm(id, 300ms));
+    std::this_thread::sleep_for(20ms); // let a run already under way finish
+    int before = runs;
+    std::this_thread::sleep_for(100ms);
+    assert(runs == before);
+
+    assert(wheel.Cancel(id));
+    assert(wheel.Armed() == 0);
+    before = runs;
+    std::this_thread::sleep_for(20ms);
+    assert(runs == before);
+}
+
+/**
+ * @brief Cancel() waits for a running callback; a callback may cancel itself
+ */
+void test_cancel_running() {
+    TimerWheel wheel(1ms);
+    std::atomic<bool> entered{false}, finished{false};
+    TimerWheel::TimerId id = wheel.Arm(1ms, [&]() {
+        entered = true;
+        std::this_thread::sleep_for(50ms);
+        finished = true;
+    }, 1ms);
+    assert(wait_for([&]() { return entered.load(); }));
+    assert(wheel.Cancel(id));
+    assert(finished);
+
+    std::atomic<int> runs{0};
+    TimerWheel::TimerId self = 0;
+    std::mutex mtx;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        self = wheel.Arm(1ms, [&]() {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++runs;
+            assert(wheel.Cancel(self));
+        }, 1ms);
+    }
+    assert(wait_for([&]() { return runs == 1; }));
+    std::this_thread::sleep_for(20ms);
+    assert(runs == 1 && wheel.Armed() == 0);
+}
+
+/**
+ * @brief A timer re-armed and then cancelled while its callback runs is gone
+ * for good once Cancel() returns (as a guacd keepalive acked, then closed)
+ */
+void test_rearm_cancel_running() {
+    TimerWheel wheel(1ms);
+    std::atomic<bool> entered{false};
+    std::atomic<int> runs{0};
+    TimerWheel::TimerId id = wheel.Arm(1ms, [&]() {
+        ++runs;
+        entered = true;
+        std::this_thread::sleep_for(50ms);
+    });
+    assert(wait_for([&]() { return entered.load(); }));
+    assert(wheel.Rearm(id, 20ms));
+    assert(wheel.Cancel(id));
+    assert(runs == 1 && wheel.Armed() == 0);
+
+    // The bucket it was re-armed into comes round without it, and the freed
+    // slot serves a new timer.
+    std::this_thread::sleep_for(40ms);
+    std::atomic<int> other{0};
+    wheel.Arm(5ms, [&]() { ++other; });
+    assert(wait_for([&]() { return other == 1; }));
+    assert(runs == 1 && wheel.Armed() == 0);
+}
+
+/**
+ * @brief Unit tests for the timer wheel
+ */
+int main() {
+    test_order();
+
+    test_cancel();
+
+    test_periodic();
+
+    test_cancel_running();
+
+    test_rearm_cancel_running();
+
+    return 0;
+}